@@ -161,6 +161,10 @@ class Client:
                         '            ${output_camelcase} *output;\n'
                         '            GError *error = NULL;\n'
                         '\n'
+                        '            /* Don\'t even parse the indication if nobody is listening */\n'
+                        '            if (!g_signal_has_handler_pending (self, signals[SIGNAL_${signal_id}], 0, FALSE))\n'
+                        '                break;\n'
+                        '\n'
                         '            /* Parse indication */\n'
                         '            output = __${message_fullname_underscore}_indication_parse (message, &error);\n'
                         '            if (!output) {\n'
@@ -421,6 +425,7 @@ class Client:
                     '                    transaction_id,\n'
                     '                    NULL);\n'
                     '                abort = __qmi_message_${service_lowercase}_abort_request_create (\n'
+                    '                            __qmi_device_peek_message_pool (device),\n'
                     '                            qmi_client_get_next_transaction_id (QMI_CLIENT (self)),\n'
                     '                            qmi_client_get_cid (QMI_CLIENT (self)),\n'
                     '                            input,\n'
@@ -485,6 +490,7 @@ class Client:
                 '    transaction_id = qmi_client_get_next_transaction_id (QMI_CLIENT (self));\n'
                 '\n'
                 '    request = __${message_fullname_underscore}_request_create (\n'
+                '                  __qmi_device_peek_message_pool (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self)))),\n'
                 '                  transaction_id,\n'
                 '                  qmi_client_get_cid (QMI_CLIENT (self)),\n'
                 '                  ${input_var},\n'
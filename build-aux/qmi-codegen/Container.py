@@ -33,7 +33,7 @@ class Container:
     """
     Constructor
     """
-    def __init__(self, prefix, container_type, dictionary, common_objects_dictionary, static, since):
+    def __init__(self, prefix, container_type, dictionary, common_objects_dictionary, static, since, lazy = False):
         # The field container prefix usually contains the name of the Message,
         # e.g. "Qmi Message Ctl Something"
         self.prefix = prefix
@@ -51,11 +51,17 @@ class Container:
         self.static = static
         self.since = since
 
+        # Lazy output containers keep a reference to the message and only
+        # decode mandatory fields right away; the rest are decoded by their
+        # getters
+        self.lazy = lazy and self.readonly
+
         # Create the composed full name (prefix + name),
         #  e.g. "Qmi Message Ctl Something Output"
         self.fullname = self.prefix + ' ' + self.name
 
         self.fields = None
+        self.retains_message = False
         if dictionary is not None:
             self.fields = []
 
@@ -102,6 +108,31 @@ class Container:
                     else:
                         self.fields.append(Field(self.fullname, field_dictionary, common_objects_dictionary, container_type, static))
 
+            # Strings and byte arrays in outputs are not copied out of the
+            # message when parsing, so that they can be peeked
+            if self.readonly:
+                for field in self.fields:
+                    field.variable.flag_peekable()
+
+            # Setup lazy decoding, resolving which fields are referred by the
+            # prerequisites, as those need to be decoded before checking them
+            for field in self.fields:
+                field.lazy = self.lazy and not field.mandatory
+                for prerequisite in field.prerequisites:
+                    variable_name = 'arg_' + utils.build_underscore_name(prerequisite['field'].split('.')[0])
+                    for other in self.fields:
+                        if other.variable_name == variable_name:
+                            if self.fields.index(other) > self.fields.index(field):
+                                raise RuntimeError('Prerequisite \'%s\' of field \'%s\' is not decoded before it' % (prerequisite['field'], field.fullname))
+                            if other not in field.prerequisite_fields:
+                                field.prerequisite_fields.append(other)
+                            break
+
+            # Lazy or peekable fields need the message around
+            for field in self.fields:
+                if field.lazy or field.variable.peekable:
+                    self.retains_message = True
+
 
     """
     Emit enumeration of TLVs in the container
@@ -145,6 +176,9 @@ class Container:
             '\n'
             'struct _${camelcase} {\n'
             '    volatile gint ref_count;\n')
+        if self.retains_message:
+            template += (
+                '    QmiMessage *message;\n')
         cfile.write(string.Template(template).substitute(translations))
 
         if self.fields is not None:
@@ -157,6 +191,12 @@ class Container:
                         '\n'
                         '    /* ${field_name} */\n'
                         '    gboolean ${field_variable_name}_set;\n')
+                    if self.lazy:
+                        template += (
+                            '    gsize ${field_variable_name}_tlv_offset;\n')
+                    if field.lazy:
+                        template += (
+                            '    volatile gsize ${field_variable_name}_decoded;\n')
                     cfile.write(string.Template(template).substitute(translations))
                     cfile.write(variable_declaration)
 
@@ -253,6 +293,11 @@ class Container:
                 if field.variable is not None and field.variable.needs_dispose is True:
                     template += field.variable.build_dispose('        ', 'self->' + field.variable_name)
 
+        if self.retains_message:
+            template += (
+                '        if (self->message)\n'
+                '            qmi_message_unref (self->message);\n')
+
         template += (
             '        g_slice_free (${camelcase}, self);\n'
             '    }\n'
@@ -306,10 +351,17 @@ class Container:
         # Emit TLV enums
         self.__emit_tlv_ids_enum(cfile)
 
+        # Emit the on-demand decoders of lazy fields
+        for field in self.fields:
+            if field.lazy:
+                field.emit_output_lazy_decode(cfile)
+
         # Emit fields
         if self.fields is not None:
             for field in self.fields:
                 field.emit_getter(auxfile, cfile)
+                if self.readonly == True and field.variable.peekable:
+                    field.emit_peek(auxfile, cfile)
                 if self.readonly == False:
                     field.emit_setter(auxfile, cfile)
 
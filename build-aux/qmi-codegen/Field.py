@@ -67,6 +67,14 @@ class Field:
         # Create the ID enumeration name
         self.id_enum_name = utils.build_underscore_name(self.prefix + ' TLV ' + self.name).upper()
 
+        # Output fields in lazy containers are decoded on demand by their
+        # getters; the container sets these up once all fields are known
+        self.lazy = False
+        self.prerequisite_fields = []
+
+        # Name of the method decoding the field on demand
+        self.lazy_decode_name = '__' + utils.build_underscore_name(self.fullname) + '_decode'
+
         # Output Fields may have prerequisites
         self.prerequisites = []
         if 'prerequisites' in dictionary:
@@ -121,6 +129,7 @@ class Field:
                          'prefix_camelcase'    : utils.build_camelcase_name(self.prefix),
                          'prefix_underscore'   : utils.build_underscore_name(self.prefix),
                          'since'               : self.since,
+                         'lazy_decode'         : '    %s (self);\n\n' % self.lazy_decode_name if self.lazy else '',
                          'static'              : 'static ' if self.static else '' }
 
         # Emit the getter header
@@ -155,6 +164,7 @@ class Field:
             '{\n'
             '    g_return_val_if_fail (self != NULL, FALSE);\n'
             '\n'
+            '${lazy_decode}'
             '    if (!self->${variable_name}_set) {\n'
             '        g_set_error (error,\n'
             '                     QMI_CORE_ERROR,\n'
@@ -170,6 +180,76 @@ class Field:
         cfile.write(string.Template(template).substitute(translations))
 
 
+    """
+    Emit the method responsible for peeking the TLV contents without copying
+    them out of the message
+    """
+    def emit_peek(self, hfile, cfile):
+        input_variable_name = 'value_' + utils.build_underscore_name(self.name)
+        variable_peek_dec = self.variable.build_peek_declaration('    ', input_variable_name)
+        variable_peek_doc = self.variable.build_peek_documentation(' * ', input_variable_name)
+        variable_peek_imp = self.variable.build_peek_implementation('    ', 'self->' + self.variable_name, input_variable_name)
+        translations = { 'name'              : self.name,
+                         'variable_name'     : self.variable_name,
+                         'variable_peek_dec' : variable_peek_dec,
+                         'variable_peek_doc' : variable_peek_doc,
+                         'variable_peek_imp' : variable_peek_imp,
+                         'underscore'        : utils.build_underscore_name(self.name),
+                         'prefix_camelcase'  : utils.build_camelcase_name(self.prefix),
+                         'prefix_underscore' : utils.build_underscore_name(self.prefix),
+                         'lazy_decode'       : '    %s (self);\n\n' % self.lazy_decode_name if self.lazy else '',
+                         'static'            : 'static ' if self.static else '' }
+
+        # Emit the peek header
+        template = (
+            '\n'
+            '/**\n'
+            ' * ${prefix_underscore}_peek_${underscore}:\n'
+            ' * @self: a #${prefix_camelcase}.\n'
+            '${variable_peek_doc}'
+            ' * @error: Return location for error or %NULL.\n'
+            ' *\n'
+            ' * Get the \'${name}\' field from @self, without copying the string or\n'
+            ' * byte array contents out of the message. The returned data is owned by\n'
+            ' * @self and stays valid as long as @self is alive.\n'
+            ' *\n'
+            ' * Returns: %TRUE if the field is found, %FALSE otherwise.\n'
+            ' *\n'
+            ' * Since: 1.22\n'
+            ' */\n'
+            '${static}gboolean ${prefix_underscore}_peek_${underscore} (\n'
+            '    ${prefix_camelcase} *self,\n'
+            '${variable_peek_dec}'
+            '    GError **error);\n')
+        hfile.write(string.Template(template).substitute(translations))
+
+        # Emit the peek source
+        template = (
+            '\n'
+            '${static}gboolean\n'
+            '${prefix_underscore}_peek_${underscore} (\n'
+            '    ${prefix_camelcase} *self,\n'
+            '${variable_peek_dec}'
+            '    GError **error)\n'
+            '{\n'
+            '    g_return_val_if_fail (self != NULL, FALSE);\n'
+            '\n'
+            '${lazy_decode}'
+            '    if (!self->${variable_name}_set) {\n'
+            '        g_set_error (error,\n'
+            '                     QMI_CORE_ERROR,\n'
+            '                     QMI_CORE_ERROR_TLV_NOT_FOUND,\n'
+            '                     "Field \'${name}\' was not found in the message");\n'
+            '        return FALSE;\n'
+            '    }\n'
+            '\n'
+            '${variable_peek_imp}'
+            '\n'
+            '    return TRUE;\n'
+            '}\n')
+        cfile.write(string.Template(template).substitute(translations))
+
+
     """
     Emit the method responsible for setting this TLV in the input/output
     container
@@ -261,6 +341,22 @@ class Field:
         f.write(string.Template(template).substitute(translations))
 
 
+    """
+    Emit the code accumulating the size of the input TLV, so that the message
+    buffer can be allocated once. If the size of the variable cannot be
+    computed, only the TLV header is accounted for.
+    """
+    def emit_input_tlv_size(self, f, line_prefix, size_variable):
+        size = 3
+        expressions = []
+        bound = self.variable.build_size_upper_bound('input->' + self.variable_name)
+        if bound is not None:
+            size += bound[0]
+            expressions = bound[1]
+
+        f.write('%s%s += %s;\n' % (line_prefix, size_variable, ' + '.join([str(size)] + expressions)))
+
+
     """
     Emit the code responsible for checking prerequisites in output TLVs
     """
@@ -269,6 +365,10 @@ class Field:
             f.write('%s/* No Prerequisites for field */\n' % line_prefix)
             return
 
+        for field in self.prerequisite_fields:
+            if field.lazy:
+                f.write('%s%s (self);\n' % (line_prefix, field.lazy_decode_name))
+
         for prerequisite in self.prerequisites:
             translations = { 'lp'                     : line_prefix,
                              'prerequisite_field'     : utils.build_underscore_name(prerequisite['field']),
@@ -282,15 +382,34 @@ class Field:
 
 
     """
-    Emit the code responsible for retrieving the TLV from the QMI message
+    Emit the switch case storing the offset of the first TLV of this field
+    found while walking the message
+    """
+    def emit_output_tlv_dispatch(self, f, line_prefix, tlv_offset):
+        translations = { 'tlv_id'     : self.id_enum_name,
+                         'tlv_offset' : tlv_offset,
+                         'lp'         : line_prefix }
+
+        template = (
+            '${lp}case ${tlv_id}:\n'
+            '${lp}    if (!${tlv_offset})\n'
+            '${lp}        ${tlv_offset} = tlv_offset;\n'
+            '${lp}    break;\n')
+        f.write(string.Template(template).substitute(translations))
+
+
+    """
+    Emit the code responsible for retrieving the TLV from the QMI message,
+    given the TLV offset previously found by the dispatch loop
     """
-    def emit_output_tlv_get(self, f, line_prefix):
+    def emit_output_tlv_get(self, f, line_prefix, tlv_offset):
         tlv_out = utils.build_underscore_name (self.fullname) + '_out'
         error = 'error' if self.mandatory else 'NULL'
         translations = { 'name'                 : self.name,
                          'container_underscore' : utils.build_underscore_name (self.prefix),
                          'tlv_out'              : tlv_out,
                          'tlv_id'               : self.id_enum_name,
+                         'tlv_offset'           : tlv_offset,
                          'variable_name'        : self.variable_name,
                          'lp'                   : line_prefix,
                          'error'                : error }
@@ -299,7 +418,7 @@ class Field:
             '${lp}gsize offset = 0;\n'
             '${lp}gsize init_offset;\n'
             '\n'
-            '${lp}if ((init_offset = qmi_message_tlv_read_init (message, ${tlv_id}, NULL, ${error})) == 0) {\n')
+            '${lp}if ((init_offset = __qmi_message_tlv_read_init_at (message, ${tlv_offset}, ${tlv_id}, NULL, ${error})) == 0) {\n')
 
         if self.mandatory:
             template += (
@@ -340,6 +459,43 @@ class Field:
         f.write(string.Template(template).substitute(translations))
 
 
+    """
+    Emit the method decoding a lazy output field the first time its getter is
+    called, from the TLV offset found when the message was parsed; outputs may
+    be shared between threads, so the field is decoded only once
+    """
+    def emit_output_lazy_decode(self, f):
+        translations = { 'decode'           : self.lazy_decode_name,
+                         'prefix_camelcase' : utils.build_camelcase_name(self.prefix),
+                         'variable_name'    : self.variable_name }
+
+        template = (
+            '\n'
+            'static void\n'
+            '${decode} (${prefix_camelcase} *self)\n'
+            '{\n'
+            '    QmiMessage *message = self->message;\n'
+            '\n'
+            '    if (!g_once_init_enter (&self->${variable_name}_decoded))\n'
+            '        return;\n'
+            '\n'
+            '    do {\n')
+        f.write(string.Template(template).substitute(translations))
+
+        self.emit_output_prerequisite_check(f, '        ')
+        f.write(
+            '\n'
+            '        {\n')
+        self.emit_output_tlv_get(f, '            ', 'self->' + self.variable_name + '_tlv_offset')
+        f.write(
+            '\n'
+            '        }\n'
+            '    } while (0);\n'
+            '\n'
+            '    g_once_init_leave (&self->${variable_name}_decoded, 1);\n'
+            '}\n')
+
+
     """
     Emit the method responsible for creating a printable representation of the TLV
     """
@@ -402,6 +558,9 @@ class Field:
         # Public methods
         template = (
             '${prefix_underscore}_get_${underscore}\n')
+        if self.container_type == 'Output' and self.variable.peekable:
+            template += (
+                '${prefix_underscore}_peek_${underscore}\n')
         if self.container_type == 'Input':
             template += (
                 '${prefix_underscore}_set_${underscore}\n')
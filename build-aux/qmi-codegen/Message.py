@@ -31,7 +31,7 @@ class Message:
     """
     Constructor
     """
-    def __init__(self, dictionary, common_objects_dictionary):
+    def __init__(self, dictionary, common_objects_dictionary, lazy_outputs = False):
         # The message service, e.g. "Ctl"
         self.service = dictionary['service']
         # The name of the specific message, e.g. "Something"
@@ -76,7 +76,8 @@ class Message:
                                 dictionary['output'] if 'output' in dictionary else None,
                                 common_objects_dictionary,
                                 self.static,
-                                self.since)
+                                self.since,
+                                lazy_outputs)
 
         self.input = None
         if self.type == 'Message':
@@ -107,17 +108,40 @@ class Message:
             '\n'
             'static QmiMessage *\n'
             '__${underscore}_request_create (\n'
+            '    QmiMessagePool *pool,\n'
             '    guint16 transaction_id,\n'
             '    guint8 cid,\n'
             '    %s,\n'
             '    GError **error)\n'
             '{\n'
-            '    QmiMessage *self;\n'
+            '    QmiMessage *self;\n' % input_arg_template)
+        cfile.write(string.Template(template).substitute(translations))
+
+        if self.input.fields:
+            # Compute the size of all TLVs to add, so that the message buffer
+            # doesn't need to be reallocated while writing them
+            cfile.write(
+                '    gsize tlvs_size = 0;\n'
+                '\n'
+                '    if (input) {\n')
+            for field in self.input.fields:
+                cfile.write(
+                    '        if (input->%s_set)\n' % field.variable_name)
+                field.emit_input_tlv_size(cfile, '            ', 'tlvs_size')
+            cfile.write(
+                '    }\n')
+            translations['tlvs_size'] = 'tlvs_size'
+        else:
+            translations['tlvs_size'] = '0'
+
+        template = (
             '\n'
-            '    self = qmi_message_new (QMI_SERVICE_${service},\n'
-            '                            cid,\n'
-            '                            transaction_id,\n'
-            '                            ${message_id});\n' % input_arg_template)
+            '    self = __qmi_message_pool_new_message (pool,\n'
+            '                                           QMI_SERVICE_${service},\n'
+            '                                           cid,\n'
+            '                                           transaction_id,\n'
+            '                                           ${message_id},\n'
+            '                                           ${tlvs_size});\n')
         cfile.write(string.Template(template).substitute(translations))
 
         if self.input.fields:
@@ -211,14 +235,53 @@ class Message:
             '    GError **error)\n'
             '{\n'
             '    ${container} *self;\n'
+            '    gsize tlv_offset = 0;\n'
+            '    guint8 tlv_type;\n'
+            '    guint n_unknown_tlvs = 0;\n')
+        cfile.write(string.Template(template).substitute(translations))
+
+        # Lazy containers keep the TLV offsets in the output itself
+        tlv_offset_prefix = 'self->' if self.output.lazy else ''
+        if not self.output.lazy:
+            for field in self.output.fields:
+                cfile.write('    gsize %s_tlv_offset = 0;\n' % field.variable_name)
+
+        template = (
             '\n'
             '    g_return_val_if_fail (qmi_message_get_message_id (message) == ${message_id}, NULL);\n'
             '\n'
             '    self = g_slice_new0 (${container});\n'
             '    self->ref_count = 1;\n')
+        if self.output.retains_message:
+            template += (
+                '    self->message = qmi_message_ref (message);\n')
+        template += (
+            '\n'
+            '    /* Walk the TLVs once, keeping the first one of each known type */\n'
+            '    while ((tlv_offset = __qmi_message_tlv_read_next (message, tlv_offset, &tlv_type)) > 0) {\n'
+            '        switch (tlv_type) {\n')
+        cfile.write(string.Template(template).substitute(translations))
+
+        for field in self.output.fields:
+            field.emit_output_tlv_dispatch(cfile, '        ', tlv_offset_prefix + field.variable_name + '_tlv_offset')
+
+        template = (
+            '        default:\n'
+            '            n_unknown_tlvs++;\n'
+            '            break;\n'
+            '        }\n'
+            '    }\n'
+            '\n'
+            '    if (n_unknown_tlvs > 0 && qmi_utils_get_traces_enabled ())\n'
+            '        g_debug ("Ignored %u unknown TLVs in \'${name}\' ${type}", n_unknown_tlvs);\n')
         cfile.write(string.Template(template).substitute(translations))
 
+        # Fields are decoded in container order, not in wire order, so that
+        # prerequisites are always evaluated on already decoded fields. Lazy
+        # fields are left for their getters.
         for field in self.output.fields:
+            if field.lazy:
+                continue
             cfile.write(
                 '\n'
                 '    do {\n')
@@ -226,7 +289,7 @@ class Message:
             cfile.write(
                 '\n'
                 '        {\n')
-            field.emit_output_tlv_get(cfile, '            ')
+            field.emit_output_tlv_get(cfile, '            ', tlv_offset_prefix + field.variable_name + '_tlv_offset')
             cfile.write(
                 '\n'
                 '        }\n')
@@ -32,7 +32,7 @@ class MessageList:
     """
     Constructor
     """
-    def __init__(self, objects_dictionary, common_objects_dictionary):
+    def __init__(self, objects_dictionary, common_objects_dictionary, lazy_outputs = False):
         self.list = []
         self.message_id_enum_name = None
         self.indication_id_enum_name = None
@@ -43,7 +43,7 @@ class MessageList:
         for object_dictionary in objects_dictionary:
             if object_dictionary['type'] == 'Message' or \
                object_dictionary['type'] == 'Indication':
-                message = Message(object_dictionary, common_objects_dictionary)
+                message = Message(object_dictionary, common_objects_dictionary, lazy_outputs)
                 self.list.append(message)
             elif object_dictionary['type'] == 'Message-ID-Enum':
                 self.message_id_enum_name = object_dictionary['name']
@@ -64,6 +64,13 @@ class Variable:
         """
         self.public = False
 
+        """
+        Variables read from output TLVs may be flagged as peekable, in which
+        case they are only located within the message when parsed, and can be
+        accessed without copying them
+        """
+        self.peekable = False
+
     """
     Emits the code to declare specific new types required by the variable.
     """
@@ -166,3 +173,36 @@ class Variable:
     """
     def flag_public(self):
         self.public = True
+
+    """
+    Builds the upper bound of the size of the variable once written to the
+    raw byte buffer, as a (constant, list of C expressions) tuple, or None if
+    it cannot be computed
+    """
+    def build_size_upper_bound(self, variable_name):
+        return None
+
+    """
+    Flag as being peekable, if the variable type supports it
+    """
+    def flag_peekable(self):
+        pass
+
+    """
+    Builds the code to include in the peek method declaration; by default the
+    same as in the getter
+    """
+    def build_peek_declaration(self, line_prefix, variable_name):
+        return self.build_getter_declaration(line_prefix, variable_name)
+
+    """
+    Builds the documentation of the peek method
+    """
+    def build_peek_documentation(self, line_prefix, variable_name):
+        return self.build_getter_documentation(line_prefix, variable_name)
+
+    """
+    Builds the code to implement peeking this kind of variable
+    """
+    def build_peek_implementation(self, line_prefix, variable_name_from, variable_name_to):
+        return self.build_getter_implementation(line_prefix, variable_name_from, variable_name_to, True)
@@ -21,6 +21,7 @@
 import string
 import utils
 from Variable import Variable
+from VariableInteger import VariableInteger
 import VariableFactory
 
 """
@@ -128,11 +129,103 @@ class VariableArray(Variable):
         cfile.write(string.Template(template).substitute(translations))
 
 
+    """
+    Elements have a fixed layout when they are plain integers, or structs of
+    plain integers without padding, so that the wire layout matches the one
+    in memory except for the byte order. Returns the element size and the
+    list of (member, byte order conversion) fixups to apply on each element,
+    or None if the layout is not fixed.
+    """
+    def __fixed_layout(self):
+        def integer_layout(variable, accessor):
+            if variable.format not in [ 'guint8', 'gint8', 'guint16', 'gint16', 'guint32', 'gint32', 'guint64', 'gint64' ]:
+                return None
+            if variable.public_format != variable.private_format:
+                return None
+            size = VariableInteger.fixed_type_byte_size(variable.format)
+            fixups = []
+            if size > 1:
+                fixups.append((accessor, variable.format.upper() + ('_FROM_BE' if variable.endian == 'QMI_ENDIAN_BIG' else '_FROM_LE')))
+            return (size, fixups)
+
+        if self.array_element.format != 'struct':
+            return integer_layout(self.array_element, '*')
+
+        size = 0
+        alignment = 1
+        fixups = []
+        for member in self.array_element.members:
+            layout = integer_layout(member['object'], member['name'])
+            if layout is None:
+                return None
+            # Members must be naturally aligned, or the compiler adds padding
+            if size % layout[0] != 0:
+                return None
+            size += layout[0]
+            alignment = max(alignment, layout[0])
+            fixups += layout[1]
+        # No trailing padding either
+        if size == 0 or size % alignment != 0:
+            return None
+        return (size, fixups)
+
+
+    """
+    Reading an array of fixed-layout elements is just about copying all of them
+    at once after a single bounds check, and fixing the byte order if needed.
+    """
+    def __emit_buffer_read_fixed_layout(self, f, line_prefix, tlv_out, error, variable_name, layout):
+        common_var_prefix = utils.build_underscore_name(self.name)
+        translations = { 'lp'                          : line_prefix,
+                         'tlv_out'                     : tlv_out,
+                         'error'                       : error,
+                         'variable_name'               : variable_name,
+                         'public_array_element_format' : self.array_element.public_format,
+                         'element_size'                : layout[0],
+                         'common_var_prefix'           : common_var_prefix }
+
+        template = (
+            '\n'
+            '${lp}    /* Elements have the same layout in the TLV and in memory */\n'
+            '${lp}    if (!(${common_var_prefix}_data = __qmi_message_tlv_read_items (message, init_offset, &offset, ${common_var_prefix}_n_items, ${element_size}, ${error})))\n'
+            '${lp}        goto ${tlv_out};\n'
+            '\n'
+            '${lp}    ${variable_name} = g_array_sized_new (\n'
+            '${lp}        FALSE,\n'
+            '${lp}        FALSE,\n'
+            '${lp}        sizeof (${public_array_element_format}),\n'
+            '${lp}        (guint)${common_var_prefix}_n_items);\n'
+            '${lp}    g_array_append_vals (${variable_name}, ${common_var_prefix}_data, (guint)${common_var_prefix}_n_items);\n')
+
+        if layout[1]:
+            template += (
+                '\n'
+                '${lp}    /* Fix the byte order; a no-op when the host one already matches */\n'
+                '${lp}    for (${common_var_prefix}_i = 0; ${common_var_prefix}_i < ${common_var_prefix}_n_items; ${common_var_prefix}_i++) {\n'
+                '${lp}        ${public_array_element_format} *${common_var_prefix}_aux;\n'
+                '\n'
+                '${lp}        ${common_var_prefix}_aux = &g_array_index (${variable_name}, ${public_array_element_format}, ${common_var_prefix}_i);\n')
+            for (member, conversion) in layout[1]:
+                if member == '*':
+                    template += (
+                        '${lp}        *${common_var_prefix}_aux = %s (*${common_var_prefix}_aux);\n' % conversion)
+                else:
+                    template += (
+                        '${lp}        ${common_var_prefix}_aux->%s = %s (${common_var_prefix}_aux->%s);\n' % (member, conversion, member))
+            template += (
+                '${lp}    }\n')
+
+        template += (
+            '${lp}}\n')
+        f.write(string.Template(template).substitute(translations))
+
+
     """
     Reading an array from the raw byte buffer is just about providing a loop to
     read every array element one by one.
     """
     def emit_buffer_read(self, f, line_prefix, tlv_out, error, variable_name):
+        layout = self.__fixed_layout()
         common_var_prefix = utils.build_underscore_name(self.name)
         translations = { 'lp'                          : line_prefix,
                          'variable_name'               : variable_name,
@@ -141,17 +234,36 @@ class VariableArray(Variable):
                          'underscore'                  : self.clear_func_name(),
                          'common_var_prefix'           : common_var_prefix }
 
+        # Peekable arrays are always of single bytes, no need to copy them here
+        if self.peekable:
+            layout = (1, [])
+
         template = (
-            '${lp}{\n'
-            '${lp}    guint ${common_var_prefix}_i;\n')
+            '${lp}{\n')
+        if layout is None or layout[1]:
+            template += (
+                '${lp}    guint ${common_var_prefix}_i;\n')
+        if layout is not None and not self.peekable:
+            template += (
+                '${lp}    const guint8 *${common_var_prefix}_data;\n')
         f.write(string.Template(template).substitute(translations))
 
+        # The element size is asserted along with the declarations
+        static_assert = ''
+        if layout is not None and not self.peekable:
+            translations['element_size'] = layout[0]
+            static_assert = '${lp}    G_STATIC_ASSERT (sizeof (${public_array_element_format}) == ${element_size});\n'
+
         if self.fixed_size:
             translations['fixed_size'] = self.fixed_size
 
             template = (
-                '${lp}    guint16 ${common_var_prefix}_n_items = ${fixed_size};\n'
-                '\n')
+                '${lp}    guint16 ${common_var_prefix}_n_items = ${fixed_size};\n')
+            if layout is None:
+                template += (
+                    '\n')
+            else:
+                template += static_assert
             f.write(string.Template(template).substitute(translations))
         else:
             translations['array_size_element_format'] = self.array_size_element.public_format
@@ -163,6 +275,7 @@ class VariableArray(Variable):
                 template += (
                     '${lp}    ${array_sequence_element_format} ${common_var_prefix}_sequence;\n')
 
+            template += static_assert
             template += (
                 '\n'
                 '${lp}    /* Read number of items in the array */\n')
@@ -181,6 +294,23 @@ class VariableArray(Variable):
                     '${lp}    ${variable_name}_sequence = ${common_var_prefix}_sequence;\n')
                 f.write(string.Template(template).substitute(translations))
 
+        if self.peekable:
+            template = (
+                '\n'
+                '${lp}    /* The array is only located in the message here, the copy is done by the getter */\n'
+                '${lp}    if (!(${variable_name}_peek = __qmi_message_tlv_read_items (message, init_offset, &offset, ${common_var_prefix}_n_items, 1, ${error})))\n'
+                '${lp}        goto ${tlv_out};\n'
+                '${lp}    ${variable_name}_peek_length = ${common_var_prefix}_n_items;\n'
+                '${lp}}\n')
+            translations['tlv_out'] = tlv_out
+            translations['error'] = error
+            f.write(string.Template(template).substitute(translations))
+            return
+
+        if layout is not None:
+            self.__emit_buffer_read_fixed_layout(f, line_prefix, tlv_out, error, variable_name, layout)
+            return
+
         template = (
             '\n'
             '${lp}    ${variable_name} = g_array_sized_new (\n'
@@ -211,6 +341,23 @@ class VariableArray(Variable):
         f.write(string.Template(template).substitute(translations))
 
 
+    """
+    The size of an array is only known if its elements have a constant size
+    """
+    def build_size_upper_bound(self, variable_name):
+        element = self.array_element.build_size_upper_bound('')
+        if element is None or element[1]:
+            return None
+
+        size = 0
+        if self.array_sequence_element != '':
+            size += self.array_sequence_element.build_size_upper_bound('')[0]
+        if self.fixed_size:
+            return (size + int(self.fixed_size) * element[0], [])
+        size += self.array_size_element.build_size_upper_bound('')[0]
+        return (size, [ '%s->len * %d' % (variable_name, element[0]) ])
+
+
     """
     Writing an array to the raw byte buffer is just about providing a loop to
     write every array element one by one.
@@ -337,6 +484,10 @@ class VariableArray(Variable):
 
         template += (
             '${lp}GArray *${name};\n')
+        if self.peekable:
+            template += (
+                '${lp}const guint8 *${name}_peek;\n'
+                '${lp}guint32 ${name}_peek_length;\n')
         return string.Template(template).substitute(translations)
 
 
@@ -399,7 +550,22 @@ class VariableArray(Variable):
                 '${lp}if (${to}_sequence)\n'
                 '${lp}    *${to}_sequence = ${from}_sequence;\n')
 
-        if to_is_reference:
+        if self.peekable:
+            # The array is copied out of the message the first time it's
+            # requested; outputs may be shared between threads, so the copy
+            # is done only once
+            template += (
+                '${lp}if (${to}) {\n'
+                '${lp}    if (g_once_init_enter (&${from})) {\n'
+                '${lp}        GArray *copy;\n'
+                '${lp}\n'
+                '${lp}        copy = g_array_sized_new (FALSE, FALSE, sizeof (guint8), ${from}_peek_length);\n'
+                '${lp}        g_array_append_vals (copy, ${from}_peek, ${from}_peek_length);\n'
+                '${lp}        g_once_init_leave (&${from}, copy);\n'
+                '${lp}    }\n'
+                '${lp}    *${to} = ${from};\n'
+                '${lp}}\n')
+        elif to_is_reference:
             template += (
                 '${lp}if (${to})\n'
                 '${lp}    *${to} = ${from};\n')
@@ -410,6 +576,70 @@ class VariableArray(Variable):
         return string.Template(template).substitute(translations)
 
 
+    """
+    Arrays of plain bytes read from output TLVs are peekable
+    """
+    def flag_peekable(self):
+        if self.visible and \
+           not self.public and \
+           self.container_type == 'Output' and \
+           self.array_sequence_element == '' and \
+           self.array_element.format == 'guint8' and \
+           self.array_element.public_format == 'guint8':
+            self.peekable = True
+
+
+    """
+    Peek method declaration for the array type
+    """
+    def build_peek_declaration(self, line_prefix, variable_name):
+        if not self.peekable:
+            return Variable.build_peek_declaration(self, line_prefix, variable_name)
+
+        translations = { 'lp'   : line_prefix,
+                         'name' : variable_name }
+
+        template = (
+            '${lp}const guint8 **${name},\n'
+            '${lp}gsize *${name}_length,\n')
+        return string.Template(template).substitute(translations)
+
+
+    """
+    Documentation for the peek method
+    """
+    def build_peek_documentation(self, line_prefix, variable_name):
+        if not self.peekable:
+            return Variable.build_peek_documentation(self, line_prefix, variable_name)
+
+        translations = { 'lp'   : line_prefix,
+                         'name' : variable_name }
+
+        template = (
+            '${lp}@${name}: a placeholder for the output data, or %NULL if not required.\n'
+            '${lp}@${name}_length: a placeholder for the length of the output data, or %NULL if not required.\n')
+        return string.Template(template).substitute(translations)
+
+
+    """
+    Builds the array peek implementation
+    """
+    def build_peek_implementation(self, line_prefix, variable_name_from, variable_name_to):
+        if not self.peekable:
+            return Variable.build_peek_implementation(self, line_prefix, variable_name_from, variable_name_to)
+
+        translations = { 'lp'   : line_prefix,
+                         'from' : variable_name_from,
+                         'to'   : variable_name_to }
+
+        template = (
+            '${lp}if (${to})\n'
+            '${lp}    *${to} = ${from}_peek;\n'
+            '${lp}if (${to}_length)\n'
+            '${lp}    *${to}_length = ${from}_peek_length;\n')
+        return string.Template(template).substitute(translations)
+
+
     """
     Setter for the array type
     """
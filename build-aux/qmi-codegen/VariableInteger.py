@@ -113,6 +113,18 @@ class VariableInteger(Variable):
             return 8
         raise Exception("Unsupported format %s" % (fmt))
 
+    """
+    Integers have a fixed size in the raw byte buffer
+    """
+    def build_size_upper_bound(self, variable_name):
+        if self.format == 'guint-sized':
+            return (int(self.guint_sized_size), [])
+        if self.private_format == 'gfloat':
+            return (4, [])
+        if self.private_format == 'gdouble':
+            return (8, [])
+        return (VariableInteger.fixed_type_byte_size(self.private_format), [])
+
     """
     Write a single integer to the raw byte buffer
     """
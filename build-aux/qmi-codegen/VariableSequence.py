@@ -71,6 +71,21 @@ class VariableSequence(Variable):
             member['object'].emit_helper_methods(hfile, cfile)
 
 
+    """
+    The size of a sequence is the size of all its members
+    """
+    def build_size_upper_bound(self, variable_name):
+        size = 0
+        expressions = []
+        for member in self.members:
+            bound = member['object'].build_size_upper_bound(variable_name + '_' + member['name'])
+            if bound is None:
+                return None
+            size += bound[0]
+            expressions += bound[1]
+        return (size, expressions)
+
+
     """
     Reading the contents of a sequence is just about reading each of the sequence
     fields one by one.
@@ -223,6 +238,50 @@ class VariableSequence(Variable):
         return built
 
 
+    """
+    A sequence is peekable if any of its members is
+    """
+    def flag_peekable(self):
+        if not self.visible:
+            return
+        for member in self.members:
+            member['object'].flag_peekable()
+            if member['object'].peekable:
+                self.peekable = True
+
+
+    """
+    The peek method for a sequence variable peeks each member
+    """
+    def build_peek_declaration(self, line_prefix, variable_name):
+        built = ''
+        for member in self.members:
+            built += member['object'].build_peek_declaration(line_prefix, variable_name + '_' + member['name'])
+        return built
+
+
+    """
+    Documentation for the peek method
+    """
+    def build_peek_documentation(self, line_prefix, variable_name):
+        built = ''
+        for member in self.members:
+            built += member['object'].build_peek_documentation(line_prefix, variable_name + '_' + member['name'])
+        return built
+
+
+    """
+    Builds the sequence peek implementation
+    """
+    def build_peek_implementation(self, line_prefix, variable_name_from, variable_name_to):
+        built = ''
+        for member in self.members:
+            built += member['object'].build_peek_implementation(line_prefix,
+                                                                variable_name_from + '_' + member['name'],
+                                                                variable_name_to + '_' + member['name'])
+        return built
+
+
     """
     Add sections
     """
@@ -101,6 +101,14 @@ class VariableString(Variable):
                     '${lp}if (!qmi_message_tlv_read_fixed_size_string (message, init_offset, &offset, ${fixed_size}, &${variable_name}[0], ${error}))\n'
                     '${lp}    goto ${tlv_out};\n'
                     '${lp}${variable_name}[${fixed_size}] = \'\\0\';\n')
+        elif self.peekable:
+            # Peekable strings are only located in the message here, the copy
+            # is done by the getter
+            translations['n_size_prefix_bytes'] = self.n_size_prefix_bytes
+            translations['max_size'] = self.max_size if self.max_size != '' else '0'
+            template = (
+                '${lp}if (!__qmi_message_tlv_read_string_peek (message, init_offset, &offset, ${n_size_prefix_bytes}, ${max_size}, &(${variable_name}_peek), &(${variable_name}_peek_length), ${error}))\n'
+                '${lp}    goto ${tlv_out};\n')
         else:
             translations['n_size_prefix_bytes'] = self.n_size_prefix_bytes
             translations['max_size'] = self.max_size if self.max_size != '' else '0'
@@ -129,6 +137,16 @@ class VariableString(Variable):
         f.write(string.Template(template).substitute(translations))
 
 
+    """
+    Fixed-size strings have a fixed size, the others need the size prefix plus
+    the actual string length
+    """
+    def build_size_upper_bound(self, variable_name):
+        if self.is_fixed_size:
+            return (int(self.fixed_size), [])
+        return (self.n_size_prefix_bytes, [ 'strlen (%s)' % variable_name ])
+
+
     """
     Get the string as printable
     """
@@ -185,6 +203,10 @@ class VariableString(Variable):
         else:
             template = (
                 '${lp}gchar *${name};\n')
+            if self.peekable:
+                template += (
+                    '${lp}const gchar *${name}_peek;\n'
+                    '${lp}guint16 ${name}_peek_length;\n')
         return string.Template(template).substitute(translations)
 
 
@@ -229,7 +251,18 @@ class VariableString(Variable):
                          'from' : variable_name_from,
                          'to'   : variable_name_to }
 
-        if to_is_reference:
+        if self.peekable:
+            # The string is copied out of the message the first time it's
+            # requested; outputs may be shared between threads, so the copy
+            # is done only once
+            template = (
+                '${lp}if (${to}) {\n'
+                '${lp}    if (g_once_init_enter (&${from}))\n'
+                '${lp}        g_once_init_leave (&${from}, g_strndup (${from}_peek, ${from}_peek_length));\n'
+                '${lp}    *${to} = ${from};\n'
+                '${lp}}\n')
+            return string.Template(template).substitute(translations)
+        elif to_is_reference:
             template = (
                 '${lp}if (${to})\n'
                 '${lp}    *${to} = ${from};\n')
@@ -358,6 +391,66 @@ class VariableString(Variable):
         return string.Template(template).substitute(translations)
 
 
+    """
+    Only variable-length strings are peekable, fixed-size ones are stored in
+    the output itself
+    """
+    def flag_peekable(self):
+        if self.visible and not self.is_fixed_size and not self.public:
+            self.peekable = True
+
+
+    """
+    Peek method declaration for the string type
+    """
+    def build_peek_declaration(self, line_prefix, variable_name):
+        if not self.peekable:
+            return Variable.build_peek_declaration(self, line_prefix, variable_name)
+
+        translations = { 'lp'   : line_prefix,
+                         'name' : variable_name }
+
+        template = (
+            '${lp}const gchar **${name},\n'
+            '${lp}gsize *${name}_length,\n')
+        return string.Template(template).substitute(translations)
+
+
+    """
+    Documentation for the peek method
+    """
+    def build_peek_documentation(self, line_prefix, variable_name):
+        if not self.peekable:
+            return Variable.build_peek_documentation(self, line_prefix, variable_name)
+
+        translations = { 'lp'   : line_prefix,
+                         'name' : variable_name }
+
+        template = (
+            '${lp}@${name}: a placeholder for the output string, which is NOT NUL-terminated, or %NULL if not required.\n'
+            '${lp}@${name}_length: a placeholder for the length of the output string, or %NULL if not required.\n')
+        return string.Template(template).substitute(translations)
+
+
+    """
+    Builds the String peek implementation
+    """
+    def build_peek_implementation(self, line_prefix, variable_name_from, variable_name_to):
+        if not self.peekable:
+            return Variable.build_peek_implementation(self, line_prefix, variable_name_from, variable_name_to)
+
+        translations = { 'lp'   : line_prefix,
+                         'from' : variable_name_from,
+                         'to'   : variable_name_to }
+
+        template = (
+            '${lp}if (${to})\n'
+            '${lp}    *${to} = ${from}_peek;\n'
+            '${lp}if (${to}_length)\n'
+            '${lp}    *${to}_length = ${from}_peek_length;\n')
+        return string.Template(template).substitute(translations)
+
+
     """
     Flag as being public
     """
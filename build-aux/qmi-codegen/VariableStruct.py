@@ -101,6 +101,21 @@ class VariableStruct(Variable):
             member['object'].emit_helper_methods(hfile, cfile)
 
 
+    """
+    The size of a struct is the size of all its members
+    """
+    def build_size_upper_bound(self, variable_name):
+        size = 0
+        expressions = []
+        for member in self.members:
+            bound = member['object'].build_size_upper_bound(variable_name + '.' + member['name'])
+            if bound is None:
+                return None
+            size += bound[0]
+            expressions += bound[1]
+        return (size, expressions)
+
+
     """
     Reading the contents of a struct is just about reading each of the struct
     fields one by one.
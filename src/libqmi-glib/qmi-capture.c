@@ -0,0 +1,588 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "qmi-capture.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+/* pcapng block types and options */
+#define PCAPNG_BLOCK_SHB        0x0A0D0D0A
+#define PCAPNG_BLOCK_IDB        0x00000001
+#define PCAPNG_BLOCK_EPB        0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define PCAPNG_OPT_END          0
+#define PCAPNG_OPT_IF_NAME      2
+#define PCAPNG_OPT_EPB_FLAGS    2
+#define PCAPNG_LINKTYPE_USER0   147
+
+#define PCAPNG_PAD(len) (((len) + 3) & ~((gsize) 3))
+
+/* Block sizes without the variable-length contents */
+#define SHB_SIZE           28
+#define IDB_SIZE           24
+#define EPB_SIZE           44
+#define PSEUDO_HEADER_SIZE 4
+
+/* Big enough to hold the largest possible QMUX frame in one record */
+#define CAPTURE_BUFFER_SIZE (128 * 1024)
+
+/*****************************************************************************/
+/* Writer
+ *
+ * Records are added to a buffer in the thread running the device. When it's
+ * full, the buffer is handed to a writer thread and a second one is used in
+ * the meantime, so that the device never blocks on the capture file. If the
+ * writer thread is still busy with the previous buffer when the second one is
+ * full as well, new records are dropped and counted instead.
+ */
+
+struct _QmiCapture {
+    gint     fd;
+    GThread *writer;
+    GMutex   mutex;
+    GCond    cond;
+
+    /* Buffer being filled */
+    guint8  *buffer;
+    gsize    buffer_len;
+
+    /* Buffer handed to the writer thread, and buffer available once the
+     * writer is done; only one of them is set at any time */
+    guint8  *pending;
+    gsize    pending_len;
+    guint8  *spare;
+
+    gboolean stopping;
+    GError  *write_error;
+    guint64  dropped;
+};
+
+static inline guint8 *
+put_u16 (guint8  *p,
+         guint16  value)
+{
+    memcpy (p, &value, sizeof (value));
+    return p + sizeof (value);
+}
+
+static inline guint8 *
+put_u32 (guint8  *p,
+         guint32  value)
+{
+    memcpy (p, &value, sizeof (value));
+    return p + sizeof (value);
+}
+
+static gboolean
+capture_write (gint           fd,
+               const guint8  *data,
+               gsize          len,
+               GError       **error)
+{
+    gsize written = 0;
+
+    while (written < len) {
+        gssize r;
+
+        r = write (fd, data + written, len - written);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            g_set_error (error,
+                         G_FILE_ERROR,
+                         g_file_error_from_errno (errno),
+                         "Couldn't write capture: %s",
+                         g_strerror (errno));
+            return FALSE;
+        }
+        written += r;
+    }
+
+    return TRUE;
+}
+
+static gpointer
+capture_writer_thread (QmiCapture *self)
+{
+    g_mutex_lock (&self->mutex);
+    while (TRUE) {
+        GError *error = NULL;
+
+        while (!self->pending && !self->stopping)
+            g_cond_wait (&self->cond, &self->mutex);
+        if (!self->pending)
+            break;
+
+        g_mutex_unlock (&self->mutex);
+        /* Whatever can't be written is lost */
+        capture_write (self->fd, self->pending, self->pending_len, &error);
+        g_mutex_lock (&self->mutex);
+
+        if (error) {
+            if (!self->write_error)
+                self->write_error = error;
+            else
+                g_error_free (error);
+        }
+        self->spare = self->pending;
+        self->pending = NULL;
+        self->pending_len = 0;
+        g_cond_broadcast (&self->cond);
+    }
+    g_mutex_unlock (&self->mutex);
+
+    return NULL;
+}
+
+gboolean
+__qmi_capture_flush (QmiCapture  *self,
+                     GError     **error)
+{
+    GError  *write_error = NULL;
+    guint64  dropped;
+
+    /* Wait for the writer thread to be done with the previous buffer, and
+     * write the current one right away */
+    g_mutex_lock (&self->mutex);
+    while (self->pending)
+        g_cond_wait (&self->cond, &self->mutex);
+    g_mutex_unlock (&self->mutex);
+
+    capture_write (self->fd, self->buffer, self->buffer_len, &write_error);
+    self->buffer_len = 0;
+
+    g_mutex_lock (&self->mutex);
+    if (self->write_error) {
+        g_clear_error (&write_error);
+        write_error = self->write_error;
+        self->write_error = NULL;
+    }
+    dropped = self->dropped;
+    self->dropped = 0;
+    g_mutex_unlock (&self->mutex);
+
+    if (write_error) {
+        g_propagate_error (error, write_error);
+        return FALSE;
+    }
+
+    if (dropped) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_FAILED,
+                     "%" G_GUINT64_FORMAT " messages couldn't be captured",
+                     dropped);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Returns NULL if the record needs to be dropped */
+static guint8 *
+capture_reserve (QmiCapture *self,
+                 gsize       len)
+{
+    guint8 *p;
+
+    g_assert (len <= CAPTURE_BUFFER_SIZE);
+
+    if (self->buffer_len + len > CAPTURE_BUFFER_SIZE) {
+        g_mutex_lock (&self->mutex);
+        if (self->pending) {
+            self->dropped++;
+            g_mutex_unlock (&self->mutex);
+            return NULL;
+        }
+        self->pending = self->buffer;
+        self->pending_len = self->buffer_len;
+        self->buffer = self->spare;
+        self->buffer_len = 0;
+        self->spare = NULL;
+        g_cond_signal (&self->cond);
+        g_mutex_unlock (&self->mutex);
+    }
+
+    p = self->buffer + self->buffer_len;
+    self->buffer_len += len;
+    return p;
+}
+
+QmiCapture *
+__qmi_capture_new (const gchar  *path,
+                   const gchar  *device_name,
+                   GError      **error)
+{
+    QmiCapture *self;
+    gint        fd;
+    gsize       name_len;
+    gsize       total;
+    guint8     *p;
+
+    fd = g_open (path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        g_set_error (error,
+                     G_FILE_ERROR,
+                     g_file_error_from_errno (errno),
+                     "Couldn't open capture file '%s': %s",
+                     path, g_strerror (errno));
+        return NULL;
+    }
+
+    self = g_slice_new0 (QmiCapture);
+    self->fd = fd;
+    self->buffer = g_malloc (CAPTURE_BUFFER_SIZE);
+    self->spare = g_malloc (CAPTURE_BUFFER_SIZE);
+    g_mutex_init (&self->mutex);
+    g_cond_init (&self->cond);
+    self->writer = g_thread_new ("qmi-capture", (GThreadFunc) capture_writer_thread, self);
+
+    /* Section header block */
+    p = capture_reserve (self, SHB_SIZE);
+    p = put_u32 (p, PCAPNG_BLOCK_SHB);
+    p = put_u32 (p, SHB_SIZE);
+    p = put_u32 (p, PCAPNG_BYTE_ORDER_MAGIC);
+    p = put_u16 (p, 1); /* major */
+    p = put_u16 (p, 0); /* minor */
+    p = put_u32 (p, G_MAXUINT32); /* section length: unknown */
+    p = put_u32 (p, G_MAXUINT32);
+    put_u32 (p, SHB_SIZE);
+
+    /* Interface description block, named after the device */
+    name_len = device_name ? MIN (strlen (device_name), G_MAXUINT16) : 0;
+    total = IDB_SIZE + (name_len ? 4 + PCAPNG_PAD (name_len) : 0);
+    p = capture_reserve (self, total);
+    memset (p, 0, total);
+    p = put_u32 (p, PCAPNG_BLOCK_IDB);
+    p = put_u32 (p, total);
+    p = put_u16 (p, PCAPNG_LINKTYPE_USER0);
+    p = put_u16 (p, 0); /* reserved */
+    p = put_u32 (p, 0); /* snaplen: no limit */
+    if (name_len) {
+        p = put_u16 (p, PCAPNG_OPT_IF_NAME);
+        p = put_u16 (p, name_len);
+        memcpy (p, device_name, name_len);
+        p += PCAPNG_PAD (name_len);
+    }
+    p = put_u32 (p, PCAPNG_OPT_END);
+    put_u32 (p, total);
+
+    return self;
+}
+
+void
+__qmi_capture_add (QmiCapture          *self,
+                   gint64               timestamp,
+                   QmiCaptureDirection  direction,
+                   guint16              vendor_id,
+                   const guint8        *frame,
+                   gsize                frame_len)
+{
+    gsize   data_len;
+    gsize   total;
+    guint8 *p;
+
+    data_len = PSEUDO_HEADER_SIZE + frame_len;
+    total = EPB_SIZE + PCAPNG_PAD (data_len);
+
+    p = capture_reserve (self, total);
+    if (!p)
+        return;
+    p = put_u32 (p, PCAPNG_BLOCK_EPB);
+    p = put_u32 (p, total);
+    p = put_u32 (p, 0); /* interface id */
+    p = put_u32 (p, (guint32) (((guint64) timestamp) >> 32));
+    p = put_u32 (p, (guint32) (((guint64) timestamp) & 0xFFFFFFFF));
+    p = put_u32 (p, data_len); /* captured */
+    p = put_u32 (p, data_len); /* original */
+
+    /* Pseudo-header, always little endian */
+    p = put_u16 (p, GUINT16_TO_LE (vendor_id));
+    p = put_u16 (p, 0);
+
+    /* The only copy of the frame done */
+    memcpy (p, frame, frame_len);
+    p += frame_len;
+    while (data_len & 3) {
+        *(p++) = 0;
+        data_len++;
+    }
+
+    p = put_u16 (p, PCAPNG_OPT_EPB_FLAGS);
+    p = put_u16 (p, 4);
+    p = put_u32 (p, (guint32) direction);
+    p = put_u32 (p, PCAPNG_OPT_END);
+    put_u32 (p, total);
+}
+
+void
+__qmi_capture_free (QmiCapture *self)
+{
+    GError *error = NULL;
+
+    if (!__qmi_capture_flush (self, &error)) {
+        g_warning ("%s", error->message);
+        g_error_free (error);
+    }
+
+    g_mutex_lock (&self->mutex);
+    self->stopping = TRUE;
+    g_cond_signal (&self->cond);
+    g_mutex_unlock (&self->mutex);
+    g_thread_join (self->writer);
+
+    close (self->fd);
+    g_mutex_clear (&self->mutex);
+    g_cond_clear (&self->cond);
+    g_free (self->buffer);
+    g_free (self->spare);
+    g_slice_free (QmiCapture, self);
+}
+
+/*****************************************************************************/
+/* Reader */
+
+struct _QmiCaptureReader {
+    GMappedFile  *mapped;
+    const guint8 *data;
+    gsize         len;
+    gsize         offset;
+    gboolean      swapped;
+    gchar        *device;
+};
+
+static inline guint16
+get_u16 (QmiCaptureReader *self,
+         gsize             offset)
+{
+    guint16 value;
+
+    memcpy (&value, self->data + offset, sizeof (value));
+    return self->swapped ? GUINT16_SWAP_LE_BE (value) : value;
+}
+
+static inline guint32
+get_u32 (QmiCaptureReader *self,
+         gsize             offset)
+{
+    guint32 value;
+
+    memcpy (&value, self->data + offset, sizeof (value));
+    return self->swapped ? GUINT32_SWAP_LE_BE (value) : value;
+}
+
+/* Returns the total length of the block at the given offset, or 0 if it's
+ * not valid */
+static gsize
+block_check (QmiCaptureReader  *self,
+             gsize              offset,
+             guint32           *type,
+             GError           **error)
+{
+    guint32 total;
+
+    if (self->len - offset < 12) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Truncated capture block at offset %" G_GSIZE_FORMAT, offset);
+        return 0;
+    }
+
+    *type = get_u32 (self, offset);
+    total = get_u32 (self, offset + 4);
+    if (total < 12 || (total & 3) || total > self->len - offset) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Invalid capture block length at offset %" G_GSIZE_FORMAT, offset);
+        return 0;
+    }
+
+    return total;
+}
+
+/* Looks for the given option within [offset, end); returns its offset or 0 */
+static gsize
+option_find (QmiCaptureReader *self,
+             gsize             offset,
+             gsize             end,
+             guint16           code,
+             guint16          *out_len)
+{
+    while (offset + 4 <= end) {
+        guint16 option_code;
+        guint16 option_len;
+
+        option_code = get_u16 (self, offset);
+        option_len = get_u16 (self, offset + 2);
+        if (option_code == PCAPNG_OPT_END || offset + 4 + option_len > end)
+            break;
+        if (option_code == code) {
+            *out_len = option_len;
+            return offset + 4;
+        }
+        offset += 4 + PCAPNG_PAD (option_len);
+    }
+    return 0;
+}
+
+QmiCaptureReader *
+__qmi_capture_reader_new (const gchar  *path,
+                          GError      **error)
+{
+    QmiCaptureReader *self;
+    GMappedFile      *mapped;
+    guint32           magic;
+    gsize             offset;
+
+    mapped = g_mapped_file_new (path, FALSE, error);
+    if (!mapped)
+        return NULL;
+
+    self = g_slice_new0 (QmiCaptureReader);
+    self->mapped = mapped;
+    self->data = (const guint8 *) g_mapped_file_get_contents (mapped);
+    self->len = g_mapped_file_get_length (mapped);
+
+    if (self->len < SHB_SIZE || get_u32 (self, 0) != PCAPNG_BLOCK_SHB) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Not a capture file: '%s'", path);
+        __qmi_capture_reader_free (self);
+        return NULL;
+    }
+
+    magic = get_u32 (self, 8);
+    if (magic == GUINT32_SWAP_LE_BE (PCAPNG_BYTE_ORDER_MAGIC))
+        self->swapped = TRUE;
+    else if (magic != PCAPNG_BYTE_ORDER_MAGIC) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_MESSAGE,
+                     "Invalid byte order magic in capture file: '%s'", path);
+        __qmi_capture_reader_free (self);
+        return NULL;
+    }
+
+    /* Look for the device name in the first interface description block */
+    for (offset = 0; offset < self->len; ) {
+        guint32 type;
+        gsize   total;
+
+        total = block_check (self, offset, &type, error);
+        if (!total) {
+            __qmi_capture_reader_free (self);
+            return NULL;
+        }
+
+        if (type == PCAPNG_BLOCK_IDB) {
+            gsize   name_offset;
+            guint16 name_len = 0;
+
+            if (total >= IDB_SIZE) {
+                name_offset = option_find (self, offset + 16, offset + total - 4, PCAPNG_OPT_IF_NAME, &name_len);
+                if (name_offset)
+                    self->device = g_strndup ((const gchar *) self->data + name_offset, name_len);
+            }
+            break;
+        }
+        if (type == PCAPNG_BLOCK_EPB)
+            break;
+        offset += total;
+    }
+
+    return self;
+}
+
+const gchar *
+__qmi_capture_reader_get_device (QmiCaptureReader *self)
+{
+    return self->device;
+}
+
+gboolean
+__qmi_capture_reader_next (QmiCaptureReader  *self,
+                           QmiCaptureRecord  *record,
+                           GError           **error)
+{
+    while (self->offset < self->len) {
+        guint32 type;
+        gsize   total;
+        gsize   offset;
+        guint32 data_len;
+        gsize   flags_offset;
+        guint16 flags_len = 0;
+
+        offset = self->offset;
+        total = block_check (self, offset, &type, error);
+        if (!total)
+            return FALSE;
+        self->offset += total;
+
+        if (type != PCAPNG_BLOCK_EPB)
+            continue;
+
+        data_len = (total >= EPB_SIZE ? get_u32 (self, offset + 20) : 0);
+        if (total < EPB_SIZE ||
+            data_len < PSEUDO_HEADER_SIZE ||
+            PCAPNG_PAD (data_len) > total - 32) {
+            g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_MESSAGE,
+                         "Invalid capture record at offset %" G_GSIZE_FORMAT, offset);
+            return FALSE;
+        }
+
+        record->timestamp = (gint64) ((((guint64) get_u32 (self, offset + 12)) << 32) |
+                                      get_u32 (self, offset + 16));
+        record->vendor_id = self->data[offset + 28] | (self->data[offset + 29] << 8);
+        record->frame = self->data + offset + 28 + PSEUDO_HEADER_SIZE;
+        record->frame_len = data_len - PSEUDO_HEADER_SIZE;
+
+        record->direction = QMI_CAPTURE_DIRECTION_UNKNOWN;
+        flags_offset = option_find (self,
+                                    offset + 28 + PCAPNG_PAD (data_len),
+                                    offset + total - 4,
+                                    PCAPNG_OPT_EPB_FLAGS,
+                                    &flags_len);
+        if (flags_offset && flags_len == 4)
+            record->direction = (QmiCaptureDirection) (get_u32 (self, flags_offset) & 0x3);
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+void
+__qmi_capture_reader_rewind (QmiCaptureReader *self)
+{
+    self->offset = 0;
+}
+
+void
+__qmi_capture_reader_free (QmiCaptureReader *self)
+{
+    g_mapped_file_unref (self->mapped);
+    g_free (self->device);
+    g_slice_free (QmiCaptureReader, self);
+}
@@ -0,0 +1,92 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_CAPTURE_H_
+#define _LIBQMI_GLIB_QMI_CAPTURE_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Binary capture of the QMI traffic of a device.
+ *
+ * Captures are pcapng files with a single section and a single interface,
+ * named after the device path, using the LINKTYPE_USER0 link type. Each
+ * message is stored in an Enhanced Packet Block, with microsecond timestamps
+ * and the direction given in the 'epb_flags' option (inbound for messages
+ * received from the device, outbound for messages sent to it). The packet data
+ * is the raw QMUX frame, preceded by a 4-byte pseudo-header with the vendor id
+ * of the message context (little endian 16-bit) and 2 reserved bytes.
+ *
+ * Not part of the public API, but exported by the library (and so not
+ * G_GNUC_INTERNAL) so that the tests and the tools reading captures can use it.
+ */
+
+typedef enum {
+    QMI_CAPTURE_DIRECTION_UNKNOWN = 0,
+    QMI_CAPTURE_DIRECTION_IN      = 1,
+    QMI_CAPTURE_DIRECTION_OUT     = 2,
+} QmiCaptureDirection;
+
+/* Writer */
+
+typedef struct _QmiCapture QmiCapture;
+
+QmiCapture *__qmi_capture_new   (const gchar          *path,
+                                 const gchar          *device_name,
+                                 GError              **error);
+void        __qmi_capture_add   (QmiCapture           *self,
+                                 gint64                timestamp,
+                                 QmiCaptureDirection   direction,
+                                 guint16               vendor_id,
+                                 const guint8         *frame,
+                                 gsize                 frame_len);
+gboolean    __qmi_capture_flush (QmiCapture           *self,
+                                 GError              **error);
+void        __qmi_capture_free  (QmiCapture           *self);
+
+/* Reader */
+
+typedef struct {
+    gint64               timestamp;
+    QmiCaptureDirection  direction;
+    guint16              vendor_id;
+    const guint8        *frame;
+    gsize                frame_len;
+} QmiCaptureRecord;
+
+typedef struct _QmiCaptureReader QmiCaptureReader;
+
+QmiCaptureReader *__qmi_capture_reader_new        (const gchar       *path,
+                                                   GError           **error);
+const gchar      *__qmi_capture_reader_get_device (QmiCaptureReader  *self);
+gboolean          __qmi_capture_reader_next       (QmiCaptureReader  *self,
+                                                   QmiCaptureRecord  *record,
+                                                   GError           **error);
+void              __qmi_capture_reader_rewind     (QmiCaptureReader  *self);
+void              __qmi_capture_reader_free       (QmiCaptureReader  *self);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_CAPTURE_H_ */
@@ -50,7 +50,8 @@ struct _QmiClientPrivate {
     guint version_major;
     guint version_minor;
 
-    guint16 transaction_id;
+    /* Updated atomically, requests may be created from different threads */
+    volatile gint transaction_id;
 };
 
 /*****************************************************************************/
@@ -143,22 +144,25 @@ qmi_client_check_version (QmiClient *self,
 guint16
 qmi_client_get_next_transaction_id (QmiClient *self)
 {
-    guint16 next;
+    gint current;
+    gint next;
 
     g_return_val_if_fail (QMI_IS_CLIENT (self), 0);
 
-    next = self->priv->transaction_id;
+    do {
+        current = g_atomic_int_get (&self->priv->transaction_id);
 
-    /* Don't go further than 8bits in the CTL service */
-    if ((self->priv->service == QMI_SERVICE_CTL &&
-         self->priv->transaction_id == G_MAXUINT8) ||
-        self->priv->transaction_id == G_MAXUINT16)
-        /* Reset! */
-        self->priv->transaction_id = 0x01;
-    else
-        self->priv->transaction_id++;
+        /* Don't go further than 8bits in the CTL service */
+        if ((self->priv->service == QMI_SERVICE_CTL &&
+             current == G_MAXUINT8) ||
+            current == G_MAXUINT16)
+            /* Reset! */
+            next = 0x01;
+        else
+            next = current + 1;
+    } while (!g_atomic_int_compare_and_exchange (&self->priv->transaction_id, current, next));
 
-    return next;
+    return (guint16) current;
 }
 
 /*****************************************************************************/
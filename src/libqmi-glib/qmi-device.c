@@ -54,9 +54,11 @@
 #include "qmi-voice.h"
 #include "qmi-loc.h"
 #include "qmi-utils.h"
+#include "qmi-io.h"
 #include "qmi-error-types.h"
 #include "qmi-enum-types.h"
 #include "qmi-proxy.h"
+#include "qmi-capture.h"
 
 static void async_initable_iface_init (GAsyncInitableIface *iface);
 
@@ -65,21 +67,32 @@ G_DEFINE_TYPE_EXTENDED (QmiDevice, qmi_device, G_TYPE_OBJECT, 0,
 
 #define MAX_SPAWN_RETRIES 10
 
+#define QMI_MESSAGE_WDS_STOP_NETWORK 0x0021
+
 enum {
     PROP_0,
     PROP_FILE,
     PROP_NO_FILE_CHECK,
     PROP_PROXY_PATH,
     PROP_WWAN_IFACE,
+    PROP_READ_SIZE,
+    PROP_OUTPUT_QUEUE_LIMIT,
+    PROP_MESSAGE_POOL,
+    PROP_STATS_INTERVAL,
+    PROP_VERSION_INFO_CACHE,
+    PROP_IO_CONTEXT,
     PROP_LAST
 };
 
 enum {
     SIGNAL_INDICATION,
     SIGNAL_REMOVED,
+    SIGNAL_STATS,
     SIGNAL_LAST
 };
 
+typedef struct _CidPool CidPool;
+
 static GParamSpec *properties[PROP_LAST];
 static guint       signals   [SIGNAL_LAST] = { 0 };
 
@@ -103,14 +116,74 @@ struct _QmiDevicePrivate {
     QmiClientCtl *client_ctl;
     guint sync_indication_id;
 
-    /* Supported services */
+    /* Per-service pools of allocated CIDs not in use by any client */
+    CidPool *cid_pools[G_MAXUINT8 + 1];
+
+    /* Supported services, and the same info indexed by service */
     GArray *supported_services;
+    const QmiMessageCtlGetVersionInfoOutputServiceListService *service_table[G_MAXUINT8 + 1];
+
+    /* Per-service bitmap of supported message ids, if known */
+    GArray *supported_messages[G_MAXUINT8 + 1];
+
+    /* Key file where the supported services are cached, if enabled */
+    gchar *version_info_cache;
+
+    /* Context owning the I/O and all the device sources, if one was given;
+     * otherwise the thread-default context of each caller is used */
+    GMainContext *io_context;
 
     /* I/O stream, set when the file is open */
     GInputStream *istream;
     GOutputStream *ostream;
     GSource *input_source;
-    GByteArray *buffer;
+
+    /* Output queue, written without blocking; the output source is set while
+     * waiting for the stream to be writable again */
+    GQueue *output_queue;
+    GSource *output_source;
+    guint output_queue_limit;
+
+    /* Requests not yet in the output queue, sorted by priority, either because
+     * their service reached its in-flight limit or because the stream isn't
+     * writable; the pending source reschedules them */
+    GQueue *pending_queue;
+    GSource *pending_source;
+
+    /* Per-service number of requests written and waiting for a response, and
+     * their limits (0 if unlimited) */
+    guint in_flight[G_MAXUINT8 + 1];
+    guint in_flight_limit[G_MAXUINT8 + 1];
+
+    /* HT of (service << 16 | message id) to priority */
+    GHashTable *message_priorities;
+
+    /* HT of (service << 16 | message id) to the TTL (ms) of the cached
+     * responses, for the messages whose identical requests are coalesced */
+    GHashTable *coalesced_messages;
+
+    /* HT of request contents to CoalesceEntry */
+    GHashTable *coalesce_entries;
+
+    /* Runtime statistics: device totals, and HT of (service << 16 | message
+     * id) to QmiDeviceMessageStats */
+    QmiDeviceStats stats;
+    GHashTable *message_stats;
+    gint64 stats_start_time;
+
+    /* Periodic emission of the stats signal, if enabled */
+    guint stats_interval;
+    GSource *stats_source;
+
+    /* Receive buffer, and how much is read at once */
+    QmiIoReceiveBuffer buffer;
+    guint read_size;
+
+    /* Pool of recycled message buffers, if enabled */
+    QmiMessagePool *message_pool;
+
+    /* Binary capture of the traffic, if enabled */
+    QmiCapture *capture;
 
     /* Support for qmi-proxy */
     GSocketClient *socket_client;
@@ -119,28 +192,77 @@ struct _QmiDevicePrivate {
     /* HT to keep track of ongoing transactions */
     GHashTable *transactions;
 
+    /* Min-heap of transactions with a timeout, sorted by deadline, and the
+     * single source used to wait for the earliest one */
+    GPtrArray *timeout_heap;
+    GSource *timeout_source;
+
     /* HT of clients that want to get indications */
     GHashTable *registered_clients;
+
+    /* HT of service to GPtrArray of registered clients, so that broadcast
+     * indications only go through the clients of the given service */
+    GHashTable *service_clients;
+
+    /* Indications pending to be passed down to the clients, all of them
+     * dispatched in the same main loop iteration */
+    GQueue *indication_queue;
+    GSource *indication_source;
 };
 
-#define BUFFER_SIZE 2048
+#define BUFFER_SIZE     2048
+#define MIN_BUFFER_SIZE 64
+#define MAX_BUFFER_SIZE 65536
+
+/*****************************************************************************/
+/* I/O context (private) */
+
+static inline GMainContext *
+device_peek_context (QmiDevice *self)
+{
+    return (self->priv->io_context ? self->priv->io_context : g_main_context_get_thread_default ());
+}
 
 /*****************************************************************************/
 /* Message transactions (private) */
 
-typedef struct {
-    QmiDevice *self;
-    gpointer key;
-} TransactionWaitContext;
+#define TIMEOUT_HEAP_INDEX_NONE G_MAXUINT
+
+typedef struct _CoalesceEntry CoalesceEntry;
 
 typedef struct {
-    QmiMessage             *message;
-    QmiMessageContext      *message_context;
-    GSimpleAsyncResult     *result;
-    GSource                *timeout_source;
-    GCancellable           *cancellable;
-    gulong                  cancellable_id;
-    TransactionWaitContext *wait_ctx;
+    QmiMessage         *message;
+    QmiMessageContext  *message_context;
+    GSimpleAsyncResult *result;
+    GCancellable       *cancellable;
+    gulong              cancellable_id;
+
+    /* Set once the transaction is stored; the key is valid as long as the
+     * transaction is in the HT */
+    QmiDevice          *self;
+    gpointer            key;
+
+    /* Monotonic deadline, and position in the timeout heap */
+    gint64              deadline;
+    guint               heap_index;
+
+    /* Set once moved to the output queue, counted in the in-flight limit of
+     * the service */
+    gboolean            in_flight;
+
+    /* Set if identical requests may be merged into this one */
+    CoalesceEntry      *coalesce_entry;
+
+    /* Set while merged into an identical request in flight */
+    CoalesceEntry      *coalesced_into;
+
+    /* Timeout requested by the caller, for requests sent after they're stored
+     * (e.g. waiters of a coalesced request) */
+    guint               timeout;
+
+    /* Monotonic time when the request was issued, 0 if not accounted in the
+     * stats (e.g. failed before being stored) */
+    gint64              start_time;
 } Transaction;
 
 static Transaction *
@@ -154,6 +276,7 @@ transaction_new (QmiDevice           *self,
     Transaction *tr;
 
     tr = g_slice_new0 (Transaction);
+    tr->heap_index = TIMEOUT_HEAP_INDEX_NONE;
     tr->message = qmi_message_ref (message);
     tr->message_context = (message_context ? qmi_message_context_ref (message_context) : NULL);
     tr->result = g_simple_async_result_new (G_OBJECT (self),
@@ -166,6 +289,372 @@ transaction_new (QmiDevice           *self,
     return tr;
 }
 
+/*****************************************************************************/
+/* Transaction timeouts (private)
+ *
+ * Instead of one timeout source per transaction, all transactions with a
+ * timeout are kept in a binary min-heap sorted by deadline, and one single
+ * source per device is armed with the earliest deadline.
+ */
+
+#define TIMEOUT_HEAP_PARENT(i) (((i) - 1) / 2)
+#define TIMEOUT_HEAP_LEFT(i)   (2 * (i) + 1)
+
+static inline Transaction *
+timeout_heap_get (QmiDevice *self,
+                  guint      i)
+{
+    return (Transaction *) g_ptr_array_index (self->priv->timeout_heap, i);
+}
+
+static inline void
+timeout_heap_set (QmiDevice   *self,
+                  guint        i,
+                  Transaction *tr)
+{
+    g_ptr_array_index (self->priv->timeout_heap, i) = tr;
+    tr->heap_index = i;
+}
+
+static void
+timeout_heap_sift_up (QmiDevice *self,
+                      guint      i)
+{
+    Transaction *tr;
+
+    tr = timeout_heap_get (self, i);
+    while (i > 0) {
+        Transaction *parent;
+
+        parent = timeout_heap_get (self, TIMEOUT_HEAP_PARENT (i));
+        if (parent->deadline <= tr->deadline)
+            break;
+        timeout_heap_set (self, i, parent);
+        i = TIMEOUT_HEAP_PARENT (i);
+    }
+    timeout_heap_set (self, i, tr);
+}
+
+static void
+timeout_heap_sift_down (QmiDevice *self,
+                        guint      i)
+{
+    Transaction *tr;
+    guint        len;
+
+    len = self->priv->timeout_heap->len;
+    tr = timeout_heap_get (self, i);
+    while (TIMEOUT_HEAP_LEFT (i) < len) {
+        guint        child;
+        Transaction *child_tr;
+
+        child = TIMEOUT_HEAP_LEFT (i);
+        if (child + 1 < len &&
+            timeout_heap_get (self, child + 1)->deadline < timeout_heap_get (self, child)->deadline)
+            child++;
+        child_tr = timeout_heap_get (self, child);
+        if (tr->deadline <= child_tr->deadline)
+            break;
+        timeout_heap_set (self, i, child_tr);
+        i = child;
+    }
+    timeout_heap_set (self, i, tr);
+}
+
+static void
+timeout_source_update (QmiDevice *self)
+{
+    if (!self->priv->timeout_source)
+        return;
+
+    g_source_set_ready_time (self->priv->timeout_source,
+                             (self->priv->timeout_heap->len > 0 ?
+                              timeout_heap_get (self, 0)->deadline :
+                              -1));
+}
+
+static void
+timeout_heap_remove (QmiDevice   *self,
+                     Transaction *tr)
+{
+    Transaction *last;
+    guint        i;
+
+    i = tr->heap_index;
+    g_assert (i < self->priv->timeout_heap->len);
+    g_assert (timeout_heap_get (self, i) == tr);
+
+    tr->heap_index = TIMEOUT_HEAP_INDEX_NONE;
+    last = g_ptr_array_remove_index (self->priv->timeout_heap, self->priv->timeout_heap->len - 1);
+    if (last != tr) {
+        /* Move the last element to the free position and restore the heap */
+        timeout_heap_set (self, i, last);
+        if (i > 0 && timeout_heap_get (self, TIMEOUT_HEAP_PARENT (i))->deadline > last->deadline)
+            timeout_heap_sift_up (self, i);
+        else
+            timeout_heap_sift_down (self, i);
+    }
+
+    /* Only need to rearm if the earliest deadline may have changed */
+    if (i == 0)
+        timeout_source_update (self);
+}
+
+static void transaction_complete_and_free (Transaction  *tr,
+                                           QmiMessage   *reply,
+                                           const GError *error);
+
+static void
+device_expire_transactions (QmiDevice *self)
+{
+    gint64 now;
+
+    now = g_get_monotonic_time ();
+    while (self->priv->timeout_heap->len > 0) {
+        Transaction *tr;
+        GError      *error;
+
+        tr = timeout_heap_get (self, 0);
+        if (tr->deadline > now)
+            break;
+
+        /* Remove it from the HT and from the heap */
+        g_hash_table_remove (self->priv->transactions, tr->key);
+        timeout_heap_remove (self, tr);
+
+        /* Complete transaction with a timeout error */
+        error = g_error_new (QMI_CORE_ERROR,
+                             QMI_CORE_ERROR_TIMEOUT,
+                             "Transaction timed out");
+        transaction_complete_and_free (tr, NULL, error);
+        g_error_free (error);
+    }
+
+    timeout_source_update (self);
+}
+
+typedef struct {
+    GSource    source;
+    QmiDevice *self;
+} TimeoutSource;
+
+static gboolean
+timeout_source_dispatch (GSource     *source,
+                         GSourceFunc  callback,
+                         gpointer     user_data)
+{
+    device_expire_transactions (((TimeoutSource *)source)->self);
+    return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs timeout_source_funcs = {
+    NULL, /* prepare, ready time based */
+    NULL, /* check, ready time based */
+    timeout_source_dispatch,
+    NULL
+};
+
+static void
+timeout_heap_add (QmiDevice   *self,
+                  Transaction *tr,
+                  guint        timeout)
+{
+    /* The source is created on the first timeout, in the I/O context or in
+     * the thread-default main context of the caller, and it is kept until the
+     * device is disposed */
+    if (!self->priv->timeout_source) {
+        self->priv->timeout_source = g_source_new (&timeout_source_funcs, sizeof (TimeoutSource));
+        ((TimeoutSource *)self->priv->timeout_source)->self = self;
+        g_source_set_ready_time (self->priv->timeout_source, -1);
+        g_source_attach (self->priv->timeout_source, device_peek_context (self));
+    }
+
+    tr->deadline = g_get_monotonic_time () + ((gint64) timeout * G_USEC_PER_SEC);
+    g_ptr_array_add (self->priv->timeout_heap, tr);
+    tr->heap_index = self->priv->timeout_heap->len - 1;
+    timeout_heap_sift_up (self, tr->heap_index);
+
+    /* Rearm only if this is the new earliest deadline */
+    if (tr->heap_index == 0)
+        timeout_source_update (self);
+}
+
+static void
+timeout_source_destroy (QmiDevice *self)
+{
+    if (self->priv->timeout_source) {
+        g_source_destroy (self->priv->timeout_source);
+        g_clear_pointer (&self->priv->timeout_source, g_source_unref);
+    }
+}
+
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* Runtime statistics (private) */
+
+static inline guint
+build_message_key (QmiMessage *message)
+{
+    return (((guint)qmi_message_get_service (message) << 16) | qmi_message_get_message_id (message));
+}
+
+static QmiDeviceMessageStats *
+device_stats_lookup (QmiDevice  *self,
+                     QmiMessage *message)
+{
+    QmiDeviceMessageStats *stats;
+    guint                  key;
+
+    key = build_message_key (message);
+    stats = g_hash_table_lookup (self->priv->message_stats, GUINT_TO_POINTER (key));
+    if (!stats) {
+        stats = g_new0 (QmiDeviceMessageStats, 1);
+        stats->service = qmi_message_get_service (message);
+        stats->message_id = qmi_message_get_message_id (message);
+        g_hash_table_insert (self->priv->message_stats, GUINT_TO_POINTER (key), stats);
+    }
+    return stats;
+}
+
+static guint
+latency_bucket (gint64 latency)
+{
+    guint64 ms;
+    guint   bucket = 0;
+
+    for (ms = latency / 1000; ms > 0 && bucket < QMI_DEVICE_STATS_LATENCY_BUCKETS - 1; ms >>= 1)
+        bucket++;
+    return bucket;
+}
+
+static void
+device_stats_request_started (QmiDevice   *self,
+                              Transaction *tr)
+{
+    guint n_transactions;
+
+    tr->start_time = g_get_monotonic_time ();
+    device_stats_lookup (self, tr->message)->requests++;
+
+    n_transactions = g_hash_table_size (self->priv->transactions);
+    if (n_transactions > self->priv->stats.max_in_flight)
+        self->priv->stats.max_in_flight = n_transactions;
+}
+
+static void
+device_stats_request_completed (QmiDevice    *self,
+                                Transaction  *tr,
+                                QmiMessage   *reply,
+                                const GError *error)
+{
+    QmiDeviceMessageStats *stats;
+    gint64                 latency;
+
+    stats = device_stats_lookup (self, tr->message);
+
+    if (!reply) {
+        if (g_error_matches (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT))
+            stats->timeouts++;
+        else if (g_error_matches (error, QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_ABORTED))
+            stats->aborts++;
+        else
+            stats->errors++;
+        return;
+    }
+
+    latency = MAX (g_get_monotonic_time () - tr->start_time, 0);
+    stats->responses++;
+    stats->latency_total += latency;
+    if ((guint64)latency > stats->latency_max)
+        stats->latency_max = latency;
+    stats->latency_histogram[latency_bucket (latency)]++;
+}
+
+static void
+device_stats_indication (QmiDevice  *self,
+                         QmiMessage *message)
+{
+    device_stats_lookup (self, message)->indications++;
+    self->priv->stats.indications++;
+}
+
+static void
+device_stats_reset (QmiDevice *self)
+{
+    memset (&self->priv->stats, 0, sizeof (self->priv->stats));
+    g_hash_table_remove_all (self->priv->message_stats);
+    self->priv->stats_start_time = g_get_monotonic_time ();
+}
+
+static gboolean
+stats_source_cb (QmiDevice *self)
+{
+    g_signal_emit (self, signals[SIGNAL_STATS], 0);
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+stats_source_update (QmiDevice *self)
+{
+    if (self->priv->stats_source) {
+        g_source_destroy (self->priv->stats_source);
+        g_clear_pointer (&self->priv->stats_source, g_source_unref);
+    }
+
+    if (!self->priv->stats_interval)
+        return;
+
+    self->priv->stats_source = g_timeout_source_new_seconds (self->priv->stats_interval);
+    g_source_set_callback (self->priv->stats_source,
+                           (GSourceFunc)stats_source_cb,
+                           self,
+                           NULL);
+    g_source_attach (self->priv->stats_source, device_peek_context (self));
+}
+
+GArray *
+qmi_device_get_stats (QmiDevice      *self,
+                      QmiDeviceStats *stats)
+{
+    GArray                *array;
+    GHashTableIter         iter;
+    QmiDeviceMessageStats *message_stats;
+
+    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
+
+    if (stats) {
+        *stats = self->priv->stats;
+        stats->elapsed = g_get_monotonic_time () - self->priv->stats_start_time;
+    }
+
+    array = g_array_sized_new (FALSE, FALSE, sizeof (QmiDeviceMessageStats),
+                               g_hash_table_size (self->priv->message_stats));
+    g_hash_table_iter_init (&iter, self->priv->message_stats);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&message_stats))
+        g_array_append_vals (array, message_stats, 1);
+
+    return array;
+}
+
+void
+qmi_device_reset_stats (QmiDevice *self)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    device_stats_reset (self);
+}
+
+/*****************************************************************************/
+
+static void device_in_flight_release (QmiDevice   *self,
+                                      Transaction *tr);
+static void coalesce_entry_complete  (CoalesceEntry *entry,
+                                      QmiMessage    *reply,
+                                      const GError  *error);
+static void coalesce_entry_remove_waiter (CoalesceEntry *entry,
+                                          Transaction   *tr);
+
 static void
 transaction_complete_and_free (Transaction *tr,
                                QmiMessage *reply,
@@ -173,8 +662,20 @@ transaction_complete_and_free (Transaction *tr,
 {
     g_assert (reply != NULL || error != NULL);
 
-    if (tr->timeout_source)
-        g_source_destroy (tr->timeout_source);
+    if (tr->heap_index != TIMEOUT_HEAP_INDEX_NONE)
+        timeout_heap_remove (tr->self, tr);
+
+    if (tr->in_flight)
+        device_in_flight_release (tr->self, tr);
+
+    if (tr->start_time)
+        device_stats_request_completed (tr->self, tr, reply, error);
+
+    if (tr->coalesced_into)
+        coalesce_entry_remove_waiter (tr->coalesced_into, tr);
+
+    if (tr->coalesce_entry)
+        coalesce_entry_complete (tr->coalesce_entry, reply, error);
 
     if (tr->cancellable) {
         if (tr->cancellable_id)
@@ -182,9 +683,6 @@ transaction_complete_and_free (Transaction *tr,
         g_object_unref (tr->cancellable);
     }
 
-    if (tr->wait_ctx)
-        g_slice_free (TransactionWaitContext, tr->wait_ctx);
-
     if (reply)
         g_simple_async_result_set_op_res_gpointer (tr->result,
                                                    qmi_message_ref (reply),
@@ -234,47 +732,93 @@ device_release_transaction (QmiDevice *self,
     return tr;
 }
 
-static gboolean
-transaction_timed_out (TransactionWaitContext *ctx)
+static void
+transaction_abort (QmiDevice    *self,
+                   gpointer      key,
+                   GCancellable *cancellable,
+                   gboolean      in_handler)
 {
     Transaction *tr;
     GError *error = NULL;
 
-    tr = device_release_transaction (ctx->self, ctx->key);
-    tr->timeout_source = NULL;
+    tr = g_hash_table_lookup (self->priv->transactions, key);
+
+    /* The transaction may have already been cancelled before we stored it in
+     * the tracking table, or completed before the abort got scheduled in the
+     * I/O context */
+    if (!tr || tr->cancellable != cancellable)
+        return;
+
+    g_hash_table_remove (self->priv->transactions, key);
 
-    /* Complete transaction with a timeout error */
-    error = g_error_new (QMI_CORE_ERROR,
-                         QMI_CORE_ERROR_TIMEOUT,
-                         "Transaction timed out");
+    /* Cannot disconnect from within the handler itself */
+    if (in_handler)
+        tr->cancellable_id = 0;
+
+    /* Complete transaction with an abort error */
+    error = g_error_new (QMI_PROTOCOL_ERROR,
+                         QMI_PROTOCOL_ERROR_ABORTED,
+                         "Transaction aborted");
     transaction_complete_and_free (tr, NULL, error);
     g_error_free (error);
+}
 
-    return FALSE;
+typedef struct {
+    QmiDevice    *self;
+    gpointer      key;
+    GCancellable *cancellable;
+} TransactionAbortContext;
+
+static void
+transaction_abort_context_free (TransactionAbortContext *ctx)
+{
+    g_object_unref (ctx->cancellable);
+    g_object_unref (ctx->self);
+    g_slice_free (TransactionAbortContext, ctx);
+}
+
+static gboolean
+transaction_abort_idle (TransactionAbortContext *ctx)
+{
+    transaction_abort (ctx->self, ctx->key, ctx->cancellable, FALSE);
+    return G_SOURCE_REMOVE;
 }
 
 static void
 transaction_cancelled (GCancellable *cancellable,
-                       TransactionWaitContext *ctx)
+                       Transaction  *pending)
 {
-    Transaction *tr;
-    GError *error = NULL;
-
-    tr = device_release_transaction (ctx->self, ctx->key);
+    QmiDevice *self = pending->self;
+    TransactionAbortContext *ctx;
+    GSource *source;
 
-    /* The transaction may have already been cancelled before we stored it in
-     * the tracking table */
-    if (!tr)
+    /* Cancelled in the thread owning the transactions, or in one that can
+     * own them for a while */
+    if (!self->priv->io_context || g_main_context_is_owner (self->priv->io_context)) {
+        transaction_abort (self, pending->key, cancellable, TRUE);
         return;
+    }
+    if (g_main_context_acquire (self->priv->io_context)) {
+        transaction_abort (self, pending->key, cancellable, TRUE);
+        g_main_context_release (self->priv->io_context);
+        return;
+    }
 
-    tr->cancellable_id = 0;
+    /* Otherwise, abort it in the I/O context. The transaction isn't freed
+     * until this handler returns, as disconnecting from the cancellable waits
+     * for it. */
+    ctx = g_slice_new (TransactionAbortContext);
+    ctx->self = g_object_ref (self);
+    ctx->key = pending->key;
+    ctx->cancellable = g_object_ref (cancellable);
 
-    /* Complete transaction with an abort error */
-    error = g_error_new (QMI_PROTOCOL_ERROR,
-                         QMI_PROTOCOL_ERROR_ABORTED,
-                         "Transaction aborted");
-    transaction_complete_and_free (tr, NULL, error);
-    g_error_free (error);
+    source = g_idle_source_new ();
+    g_source_set_callback (source,
+                           (GSourceFunc) transaction_abort_idle,
+                           ctx,
+                           (GDestroyNotify) transaction_abort_context_free);
+    g_source_attach (source, self->priv->io_context);
+    g_source_unref (source);
 }
 
 static gboolean
@@ -290,24 +834,15 @@ device_store_transaction (QmiDevice *self,
 
     /* Setup the timeout and cancellation */
 
-    tr->wait_ctx = g_slice_new (TransactionWaitContext);
-    tr->wait_ctx->self = self;
-    tr->wait_ctx->key = key; /* valid as long as the transaction is in the HT */
-
-    /* Timeout is optional (e.g. disabled when MBIM is used) */
-    if (timeout > 0) {
-        tr->timeout_source = g_timeout_source_new_seconds (timeout);
-        g_source_set_callback (tr->timeout_source, (GSourceFunc)transaction_timed_out, tr->wait_ctx, NULL);
-        g_source_attach (tr->timeout_source, g_main_context_get_thread_default ());
-        g_source_unref (tr->timeout_source);
-    }
+    tr->self = self;
+    tr->key = key;
 
     if (tr->cancellable) {
         /* Note: transaction_cancelled() will also be called directly if the
          * cancellable is already cancelled */
         tr->cancellable_id = g_cancellable_connect (tr->cancellable,
                                                     (GCallback)transaction_cancelled,
-                                                    tr->wait_ctx,
+                                                    tr,
                                                     NULL);
         if (!tr->cancellable_id) {
             g_set_error (error,
@@ -318,34 +853,343 @@ device_store_transaction (QmiDevice *self,
         }
     }
 
-    /* If we have already a transaction with the same ID complete the existing
-     * one with an error before the new one is added, or we'll end up with
-     * dangling timeouts and cancellation handlers that may be fired off later
-     * on. */
-    existing = device_release_transaction (self, key);
-    if (existing) {
-        GError *inner_error;
+    /* If we have already a transaction with the same ID complete the existing
+     * one with an error before the new one is added, or we'll end up with
+     * dangling timeouts and cancellation handlers that may be fired off later
+     * on. */
+    existing = device_release_transaction (self, key);
+    if (existing) {
+        GError *inner_error;
+
+        /* Complete transaction with an abort error */
+        inner_error = g_error_new (QMI_PROTOCOL_ERROR,
+                                   QMI_PROTOCOL_ERROR_ABORTED,
+                                   "Transaction overwritten");
+        transaction_complete_and_free (existing, NULL, inner_error);
+        g_error_free (inner_error);
+    }
+
+    /* Timeout is optional (e.g. disabled when MBIM is used) */
+    if (timeout > 0)
+        timeout_heap_add (self, tr, timeout);
+
+    /* Keep in the HT */
+    g_hash_table_insert (self->priv->transactions, key, tr);
+    device_stats_request_started (self, tr);
+
+    return TRUE;
+}
+
+static Transaction *
+device_match_transaction (QmiDevice *self,
+                          QmiMessage *message)
+{
+    /* msg can be either the original message or the response */
+    return device_release_transaction (self, build_transaction_key (message));
+}
+
+/*****************************************************************************/
+/* Request coalescing and response cache (private)
+ *
+ * For the messages enabled with qmi_device_set_message_coalescing(), requests
+ * with the same service, message id, vendor and TLVs as one already in flight
+ * are not sent, they just get a copy of its response. Successful responses
+ * may also be kept for a while to serve new identical requests.
+ */
+
+/* Expired entries are only purged when the table grows over this size */
+#define COALESCE_ENTRIES_PURGE_SIZE 64
+
+struct _CoalesceEntry {
+    QmiDevice  *self;
+    GBytes     *key;
+    guint       message_key;
+
+    /* Set while the first request is in flight, with the transactions merged
+     * into it */
+    gboolean    in_flight;
+    GList      *waiters;
+
+    /* Cached response, and its monotonic expiration time */
+    QmiMessage *response;
+    gint64      expiration;
+};
+
+static void
+coalesce_entry_free (CoalesceEntry *entry)
+{
+    g_assert (!entry->waiters);
+
+    if (entry->response)
+        qmi_message_unref (entry->response);
+    g_bytes_unref (entry->key);
+    g_slice_free (CoalesceEntry, entry);
+}
+
+static gboolean
+coalesce_entry_is_expired (CoalesceEntry *entry,
+                           gint64         now)
+{
+    return (!entry->in_flight && (!entry->response || entry->expiration <= now));
+}
+
+static gboolean
+coalesce_entry_remove_expired (gpointer       key,
+                               CoalesceEntry *entry,
+                               gint64        *now)
+{
+    return coalesce_entry_is_expired (entry, *now);
+}
+
+static gboolean
+coalesce_entry_remove_cached (gpointer       key,
+                              CoalesceEntry *entry,
+                              gpointer       message_key)
+{
+    return (!entry->in_flight && entry->message_key == GPOINTER_TO_UINT (message_key));
+}
+
+static GBytes *
+coalesce_key_new (QmiMessage        *message,
+                  QmiMessageContext *message_context)
+{
+    GByteArray   *key;
+    const guint8 *tlvs;
+    gsize         tlvs_length;
+    guint8        header[5];
+    guint16       message_id;
+    guint16       vendor_id;
+
+    message_id = qmi_message_get_message_id (message);
+    vendor_id = (message_context ?
+                 qmi_message_context_get_vendor_id (message_context) :
+                 QMI_MESSAGE_VENDOR_GENERIC);
+
+    header[0] = (guint8)qmi_message_get_service (message);
+    header[1] = message_id & 0xFF;
+    header[2] = message_id >> 8;
+    header[3] = vendor_id & 0xFF;
+    header[4] = vendor_id >> 8;
+
+    tlvs = __qmi_message_get_tlvs (message, &tlvs_length);
+    key = g_byte_array_sized_new (sizeof (header) + tlvs_length);
+    g_byte_array_append (key, header, sizeof (header));
+    g_byte_array_append (key, tlvs, tlvs_length);
+
+    return g_byte_array_free_to_bytes (key);
+}
+
+static gboolean
+response_is_successful (QmiMessage *response)
+{
+    gsize   init_offset;
+    gsize   offset = 0;
+    guint16 error_status;
+
+    init_offset = qmi_message_tlv_read_init (response, 0x02, NULL, NULL);
+    return (init_offset > 0 &&
+            qmi_message_tlv_read_guint16 (response, init_offset, &offset, QMI_ENDIAN_LITTLE, &error_status, NULL) &&
+            error_status == 0x00);
+}
+
+/* Completes a transaction which was never sent */
+static void
+transaction_complete_from_response (Transaction  *tr,
+                                    QmiMessage   *reply,
+                                    const GError *error)
+{
+    QmiMessage *copy;
+    GError     *inner_error;
+
+    if (tr->cancellable && g_cancellable_is_cancelled (tr->cancellable)) {
+        inner_error = g_error_new (QMI_PROTOCOL_ERROR,
+                                   QMI_PROTOCOL_ERROR_ABORTED,
+                                   "Transaction aborted");
+        transaction_complete_and_free (tr, NULL, inner_error);
+        g_error_free (inner_error);
+        return;
+    }
+
+    if (!reply) {
+        transaction_complete_and_free (tr, NULL, error);
+        return;
+    }
+
+    /* Each caller gets the response addressed to its own request */
+    copy = __qmi_message_dup_for_client (reply,
+                                         qmi_message_get_client_id (tr->message),
+                                         qmi_message_get_transaction_id (tr->message));
+    transaction_complete_and_free (tr, copy, NULL);
+    qmi_message_unref (copy);
+}
+
+/* Waiters cancelled or timed out before the request they wait for */
+static void
+coalesce_entry_remove_waiter (CoalesceEntry *entry,
+                              Transaction   *tr)
+{
+    entry->waiters = g_list_remove (entry->waiters, tr);
+    tr->coalesced_into = NULL;
+}
+
+static void device_command_send (QmiDevice   *self,
+                                 Transaction *tr);
+
+/* The oldest waiter is sent in place of the request it waited for, and the
+ * other waiters now wait for it */
+static void
+coalesce_entry_promote_waiter (CoalesceEntry *entry)
+{
+    Transaction *tr;
+    GList       *first;
+
+    /* Waiters are prepended */
+    first = g_list_last (entry->waiters);
+    tr = first->data;
+    entry->waiters = g_list_delete_link (entry->waiters, first);
+
+    tr->coalesced_into = NULL;
+    tr->coalesce_entry = entry;
+    device_command_send (entry->self, tr);
+}
+
+static void
+coalesce_entry_complete (CoalesceEntry *entry,
+                         QmiMessage    *reply,
+                         const GError  *error)
+{
+    QmiDevice *self = entry->self;
+    GList     *waiters;
+    GList     *l;
+    guint      ttl;
+
+    /* Only actual responses and transport errors are shared with the waiters.
+     * If the request was cancelled or timed out on its own, it tells nothing
+     * about the others, which keep their own cancellation and timeout, so one
+     * of them is sent instead. Note that the entry must not be used after the
+     * promotion, as it may have been completed already. */
+    if (!reply && entry->waiters &&
+        (g_error_matches (error, QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_ABORTED) ||
+         g_error_matches (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT))) {
+        coalesce_entry_promote_waiter (entry);
+        return;
+    }
+
+    waiters = g_list_reverse (entry->waiters);
+    entry->waiters = NULL;
+    entry->in_flight = FALSE;
+
+    for (l = waiters; l; l = g_list_next (l)) {
+        Transaction *tr = l->data;
+
+        /* Waiters are tracked like any other transaction until now */
+        g_hash_table_remove (self->priv->transactions, tr->key);
+        tr->coalesced_into = NULL;
+        transaction_complete_from_response (tr, reply, error);
+    }
+    g_list_free (waiters);
+
+    ttl = GPOINTER_TO_UINT (g_hash_table_lookup (self->priv->coalesced_messages,
+                                                 GUINT_TO_POINTER (entry->message_key)));
+    if (reply && ttl > 0 && response_is_successful (reply)) {
+        entry->response = qmi_message_ref (reply);
+        entry->expiration = g_get_monotonic_time () + ((gint64) ttl * 1000);
+        return;
+    }
+
+    g_hash_table_remove (self->priv->coalesce_entries, entry->key);
+}
+
+/* Returns TRUE if the transaction was merged into an identical one in flight
+ * or completed, from the cache or with an error, in which case it must not be
+ * sent */
+static gboolean
+coalesce_request (QmiDevice   *self,
+                  Transaction *tr,
+                  guint        timeout)
+{
+    CoalesceEntry *entry;
+    GBytes        *key;
+    guint          message_key;
+    gint64         now;
 
-        /* Complete transaction with an abort error */
-        inner_error = g_error_new (QMI_PROTOCOL_ERROR,
-                                   QMI_PROTOCOL_ERROR_ABORTED,
-                                   "Transaction overwritten");
-        transaction_complete_and_free (existing, NULL, inner_error);
-        g_error_free (inner_error);
+    message_key = build_message_key (tr->message);
+    if (!g_hash_table_contains (self->priv->coalesced_messages, GUINT_TO_POINTER (message_key)))
+        return FALSE;
+
+    now = g_get_monotonic_time ();
+    key = coalesce_key_new (tr->message, tr->message_context);
+    entry = g_hash_table_lookup (self->priv->coalesce_entries, key);
+    if (entry && coalesce_entry_is_expired (entry, now)) {
+        g_hash_table_remove (self->priv->coalesce_entries, key);
+        entry = NULL;
     }
 
-    /* Keep in the HT */
-    g_hash_table_insert (self->priv->transactions, key, tr);
+    if (entry) {
+        g_bytes_unref (key);
+        if (entry->in_flight) {
+            GError *error = NULL;
 
-    return TRUE;
+            /* Waiters keep their own timeout and cancellation, as if they
+             * had been sent */
+            if (!device_store_transaction (self, tr, timeout, &error)) {
+                g_prefix_error (&error, "Cannot store transaction: ");
+                transaction_complete_and_free (tr, NULL, error);
+                g_error_free (error);
+                return TRUE;
+            }
+            device_stats_lookup (self, tr->message)->coalesced++;
+            tr->coalesced_into = entry;
+            entry->waiters = g_list_prepend (entry->waiters, tr);
+        } else {
+            tr->self = self;
+            device_stats_request_started (self, tr);
+            device_stats_lookup (self, tr->message)->cached++;
+            transaction_complete_from_response (tr, entry->response, NULL);
+        }
+        return TRUE;
+    }
+
+    if (g_hash_table_size (self->priv->coalesce_entries) >= COALESCE_ENTRIES_PURGE_SIZE)
+        g_hash_table_foreach_remove (self->priv->coalesce_entries,
+                                     (GHRFunc)coalesce_entry_remove_expired,
+                                     &now);
+
+    /* This one will be sent, identical requests wait for it */
+    entry = g_slice_new0 (CoalesceEntry);
+    entry->self = self;
+    entry->key = key;
+    entry->message_key = message_key;
+    entry->in_flight = TRUE;
+    g_hash_table_insert (self->priv->coalesce_entries, key, entry);
+    tr->coalesce_entry = entry;
+    return FALSE;
 }
 
-static Transaction *
-device_match_transaction (QmiDevice *self,
-                          QmiMessage *message)
+void
+qmi_device_set_message_coalescing (QmiDevice  *self,
+                                   QmiService  service,
+                                   guint16     message_id,
+                                   gboolean    enabled,
+                                   guint       cache_ttl)
 {
-    /* msg can be either the original message or the response */
-    return device_release_transaction (self, build_transaction_key (message));
+    guint message_key;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (service <= G_MAXUINT8);
+
+    message_key = ((guint)service << 16) | message_id;
+    if (enabled)
+        g_hash_table_insert (self->priv->coalesced_messages,
+                             GUINT_TO_POINTER (message_key),
+                             GUINT_TO_POINTER (cache_ttl));
+    else
+        g_hash_table_remove (self->priv->coalesced_messages, GUINT_TO_POINTER (message_key));
+
+    /* Responses cached with the previous setup are no longer valid */
+    g_hash_table_foreach_remove (self->priv->coalesce_entries,
+                                 (GHRFunc)coalesce_entry_remove_cached,
+                                 GUINT_TO_POINTER (message_key));
 }
 
 /*****************************************************************************/
@@ -426,14 +1270,27 @@ qmi_device_get_service_version_info (QmiDevice *self,
 /*****************************************************************************/
 /* Version info checks (private) */
 
-static const QmiMessageCtlGetVersionInfoOutputServiceListService *
-find_service_version_info (QmiDevice *self,
-                           QmiService service)
+static void
+service_table_clear (QmiDevice *self)
+{
+    guint i;
+
+    memset (self->priv->service_table, 0, sizeof (self->priv->service_table));
+
+    /* The reported message lists may not apply to the new versions */
+    for (i = 0; i < G_N_ELEMENTS (self->priv->supported_messages); i++)
+        g_clear_pointer (&self->priv->supported_messages[i], g_array_unref);
+}
+
+static void
+service_table_build (QmiDevice *self)
 {
     guint i;
 
+    service_table_clear (self);
+
     if (!self->priv->supported_services)
-        return NULL;
+        return;
 
     for (i = 0; i < self->priv->supported_services->len; i++) {
         const QmiMessageCtlGetVersionInfoOutputServiceListService *info;
@@ -442,11 +1299,40 @@ find_service_version_info (QmiDevice *self,
                                QmiMessageCtlGetVersionInfoOutputServiceListService,
                                i);
 
-        if (service == info->service)
-            return info;
+        /* Keep the first one if reported twice */
+        if ((guint)info->service <= G_MAXUINT8 && !self->priv->service_table[info->service])
+            self->priv->service_table[info->service] = info;
     }
+}
+
+static inline const QmiMessageCtlGetVersionInfoOutputServiceListService *
+find_service_version_info (QmiDevice *self,
+                           QmiService service)
+{
+    if ((guint)service > G_MAXUINT8)
+        return NULL;
+
+    return self->priv->service_table[service];
+}
+
+static inline gboolean
+find_message_supported (QmiDevice *self,
+                        QmiService service,
+                        guint16 message_id)
+{
+    GArray *supported_messages;
+
+    if ((guint)service > G_MAXUINT8)
+        return TRUE;
+
+    /* If we don't know the supported messages, assume it is supported */
+    supported_messages = self->priv->supported_messages[service];
+    if (!supported_messages)
+        return TRUE;
 
-    return NULL;
+    /* Bit N of byte M is set if message (8 * M + N) is supported */
+    return ((message_id / 8) < supported_messages->len &&
+            (g_array_index (supported_messages, guint8, message_id / 8) & (1 << (message_id % 8))));
 }
 
 static gboolean
@@ -475,14 +1361,25 @@ check_message_supported (QmiDevice *self,
     guint device_major = 0;
     guint device_minor = 0;
 
-    /* If we didn't check supported services, just assume it is supported */
-    if (!self->priv->supported_services)
-        return TRUE;
-
     /* For CTL, we assume all are supported */
     if (qmi_message_get_service (message) == QMI_SERVICE_CTL)
         return TRUE;
 
+    /* If the service reported its supported messages, check the list */
+    if (!find_message_supported (self, qmi_message_get_service (message), qmi_message_get_message_id (message))) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_UNSUPPORTED,
+                     "QMI service '%s' doesn't support message '0x%04x'",
+                     qmi_service_get_string (qmi_message_get_service (message)),
+                     qmi_message_get_message_id (message));
+        return FALSE;
+    }
+
+    /* If we didn't check supported services, just assume it is supported */
+    if (!self->priv->supported_services)
+        return TRUE;
+
     /* If we cannot get in which version this message was introduced, we'll just
      * assume it's supported */
     if (!qmi_message_get_version_introduced (message, &message_major, &message_minor))
@@ -530,6 +1427,63 @@ check_message_supported (QmiDevice *self,
     return TRUE;
 }
 
+gboolean
+qmi_device_get_service_version (QmiDevice  *self,
+                                QmiService  service,
+                                guint16    *major,
+                                guint16    *minor)
+{
+    const QmiMessageCtlGetVersionInfoOutputServiceListService *info;
+
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+
+    info = find_service_version_info (self, service);
+    if (!info)
+        return FALSE;
+
+    if (major)
+        *major = info->major_version;
+    if (minor)
+        *minor = info->minor_version;
+    return TRUE;
+}
+
+void
+qmi_device_set_service_supported_messages (QmiDevice  *self,
+                                           QmiService  service,
+                                           GArray     *supported_messages)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail ((guint)service <= G_MAXUINT8);
+    g_return_if_fail (service != QMI_SERVICE_CTL);
+    g_return_if_fail (!supported_messages || g_array_get_element_size (supported_messages) == sizeof (guint8));
+
+    g_clear_pointer (&self->priv->supported_messages[service], g_array_unref);
+    if (!supported_messages)
+        return;
+
+    self->priv->supported_messages[service] = g_array_sized_new (FALSE, FALSE, sizeof (guint8), supported_messages->len);
+    g_array_append_vals (self->priv->supported_messages[service],
+                         supported_messages->data,
+                         supported_messages->len);
+}
+
+gboolean
+qmi_device_is_message_supported (QmiDevice  *self,
+                                 QmiService  service,
+                                 guint16     message_id)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+
+    if (service == QMI_SERVICE_CTL)
+        return TRUE;
+
+    if (self->priv->supported_services && !find_service_version_info (self, service))
+        return FALSE;
+
+    return find_message_supported (self, service, message_id);
+}
+
 /*****************************************************************************/
 
 GFile *
@@ -821,39 +1775,378 @@ build_registered_client_key (guint8 cid,
 }
 
 static gboolean
-register_client (QmiDevice *self,
-                 QmiClient *client,
-                 GError **error)
+register_client (QmiDevice *self,
+                 QmiClient *client,
+                 GError **error)
+{
+    gpointer key;
+    GPtrArray *clients;
+
+    key = build_registered_client_key (qmi_client_get_cid (client),
+                                       qmi_client_get_service (client));
+    /* Only add the new client if not already registered one with the same CID
+     * for the same service */
+    if (g_hash_table_lookup (self->priv->registered_clients, key)) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_FAILED,
+                     "A client with CID '%u' and service '%s' is already registered",
+                     qmi_client_get_cid (client),
+                     qmi_service_get_string (qmi_client_get_service (client)));
+        return FALSE;
+    }
+
+    g_hash_table_insert (self->priv->registered_clients,
+                         key,
+                         g_object_ref (client));
+
+    /* Also index by service */
+    clients = g_hash_table_lookup (self->priv->service_clients,
+                                   GUINT_TO_POINTER (qmi_client_get_service (client)));
+    if (!clients) {
+        clients = g_ptr_array_new ();
+        g_hash_table_insert (self->priv->service_clients,
+                             GUINT_TO_POINTER (qmi_client_get_service (client)),
+                             clients);
+    }
+    g_ptr_array_add (clients, client);
+
+    return TRUE;
+}
+
+static void
+unregister_client (QmiDevice *self,
+                   QmiClient *client)
+{
+    gpointer   key;
+    GPtrArray *clients;
+
+    key = build_registered_client_key (qmi_client_get_cid (client),
+                                       qmi_client_get_service (client));
+
+    /* Only the registered client instance is removed from the index */
+    if (g_hash_table_lookup (self->priv->registered_clients, key) != client)
+        return;
+
+    clients = g_hash_table_lookup (self->priv->service_clients,
+                                   GUINT_TO_POINTER (qmi_client_get_service (client)));
+    if (clients) {
+        g_ptr_array_remove_fast (clients, client);
+        if (clients->len == 0)
+            g_hash_table_remove (self->priv->service_clients,
+                                 GUINT_TO_POINTER (qmi_client_get_service (client)));
+    }
+
+    g_hash_table_remove (self->priv->registered_clients, key);
+}
+
+/*****************************************************************************/
+/* CID pool
+ *
+ * CIDs of the services with a pool enabled are not released along with their
+ * clients, they are kept and given to the next clients of the same service.
+ * Whenever the pool goes below its low watermark, new CIDs are allocated in
+ * the background, one by one, until reaching the high watermark.
+ */
+
+#define CID_POOL_TIMEOUT 10
+
+struct _CidPool {
+    guint    low_watermark;
+    guint    high_watermark;
+    GArray  *cids;
+    gboolean refilling;
+};
+
+typedef struct {
+    QmiDevice  *self;
+    QmiService  service;
+} CidPoolRefillContext;
+
+static void cid_pool_refill (QmiDevice  *self,
+                             QmiService  service);
+static void close_context_release_done (GTask *task);
+
+static void
+cid_pool_free (CidPool *pool)
+{
+    g_array_unref (pool->cids);
+    g_slice_free (CidPool, pool);
+}
+
+static void
+cid_pool_release_cid_ready (QmiClientCtl *client_ctl,
+                            GAsyncResult *res,
+                            GTask        *task)
+{
+    QmiMessageCtlReleaseCidOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_ctl_release_cid_finish (client_ctl, res, &error);
+    if (!output || !qmi_message_ctl_release_cid_output_get_result (output, &error)) {
+        g_debug ("Couldn't release pooled CID: %s", error->message);
+        g_error_free (error);
+    }
+
+    if (output)
+        qmi_message_ctl_release_cid_output_unref (output);
+
+    /* Closing the device waits for the pooled CIDs to be released */
+    if (task)
+        close_context_release_done (task);
+}
+
+static void
+cid_pool_release_cid (QmiDevice  *self,
+                      QmiService  service,
+                      guint8      cid,
+                      guint       timeout,
+                      GTask      *task)
+{
+    QmiMessageCtlReleaseCidInput *input;
+
+    g_debug ("[%s] Releasing pooled '%s' client ID '%u'...",
+             self->priv->path_display,
+             qmi_service_get_string (service),
+             cid);
+
+    input = qmi_message_ctl_release_cid_input_new ();
+    qmi_message_ctl_release_cid_input_set_release_info (input, service, cid, NULL);
+    qmi_client_ctl_release_cid (self->priv->client_ctl,
+                                input,
+                                timeout,
+                                NULL,
+                                (GAsyncReadyCallback)cid_pool_release_cid_ready,
+                                task);
+    qmi_message_ctl_release_cid_input_unref (input);
+}
+
+static void
+cid_pool_allocate_cid_ready (QmiClientCtl         *client_ctl,
+                             GAsyncResult         *res,
+                             CidPoolRefillContext *ctx)
+{
+    QmiDevice *self = ctx->self;
+    QmiMessageCtlAllocateCidOutput *output;
+    CidPool *pool;
+    QmiService service;
+    guint8 cid;
+    GError *error = NULL;
+
+    pool = self->priv->cid_pools[ctx->service];
+
+    output = qmi_client_ctl_allocate_cid_finish (client_ctl, res, &error);
+    if (!output ||
+        !qmi_message_ctl_allocate_cid_output_get_result (output, &error) ||
+        !qmi_message_ctl_allocate_cid_output_get_allocation_info (output, &service, &cid, &error)) {
+        /* Retried next time a CID is taken from the pool */
+        g_debug ("[%s] Couldn't refill '%s' CID pool: %s",
+                 self->priv->path_display,
+                 qmi_service_get_string (ctx->service),
+                 error->message);
+        g_error_free (error);
+        if (pool)
+            pool->refilling = FALSE;
+        goto out;
+    }
+
+    /* The device may have been closed, or the pool disabled or shrunk in
+     * the meantime */
+    if (!qmi_device_is_open (self) || !pool || pool->cids->len >= pool->high_watermark) {
+        if (qmi_device_is_open (self))
+            cid_pool_release_cid (self, service, cid, CID_POOL_TIMEOUT, NULL);
+        if (pool)
+            pool->refilling = FALSE;
+        goto out;
+    }
+
+    g_array_append_val (pool->cids, cid);
+    pool->refilling = FALSE;
+    cid_pool_refill (self, ctx->service);
+
+out:
+    if (output)
+        qmi_message_ctl_allocate_cid_output_unref (output);
+    g_object_unref (ctx->self);
+    g_slice_free (CidPoolRefillContext, ctx);
+}
+
+static void
+cid_pool_refill (QmiDevice  *self,
+                 QmiService  service)
+{
+    QmiMessageCtlAllocateCidInput *input;
+    CidPoolRefillContext *ctx;
+    CidPool *pool;
+
+    pool = self->priv->cid_pools[service];
+    if (!pool || pool->refilling || pool->cids->len >= pool->high_watermark)
+        return;
+
+    /* Nothing to do until the device is open */
+    if (!qmi_device_is_open (self)
+#if defined MBIM_QMUX_ENABLED
+        && !self->priv->mbimdev
+#endif
+        )
+        return;
+
+    ctx = g_slice_new (CidPoolRefillContext);
+    ctx->self = g_object_ref (self);
+    ctx->service = service;
+
+    pool->refilling = TRUE;
+    input = qmi_message_ctl_allocate_cid_input_new ();
+    qmi_message_ctl_allocate_cid_input_set_service (input, service, NULL);
+    qmi_client_ctl_allocate_cid (self->priv->client_ctl,
+                                 input,
+                                 CID_POOL_TIMEOUT,
+                                 NULL,
+                                 (GAsyncReadyCallback)cid_pool_allocate_cid_ready,
+                                 ctx);
+    qmi_message_ctl_allocate_cid_input_unref (input);
+}
+
+static void
+cid_pools_refill (QmiDevice *self)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (self->priv->cid_pools); i++) {
+        CidPool *pool = self->priv->cid_pools[i];
+
+        if (pool && pool->cids->len < pool->low_watermark)
+            cid_pool_refill (self, (QmiService)i);
+    }
+}
+
+/* Pooled CIDs are only valid while the device is open: they're either released,
+ * each release holding a reference to @task until it's done, or just dropped.
+ * Returns the number of releases requested. */
+static guint
+cid_pools_flush (QmiDevice *self,
+                 gboolean   release,
+                 guint      timeout,
+                 GTask     *task)
+{
+    guint n_releases = 0;
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (self->priv->cid_pools); i++) {
+        CidPool *pool = self->priv->cid_pools[i];
+        guint    j;
+
+        if (!pool)
+            continue;
+
+        for (j = 0; release && j < pool->cids->len; j++) {
+            cid_pool_release_cid (self,
+                                  (QmiService)i,
+                                  g_array_index (pool->cids, guint8, j),
+                                  timeout,
+                                  task ? g_object_ref (task) : NULL);
+            n_releases++;
+        }
+        g_array_set_size (pool->cids, 0);
+    }
+
+    return n_releases;
+}
+
+static gboolean
+cid_pool_take (QmiDevice  *self,
+               QmiService  service,
+               guint8     *cid)
+{
+    CidPool *pool;
+
+    *cid = QMI_CID_NONE;
+
+    if ((guint)service > G_MAXUINT8)
+        return FALSE;
+
+    pool = self->priv->cid_pools[service];
+    if (!pool)
+        return FALSE;
+
+    if (pool->cids->len > 0) {
+        *cid = g_array_index (pool->cids, guint8, pool->cids->len - 1);
+        g_array_set_size (pool->cids, pool->cids->len - 1);
+    }
+
+    if (pool->cids->len < pool->low_watermark)
+        cid_pool_refill (self, service);
+
+    return (*cid != QMI_CID_NONE);
+}
+
+static gboolean
+cid_pool_put (QmiDevice  *self,
+              QmiService  service,
+              guint8      cid)
 {
-    gpointer key;
+    CidPool *pool;
 
-    key = build_registered_client_key (qmi_client_get_cid (client),
-                                       qmi_client_get_service (client));
-    /* Only add the new client if not already registered one with the same CID
-     * for the same service */
-    if (g_hash_table_lookup (self->priv->registered_clients, key)) {
-        g_set_error (error,
-                     QMI_CORE_ERROR,
-                     QMI_CORE_ERROR_FAILED,
-                     "A client with CID '%u' and service '%s' is already registered",
-                     qmi_client_get_cid (client),
-                     qmi_service_get_string (qmi_client_get_service (client)));
+    if ((guint)service > G_MAXUINT8)
         return FALSE;
-    }
 
-    g_hash_table_insert (self->priv->registered_clients,
-                         key,
-                         g_object_ref (client));
+    pool = self->priv->cid_pools[service];
+    if (!pool || pool->cids->len >= pool->high_watermark)
+        return FALSE;
+
+    g_array_append_val (pool->cids, cid);
     return TRUE;
 }
 
-static void
-unregister_client (QmiDevice *self,
-                   QmiClient *client)
+void
+qmi_device_set_cid_pool (QmiDevice  *self,
+                         QmiService  service,
+                         guint       low_watermark,
+                         guint       high_watermark)
+{
+    CidPool *pool;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (service > QMI_SERVICE_CTL && (guint)service <= G_MAXUINT8);
+    g_return_if_fail (low_watermark <= high_watermark);
+
+    pool = self->priv->cid_pools[service];
+    if (!pool) {
+        if (!high_watermark)
+            return;
+        pool = g_slice_new0 (CidPool);
+        pool->cids = g_array_new (FALSE, FALSE, sizeof (guint8));
+        self->priv->cid_pools[service] = pool;
+    }
+
+    pool->low_watermark = low_watermark;
+    pool->high_watermark = high_watermark;
+
+    /* Release the CIDs over the new limit */
+    while (pool->cids->len > high_watermark) {
+        if (qmi_device_is_open (self))
+            cid_pool_release_cid (self, service, g_array_index (pool->cids, guint8, pool->cids->len - 1), CID_POOL_TIMEOUT, NULL);
+        g_array_set_size (pool->cids, pool->cids->len - 1);
+    }
+
+    /* If disabled, a refill in progress will release its CID once done */
+    if (!high_watermark) {
+        g_clear_pointer (&self->priv->cid_pools[service], cid_pool_free);
+        return;
+    }
+
+    if (pool->cids->len < pool->low_watermark)
+        cid_pool_refill (self, service);
+}
+
+guint
+qmi_device_get_cid_pool_size (QmiDevice  *self,
+                              QmiService  service)
 {
-    g_hash_table_remove (self->priv->registered_clients,
-                         build_registered_client_key (qmi_client_get_cid (client),
-                                                      qmi_client_get_service (client)));
+    g_return_val_if_fail (QMI_IS_DEVICE (self), 0);
+    g_return_val_if_fail ((guint)service <= G_MAXUINT8, 0);
+
+    return (self->priv->cid_pools[service] ? self->priv->cid_pools[service]->cids->len : 0);
 }
 
 /*****************************************************************************/
@@ -1095,6 +2388,15 @@ qmi_device_allocate_client (QmiDevice *self,
         return;
     }
 
+    /* Take one from the pool, if any */
+    if (cid == QMI_CID_NONE && cid_pool_take (self, service, &ctx->cid)) {
+        g_debug ("[%s] Using pooled client ID '%u'...",
+                 self->priv->path_display,
+                 ctx->cid);
+        build_client_object (task);
+        return;
+    }
+
     /* Allocate a new CID for the client to be created */
     if (cid == QMI_CID_NONE) {
         QmiMessageCtlAllocateCidInput *input;
@@ -1228,6 +2530,17 @@ qmi_device_release_client (QmiDevice *self,
 
     g_object_unref (client);
 
+    /* Keep the CID for the next client, if there is a pool with room */
+    if ((flags & QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID) && cid_pool_put (self, service, cid)) {
+        g_debug ("[%s] Returned '%s' client ID '%u' to the pool",
+                 self->priv->path_display,
+                 qmi_service_get_string (service),
+                 cid);
+        g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
+        return;
+    }
+
     if (flags & QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID) {
         QmiMessageCtlReleaseCidInput *input;
 
@@ -1335,38 +2648,70 @@ qmi_device_set_instance_id (QmiDevice *self,
 typedef struct {
     QmiClient *client;
     QmiMessage *message;
-} IdleIndicationContext;
+} PendingIndication;
 
-static gboolean
-process_indication_idle (IdleIndicationContext *ctx)
+static void
+pending_indication_free (PendingIndication *pending)
 {
-    g_assert (ctx->client != NULL);
-    g_assert (ctx->message != NULL);
+    g_object_unref (pending->client);
+    qmi_message_unref (pending->message);
+    g_slice_free (PendingIndication, pending);
+}
 
-    __qmi_client_process_indication (ctx->client, ctx->message);
+static gboolean
+process_indications_idle (QmiDevice *self)
+{
+    GQueue             queue;
+    PendingIndication *pending;
+
+    /* Take all the pending indications at once; any indication reported
+     * while processing these ones will be dispatched in a new idle */
+    g_clear_pointer (&self->priv->indication_source, g_source_unref);
+    queue = *self->priv->indication_queue;
+    g_queue_init (self->priv->indication_queue);
+
+    while ((pending = g_queue_pop_head (&queue)) != NULL) {
+        __qmi_client_process_indication (pending->client, pending->message);
+        pending_indication_free (pending);
+    }
 
-    g_object_unref (ctx->client);
-    qmi_message_unref (ctx->message);
-    g_slice_free (IdleIndicationContext, ctx);
-    return FALSE;
+    return G_SOURCE_REMOVE;
 }
 
 static void
-report_indication (QmiClient *client,
+report_indication (QmiDevice *self,
+                   QmiClient *client,
                    QmiMessage *message)
 {
-    IdleIndicationContext *ctx;
-    GSource *source;
+    PendingIndication *pending;
+
+    /* Queue the indication to pass it down to the client in an idle */
+    pending = g_slice_new (PendingIndication);
+    pending->client = g_object_ref (client);
+    pending->message = qmi_message_ref (message);
+    g_queue_push_tail (self->priv->indication_queue, pending);
+
+    /* A single idle source for all the pending indications */
+    if (!self->priv->indication_source) {
+        self->priv->indication_source = g_idle_source_new ();
+        g_source_set_callback (self->priv->indication_source,
+                               (GSourceFunc)process_indications_idle,
+                               self,
+                               NULL);
+        g_source_attach (self->priv->indication_source, device_peek_context (self));
+    }
+}
 
-    /* Setup an idle to Pass the indication down to the client */
-    ctx = g_slice_new (IdleIndicationContext);
-    ctx->client = g_object_ref (client);
-    ctx->message = qmi_message_ref (message);
+static void
+indication_queue_clear (QmiDevice *self)
+{
+    if (self->priv->indication_source) {
+        g_source_destroy (self->priv->indication_source);
+        g_clear_pointer (&self->priv->indication_source, g_source_unref);
+    }
 
-    source = g_idle_source_new ();
-    g_source_set_callback (source, (GSourceFunc)process_indication_idle, ctx, NULL);
-    g_source_attach (source, g_main_context_get_thread_default ());
-    g_source_unref (source);
+    g_queue_free_full (self->priv->indication_queue, (GDestroyNotify)pending_indication_free);
+    self->priv->indication_queue = g_queue_new ();
 }
 
 static void
@@ -1381,6 +2726,14 @@ trace_message (QmiDevice         *self,
     const gchar *action_str;
     gchar       *vendor_str = NULL;
 
+    if (self->priv->capture)
+        __qmi_capture_add (self->priv->capture,
+                           g_get_real_time (),
+                           sent_or_received ? QMI_CAPTURE_DIRECTION_OUT : QMI_CAPTURE_DIRECTION_IN,
+                           message_context ? qmi_message_context_get_vendor_id (message_context) : QMI_MESSAGE_VENDOR_GENERIC,
+                           ((GByteArray *)message)->data,
+                           ((GByteArray *)message)->len);
+
     if (!qmi_utils_get_traces_enabled ())
         return;
 
@@ -1429,24 +2782,26 @@ static void
 process_message (QmiDevice *self,
                  QmiMessage *message)
 {
+    self->priv->stats.messages_in++;
+
     if (qmi_message_is_indication (message)) {
         /* Indication traces translated without an explicit vendor */
         trace_message (self, message, FALSE, "indication", NULL);
+        device_stats_indication (self, message);
 
         /* Generic emission of the indication */
         g_signal_emit (self, signals[SIGNAL_INDICATION], 0, message);
 
         if (qmi_message_get_client_id (message) == QMI_CID_BROADCAST) {
-            GHashTableIter iter;
-            gpointer key;
-            QmiClient *client;
-
-            g_hash_table_iter_init (&iter, self->priv->registered_clients);
-            while (g_hash_table_iter_next (&iter, &key, (gpointer *)&client)) {
-                /* For broadcast messages, report them just if the service matches */
-                if (qmi_message_get_service (message) == qmi_client_get_service (client))
-                    report_indication (client, message);
-            }
+            GPtrArray *clients;
+            guint i;
+
+            /* For broadcast messages, report them just to the clients of the
+             * same service */
+            clients = g_hash_table_lookup (self->priv->service_clients,
+                                           GUINT_TO_POINTER (qmi_message_get_service (message)));
+            for (i = 0; clients && i < clients->len; i++)
+                report_indication (self, QMI_CLIENT (g_ptr_array_index (clients, i)), message);
         } else {
             QmiClient *client;
 
@@ -1454,7 +2809,7 @@ process_message (QmiDevice *self,
                                           build_registered_client_key (qmi_message_get_client_id (message),
                                                                        qmi_message_get_service (message)));
             if (client)
-                report_indication (client, message);
+                report_indication (self, client, message);
         }
 
         return;
@@ -1485,26 +2840,33 @@ process_message (QmiDevice *self,
              self->priv->path_display);
 }
 
+/*****************************************************************************/
+
 static void
 parse_response (QmiDevice *self)
 {
-    do {
+    while (self->priv->buffer.end > self->priv->buffer.start) {
         GError *error = NULL;
         QmiMessage *message;
+        const guint8 *data;
+        gsize data_len;
+        gsize frame_len;
+
+        data = self->priv->buffer.data + self->priv->buffer.start;
+        data_len = self->priv->buffer.end - self->priv->buffer.start;
 
         /* Every message received must start with the QMUX marker.
          * If it doesn't, we broke framing :-/
          * If we broke framing, an error should be reported and the device
          * should get closed */
-        if (self->priv->buffer->len > 0 &&
-            self->priv->buffer->data[0] != QMI_MESSAGE_QMUX_MARKER) {
+        if (data[0] != QMI_MESSAGE_QMUX_MARKER) {
             /* TODO: Report fatal error */
             g_warning ("[%s] QMI framing error detected",
                        self->priv->path_display);
             return;
         }
 
-        message = qmi_message_new_from_raw (self->priv->buffer, &error);
+        message = __qmi_message_new_from_data (self->priv->message_pool, data, data_len, &frame_len, &error);
         if (!message) {
             if (!error)
                 /* More data we need */
@@ -1518,36 +2880,45 @@ parse_response (QmiDevice *self)
 
             if (qmi_utils_get_traces_enabled ()) {
                 gchar *printable;
-                guint len = MIN (self->priv->buffer->len, 2048);
+                guint len = MIN (frame_len, 2048);
 
-                printable = __qmi_utils_str_hex (self->priv->buffer->data, len, ':');
+                printable = __qmi_utils_str_hex (data, len, ':');
                 g_debug ("<<<<<< RAW INVALID MESSAGE:\n"
-                         "<<<<<<   length = %u\n"
+                         "<<<<<<   length = %" G_GSIZE_FORMAT "\n"
                          "<<<<<<   data   = %s\n",
-                         self->priv->buffer->len, /* show full buffer len */
+                         frame_len, /* show full frame len */
                          printable);
                 g_free (printable);
             }
 
+            self->priv->stats.bytes_in += frame_len;
+            __qmi_io_receive_buffer_consume (&self->priv->buffer, frame_len);
         } else {
+            /* The frame is already copied into the message, so drop it from
+             * the receive buffer before processing */
+            self->priv->stats.bytes_in += frame_len;
+            __qmi_io_receive_buffer_consume (&self->priv->buffer, frame_len);
+
             /* Play with the received message */
             process_message (self, message);
             qmi_message_unref (message);
         }
-    } while (self->priv->buffer->len > 0);
+    }
 }
 
 static gboolean
 input_ready_cb (GInputStream *istream,
                 QmiDevice *self)
 {
-    guint8 buffer[BUFFER_SIZE];
+    guint8 *buffer;
     GError *error = NULL;
     gssize r;
 
+    /* Read directly into the receive buffer */
+    buffer = __qmi_io_receive_buffer_reserve (&self->priv->buffer, self->priv->read_size);
     r = g_pollable_input_stream_read_nonblocking (G_POLLABLE_INPUT_STREAM (istream),
                                                   buffer,
-                                                  BUFFER_SIZE,
+                                                  self->priv->read_size,
                                                   NULL,
                                                   &error);
     if (r < 0) {
@@ -1567,10 +2938,7 @@ input_ready_cb (GInputStream *istream,
     }
 
     /* else, r > 0 */
-    if (!G_UNLIKELY (self->priv->buffer))
-        self->priv->buffer = g_byte_array_sized_new (r);
-    g_byte_array_append (self->priv->buffer, buffer, r);
-
+    __qmi_io_receive_buffer_commit (&self->priv->buffer, r);
     parse_response (self);
 
     return G_SOURCE_CONTINUE;
@@ -1624,7 +2992,7 @@ setup_iostream (GTask *task)
                            (GSourceFunc)input_ready_cb,
                            self,
                            NULL);
-    g_source_attach (self->priv->input_source, g_main_context_get_thread_default ());
+    g_source_attach (self->priv->input_source, device_peek_context (self));
 
     g_task_return_boolean (task, TRUE);
     g_object_unref (task);
@@ -1741,7 +3109,7 @@ create_iostream_with_socket (GTask *task)
         /* Wait some ms and retry */
         source = g_timeout_source_new (100);
         g_source_set_callback (source, (GSourceFunc)wait_for_proxy_cb, task, NULL);
-        g_source_attach (source, g_main_context_get_thread_default ());
+        g_source_attach (source, device_peek_context (self));
         g_source_unref (source);
         return;
     }
@@ -1792,6 +3160,253 @@ create_iostream (QmiDevice *self,
         create_iostream_with_fd (task);
 }
 
+/*****************************************************************************/
+/* Version info cache
+ *
+ * The list of supported services reported by the device is stored in a key
+ * file, in a group named after the device path, along with the identity of
+ * the firmware (USB ids and device release number). On the next open, if the
+ * identity matches, the cached list is used right away and the live query is
+ * only run afterwards to validate it.
+ */
+
+#define VERSION_INFO_CACHE_IDENTITY_KEY "identity"
+#define VERSION_INFO_CACHE_SERVICES_KEY "services"
+#define VERSION_INFO_VALIDATE_TIMEOUT   10
+
+static void
+set_supported_services (QmiDevice *self,
+                        GArray    *service_list)
+{
+    guint i;
+
+    if (self->priv->supported_services)
+        g_array_unref (self->priv->supported_services);
+    self->priv->supported_services = g_array_ref (service_list);
+    service_table_build (self);
+
+    g_debug ("[%s] QMI Device supports %u services:",
+             self->priv->path_display,
+             self->priv->supported_services->len);
+    for (i = 0; i < self->priv->supported_services->len; i++) {
+        QmiMessageCtlGetVersionInfoOutputServiceListService *info;
+        const gchar *service_str;
+
+        info = &g_array_index (self->priv->supported_services,
+                               QmiMessageCtlGetVersionInfoOutputServiceListService,
+                               i);
+        service_str = qmi_service_get_string (info->service);
+        if (service_str)
+            g_debug ("[%s]    %s (%u.%u)",
+                     self->priv->path_display,
+                     service_str,
+                     info->major_version,
+                     info->minor_version);
+        else
+            g_debug ("[%s]    unknown [0x%02x] (%u.%u)",
+                     self->priv->path_display,
+                     info->service,
+                     info->major_version,
+                     info->minor_version);
+    }
+}
+
+static gchar *
+version_info_cache_get_identity (QmiDevice *self)
+{
+    gchar *identity;
+
+    /* Without sysfs info (e.g. when testing) only the path is used as key,
+     * mismatches will still be found when validating */
+    identity = __qmi_utils_get_firmware_identity (self->priv->path);
+    return identity ? identity : g_strdup ("unknown");
+}
+
+static gboolean
+version_info_cache_load (QmiDevice *self)
+{
+    GKeyFile *key_file;
+    GError *error = NULL;
+    gchar *identity = NULL;
+    gchar *cached_identity = NULL;
+    gint *values = NULL;
+    gsize n_values = 0;
+    GArray *service_list;
+    gsize i;
+    gboolean loaded = FALSE;
+
+    if (!self->priv->version_info_cache || !self->priv->path)
+        return FALSE;
+
+    key_file = g_key_file_new ();
+    if (!g_key_file_load_from_file (key_file, self->priv->version_info_cache, G_KEY_FILE_NONE, &error)) {
+        g_debug ("[%s] Couldn't load version info cache: %s",
+                 self->priv->path_display,
+                 error->message);
+        g_error_free (error);
+        goto out;
+    }
+
+    identity = version_info_cache_get_identity (self);
+    cached_identity = g_key_file_get_string (key_file, self->priv->path, VERSION_INFO_CACHE_IDENTITY_KEY, NULL);
+    if (g_strcmp0 (identity, cached_identity) != 0) {
+        g_debug ("[%s] No cached version info for firmware '%s'",
+                 self->priv->path_display,
+                 identity);
+        goto out;
+    }
+
+    values = g_key_file_get_integer_list (key_file, self->priv->path, VERSION_INFO_CACHE_SERVICES_KEY, &n_values, NULL);
+    if (!values || n_values == 0 || (n_values % 3) != 0) {
+        g_debug ("[%s] Invalid cached version info", self->priv->path_display);
+        goto out;
+    }
+
+    /* Service, major and minor version of each service */
+    service_list = g_array_sized_new (FALSE, FALSE, sizeof (QmiMessageCtlGetVersionInfoOutputServiceListService), n_values / 3);
+    for (i = 0; i < n_values; i += 3) {
+        QmiMessageCtlGetVersionInfoOutputServiceListService info;
+
+        info.service = (QmiService)values[i];
+        info.major_version = (guint16)values[i + 1];
+        info.minor_version = (guint16)values[i + 2];
+        g_array_append_val (service_list, info);
+    }
+    set_supported_services (self, service_list);
+    g_array_unref (service_list);
+    loaded = TRUE;
+
+out:
+    g_free (values);
+    g_free (cached_identity);
+    g_free (identity);
+    g_key_file_free (key_file);
+    return loaded;
+}
+
+static void
+version_info_cache_store (QmiDevice *self)
+{
+    GKeyFile *key_file;
+    GError *error = NULL;
+    gchar *identity;
+    gchar *dirname;
+    gchar *data;
+    gsize data_len;
+    gint *values;
+    guint i;
+
+    if (!self->priv->version_info_cache || !self->priv->path || !self->priv->supported_services)
+        return;
+
+    /* Keep the entries of other devices */
+    key_file = g_key_file_new ();
+    g_key_file_load_from_file (key_file, self->priv->version_info_cache, G_KEY_FILE_KEEP_COMMENTS, NULL);
+
+    identity = version_info_cache_get_identity (self);
+    g_key_file_set_string (key_file, self->priv->path, VERSION_INFO_CACHE_IDENTITY_KEY, identity);
+    g_free (identity);
+
+    values = g_new (gint, self->priv->supported_services->len * 3);
+    for (i = 0; i < self->priv->supported_services->len; i++) {
+        QmiMessageCtlGetVersionInfoOutputServiceListService *info;
+
+        info = &g_array_index (self->priv->supported_services,
+                               QmiMessageCtlGetVersionInfoOutputServiceListService,
+                               i);
+        values[i * 3] = info->service;
+        values[i * 3 + 1] = info->major_version;
+        values[i * 3 + 2] = info->minor_version;
+    }
+    g_key_file_set_integer_list (key_file, self->priv->path, VERSION_INFO_CACHE_SERVICES_KEY, values, self->priv->supported_services->len * 3);
+    g_free (values);
+
+    dirname = g_path_get_dirname (self->priv->version_info_cache);
+    g_mkdir_with_parents (dirname, 0700);
+    g_free (dirname);
+
+    /* Written atomically, as other processes may be loading it */
+    data = g_key_file_to_data (key_file, &data_len, NULL);
+    if (!g_file_set_contents (self->priv->version_info_cache, data, data_len, &error)) {
+        g_debug ("[%s] Couldn't store version info cache: %s",
+                 self->priv->path_display,
+                 error->message);
+        g_error_free (error);
+    }
+    g_free (data);
+    g_key_file_free (key_file);
+}
+
+static gboolean
+service_lists_equal (GArray *a,
+                     GArray *b)
+{
+    guint i;
+
+    if (a->len != b->len)
+        return FALSE;
+
+    for (i = 0; i < a->len; i++) {
+        QmiMessageCtlGetVersionInfoOutputServiceListService *info_a;
+        QmiMessageCtlGetVersionInfoOutputServiceListService *info_b;
+
+        info_a = &g_array_index (a, QmiMessageCtlGetVersionInfoOutputServiceListService, i);
+        info_b = &g_array_index (b, QmiMessageCtlGetVersionInfoOutputServiceListService, i);
+        if (info_a->service != info_b->service ||
+            info_a->major_version != info_b->major_version ||
+            info_a->minor_version != info_b->minor_version)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+version_info_validate_ready (QmiClientCtl *client_ctl,
+                             GAsyncResult *res,
+                             QmiDevice    *self)
+{
+    QmiMessageCtlGetVersionInfoOutput *output;
+    GArray *service_list = NULL;
+    GError *error = NULL;
+
+    output = qmi_client_ctl_get_version_info_finish (client_ctl, res, &error);
+    if (!output || !qmi_message_ctl_get_version_info_output_get_result (output, &error)) {
+        /* Keep on using the cached info */
+        g_debug ("[%s] Couldn't validate cached version info: %s",
+                 self->priv->path_display,
+                 error->message);
+        g_error_free (error);
+        goto out;
+    }
+
+    qmi_message_ctl_get_version_info_output_get_service_list (output, &service_list, NULL);
+    if (self->priv->supported_services && service_lists_equal (self->priv->supported_services, service_list)) {
+        g_debug ("[%s] Cached version info is valid", self->priv->path_display);
+        goto out;
+    }
+
+    g_debug ("[%s] Cached version info is outdated, updating...", self->priv->path_display);
+    set_supported_services (self, service_list);
+    version_info_cache_store (self);
+
+out:
+    if (output)
+        qmi_message_ctl_get_version_info_output_unref (output);
+    g_object_unref (self);
+}
+
+static void
+version_info_validate (QmiDevice *self)
+{
+    qmi_client_ctl_get_version_info (self->priv->client_ctl,
+                                     NULL,
+                                     VERSION_INFO_VALIDATE_TIMEOUT,
+                                     NULL,
+                                     (GAsyncReadyCallback)version_info_validate_ready,
+                                     g_object_ref (self));
+}
+
 /*****************************************************************************/
 /* Open device */
 
@@ -1815,6 +3430,7 @@ typedef struct {
     QmiDeviceOpenFlags flags;
     guint timeout;
     guint version_check_retries;
+    gboolean version_info_cached;
     gchar *driver;
 } DeviceOpenContext;
 
@@ -1922,7 +3538,6 @@ open_version_info_ready (QmiClientCtl *client_ctl,
     GArray *service_list;
     QmiMessageCtlGetVersionInfoOutput *output;
     GError *error = NULL;
-    guint i;
 
     self = g_task_get_source_object (task);
     ctx = g_task_get_task_data (task);
@@ -1944,55 +3559,31 @@ open_version_info_ready (QmiClientCtl *client_ctl,
                                                  task);
                 return;
             }
-
-            /* Otherwise, propagate the error */
-        }
-
-        g_task_return_error (task, error);
-        g_object_unref (task);
-        return;
-    }
-
-    /* Check result of the QMI operation */
-    if (!qmi_message_ctl_get_version_info_output_get_result (output, &error)) {
-        g_task_return_error (task, error);
-        g_object_unref (task);
-        qmi_message_ctl_get_version_info_output_unref (output);
-        return;
-    }
-
-    /* QMI operation succeeded, we can now get the outputs */
-    service_list = NULL;
-    qmi_message_ctl_get_version_info_output_get_service_list (output,
-                                                              &service_list,
-                                                              NULL);
-    self->priv->supported_services = g_array_ref (service_list);
-
-    g_debug ("[%s] QMI Device supports %u services:",
-             self->priv->path_display,
-             self->priv->supported_services->len);
-    for (i = 0; i < self->priv->supported_services->len; i++) {
-        QmiMessageCtlGetVersionInfoOutputServiceListService *info;
-        const gchar *service_str;
-
-        info = &g_array_index (self->priv->supported_services,
-                               QmiMessageCtlGetVersionInfoOutputServiceListService,
-                               i);
-        service_str = qmi_service_get_string (info->service);
-        if (service_str)
-            g_debug ("[%s]    %s (%u.%u)",
-                     self->priv->path_display,
-                     service_str,
-                     info->major_version,
-                     info->minor_version);
-        else
-            g_debug ("[%s]    unknown [0x%02x] (%u.%u)",
-                     self->priv->path_display,
-                     info->service,
-                     info->major_version,
-                     info->minor_version);
+
+            /* Otherwise, propagate the error */
+        }
+
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    /* Check result of the QMI operation */
+    if (!qmi_message_ctl_get_version_info_output_get_result (output, &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        qmi_message_ctl_get_version_info_output_unref (output);
+        return;
     }
 
+    /* QMI operation succeeded, we can now get the outputs */
+    service_list = NULL;
+    qmi_message_ctl_get_version_info_output_get_service_list (output,
+                                                              &service_list,
+                                                              NULL);
+    set_supported_services (self, service_list);
+    version_info_cache_store (self);
+
     qmi_message_ctl_get_version_info_output_unref (output);
 
     /* Go on */
@@ -2279,8 +3870,12 @@ device_open_step (GTask *task)
         /* Fall down */
 
     case DEVICE_OPEN_CONTEXT_STEP_FLAGS_VERSION_INFO:
-        /* Query version info? */
-        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_VERSION_INFO) {
+        /* Query version info? If cached, it is validated once open */
+        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_VERSION_INFO && version_info_cache_load (self)) {
+            g_debug ("[%s] Using cached version info...",
+                     self->priv->path_display);
+            ctx->version_info_cached = TRUE;
+        } else if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_VERSION_INFO) {
             /* Setup how many times to retry... We'll retry once per second */
             ctx->version_check_retries = ctx->timeout > 0 ? ctx->timeout : 1;
             g_debug ("[%s] Checking version info (%u retries)...",
@@ -2347,6 +3942,9 @@ device_open_step (GTask *task)
 
     case DEVICE_OPEN_CONTEXT_STEP_LAST:
         /* Nothing else to process, done we are */
+        if (ctx->version_info_cached)
+            version_info_validate (self);
+        cid_pools_refill (self);
         g_task_return_boolean (task, TRUE);
         g_object_unref (task);
         return;
@@ -2370,36 +3968,570 @@ qmi_device_open (QmiDevice *self,
     gchar *flags_str;
     GTask *task;
 
-    /* Raw IP and 802.3 are mutually exclusive */
-    g_return_if_fail (!((flags & QMI_DEVICE_OPEN_FLAGS_NET_802_3) &&
-                        (flags & QMI_DEVICE_OPEN_FLAGS_NET_RAW_IP)));
-    /* QoS and no QoS are mutually exclusive */
-    g_return_if_fail (!((flags & QMI_DEVICE_OPEN_FLAGS_NET_QOS_HEADER) &&
-                        (flags & QMI_DEVICE_OPEN_FLAGS_NET_NO_QOS_HEADER)));
-    /* At least one of both link protocol and QoS must be specified */
-    if (flags & (QMI_DEVICE_OPEN_FLAGS_NET_802_3 | QMI_DEVICE_OPEN_FLAGS_NET_RAW_IP))
-        g_return_if_fail (flags & (QMI_DEVICE_OPEN_FLAGS_NET_QOS_HEADER | QMI_DEVICE_OPEN_FLAGS_NET_NO_QOS_HEADER));
-    if (flags & (QMI_DEVICE_OPEN_FLAGS_NET_QOS_HEADER | QMI_DEVICE_OPEN_FLAGS_NET_NO_QOS_HEADER))
-        g_return_if_fail (flags & (QMI_DEVICE_OPEN_FLAGS_NET_802_3 | QMI_DEVICE_OPEN_FLAGS_NET_RAW_IP));
+    /* Raw IP and 802.3 are mutually exclusive */
+    g_return_if_fail (!((flags & QMI_DEVICE_OPEN_FLAGS_NET_802_3) &&
+                        (flags & QMI_DEVICE_OPEN_FLAGS_NET_RAW_IP)));
+    /* QoS and no QoS are mutually exclusive */
+    g_return_if_fail (!((flags & QMI_DEVICE_OPEN_FLAGS_NET_QOS_HEADER) &&
+                        (flags & QMI_DEVICE_OPEN_FLAGS_NET_NO_QOS_HEADER)));
+    /* At least one of both link protocol and QoS must be specified */
+    if (flags & (QMI_DEVICE_OPEN_FLAGS_NET_802_3 | QMI_DEVICE_OPEN_FLAGS_NET_RAW_IP))
+        g_return_if_fail (flags & (QMI_DEVICE_OPEN_FLAGS_NET_QOS_HEADER | QMI_DEVICE_OPEN_FLAGS_NET_NO_QOS_HEADER));
+    if (flags & (QMI_DEVICE_OPEN_FLAGS_NET_QOS_HEADER | QMI_DEVICE_OPEN_FLAGS_NET_NO_QOS_HEADER))
+        g_return_if_fail (flags & (QMI_DEVICE_OPEN_FLAGS_NET_802_3 | QMI_DEVICE_OPEN_FLAGS_NET_RAW_IP));
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    flags_str = qmi_device_open_flags_build_string_from_mask (flags);
+    g_debug ("[%s] Opening device with flags '%s'...",
+             self->priv->path_display,
+             flags_str);
+    g_free (flags_str);
+
+    ctx = g_slice_new (DeviceOpenContext);
+    ctx->step = DEVICE_OPEN_CONTEXT_STEP_FIRST;
+    ctx->flags = flags;
+    ctx->timeout = timeout;
+    ctx->version_info_cached = FALSE;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_task_data (task, ctx, (GDestroyNotify)device_open_context_free);
+
+    /* Start processing */
+    device_open_step (task);
+}
+
+/*****************************************************************************/
+/* Output queue */
+
+typedef struct {
+    QmiMessage *message;
+    gpointer    transaction_key;
+    gint        priority;
+    gsize       written;
+} OutputEntry;
+
+static void
+output_entry_free (OutputEntry *entry)
+{
+    qmi_message_unref (entry->message);
+    g_slice_free (OutputEntry, entry);
+}
+
+static gboolean
+output_entry_is_stale (QmiDevice   *self,
+                       OutputEntry *entry)
+{
+    Transaction *tr;
+
+    /* Once we have started writing a message we must finish it, or we would
+     * break the framing */
+    if (entry->written > 0)
+        return FALSE;
+
+    /* If the transaction was already completed (e.g. timed out or cancelled)
+     * while the message was queued, there is no point in sending it */
+    tr = g_hash_table_lookup (self->priv->transactions, entry->transaction_key);
+    return (!tr || tr->message != entry->message);
+}
+
+static void
+output_queue_remove_stale (QmiDevice *self)
+{
+    GList *l;
+    GList *next;
+
+    for (l = self->priv->output_queue->head; l; l = next) {
+        next = g_list_next (l);
+        if (output_entry_is_stale (self, (OutputEntry *)l->data)) {
+            output_entry_free ((OutputEntry *)l->data);
+            g_queue_delete_link (self->priv->output_queue, l);
+        }
+    }
+}
+
+static void
+output_queue_clear (QmiDevice *self)
+{
+    OutputEntry *entry;
+
+    if (self->priv->output_source) {
+        g_source_destroy (self->priv->output_source);
+        g_clear_pointer (&self->priv->output_source, g_source_unref);
+    }
+
+    if (self->priv->pending_source) {
+        g_source_destroy (self->priv->pending_source);
+        g_clear_pointer (&self->priv->pending_source, g_source_unref);
+    }
+
+    if (self->priv->output_queue) {
+        while ((entry = g_queue_pop_head (self->priv->output_queue)) != NULL)
+            output_entry_free (entry);
+    }
+
+    if (self->priv->pending_queue) {
+        while ((entry = g_queue_pop_head (self->priv->pending_queue)) != NULL)
+            output_entry_free (entry);
+    }
+}
+
+static void
+output_queue_fail_head (QmiDevice *self,
+                        GError    *error)
+{
+    OutputEntry *entry;
+    Transaction *tr;
+
+    entry = g_queue_pop_head (self->priv->output_queue);
+    g_assert (entry);
+
+    tr = device_release_transaction (self, entry->transaction_key);
+    if (tr) {
+        g_prefix_error (&error, "Cannot write message: ");
+        transaction_complete_and_free (tr, NULL, error);
+    }
+    g_error_free (error);
+    output_entry_free (entry);
+}
+
+static void
+output_queue_advance (QmiDevice *self,
+                      gsize      written)
+{
+    while (written > 0) {
+        OutputEntry *entry;
+        gsize        pending;
+
+        entry = g_queue_peek_head (self->priv->output_queue);
+        g_assert (entry);
+
+        pending = qmi_message_get_length (entry->message) - entry->written;
+        if (written < pending) {
+            entry->written += written;
+            return;
+        }
+
+        written -= pending;
+        output_entry_free (g_queue_pop_head (self->priv->output_queue));
+        self->priv->stats.messages_out++;
+    }
+}
+
+/* The QMI character device expects exactly one QMI message per write(), so
+ * messages are written one by one. A short write cannot be resumed later, as
+ * the rest of the message would be taken as a new one, so it is reported as an
+ * error and the message is not retried */
+static gssize
+output_queue_write_single (QmiDevice  *self,
+                           GError    **error)
+{
+    OutputEntry  *entry;
+    const guint8 *raw;
+    gsize         raw_len;
+    gssize        written;
+
+    entry = g_queue_peek_head (self->priv->output_queue);
+    raw = qmi_message_get_raw (entry->message, &raw_len, NULL);
+
+    written = g_pollable_output_stream_write_nonblocking (G_POLLABLE_OUTPUT_STREAM (self->priv->ostream),
+                                                          raw,
+                                                          raw_len,
+                                                          NULL,
+                                                          error);
+    if (written >= 0 && (gsize)written < raw_len) {
+        self->priv->stats.bytes_out += written;
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_FAILED,
+                     "Message only partially written (%" G_GSSIZE_FORMAT "/%" G_GSIZE_FORMAT " bytes)",
+                     written, raw_len);
+        return -1;
+    }
+
+    return written;
+}
+
+static const guint8 *
+output_entry_peek_raw (gconstpointer  item,
+                       gsize         *length)
+{
+    return qmi_message_get_raw (((OutputEntry *)item)->message, length, NULL);
+}
+
+/* The proxy socket is a plain byte stream, so all the queued messages can be
+ * coalesced in a single write */
+static gssize
+output_queue_write_vectored (QmiDevice  *self,
+                             GError    **error)
+{
+    OutputEntry *entry;
+
+    entry = g_queue_peek_head (self->priv->output_queue);
+    return __qmi_io_write_vectored (g_socket_connection_get_socket (self->priv->socket_connection),
+                                    self->priv->output_queue->head,
+                                    entry->written,
+                                    output_entry_peek_raw,
+                                    error);
+}
+
+static gboolean output_ready_cb (GOutputStream *ostream,
+                                 QmiDevice     *self);
+
+static void
+output_queue_flush (QmiDevice *self)
+{
+    output_queue_remove_stale (self);
+
+    while (!g_queue_is_empty (self->priv->output_queue)) {
+        GError *error = NULL;
+        gssize  written;
+
+        if (self->priv->socket_connection)
+            written = output_queue_write_vectored (self, &error);
+        else
+            written = output_queue_write_single (self, &error);
+
+        if (written < 0) {
+            /* Wait until the stream is writable again */
+            if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+                g_error_free (error);
+                if (!self->priv->output_source) {
+                    self->priv->output_source = (g_pollable_output_stream_create_source (
+                                                     G_POLLABLE_OUTPUT_STREAM (
+                                                         self->priv->ostream),
+                                                     NULL));
+                    g_source_set_callback (self->priv->output_source,
+                                           (GSourceFunc)output_ready_cb,
+                                           self,
+                                           NULL);
+                    g_source_attach (self->priv->output_source, device_peek_context (self));
+                }
+                return;
+            }
+
+            output_queue_fail_head (self, error);
+            continue;
+        }
+
+        self->priv->stats.bytes_out += written;
+        output_queue_advance (self, written);
+    }
+}
+
+static void pending_queue_dispatch (QmiDevice *self);
+
+static gboolean
+output_ready_cb (GOutputStream *ostream,
+                 QmiDevice     *self)
+{
+    /* A new source is created during the flush if we would block again */
+    g_clear_pointer (&self->priv->output_source, g_source_unref);
+    output_queue_flush (self);
+    pending_queue_dispatch (self);
+    return G_SOURCE_REMOVE;
+}
+
+/*****************************************************************************/
+/* Pending queue
+ *
+ * Requests are moved to the output queue in priority order, as long as their
+ * service is below its in-flight limit. While the stream isn't writable they
+ * are kept here, so that urgent requests can still go ahead of the ones
+ * issued before them.
+ */
+
+static gint
+device_get_message_priority (QmiDevice  *self,
+                             QmiMessage *message)
+{
+    gpointer key;
+    gpointer value;
+
+    key = GUINT_TO_POINTER (((guint)qmi_message_get_service (message) << 16) |
+                            qmi_message_get_message_id (message));
+    if (g_hash_table_lookup_extended (self->priv->message_priorities, key, NULL, &value))
+        return GPOINTER_TO_INT (value);
+
+    /* CTL requests are needed to manage all the other clients */
+    if (qmi_message_get_service (message) == QMI_SERVICE_CTL)
+        return G_PRIORITY_HIGH;
+
+    return G_PRIORITY_DEFAULT;
+}
+
+static gboolean
+pending_queue_admit (QmiDevice   *self,
+                     OutputEntry *entry)
+{
+    Transaction *tr;
+    guint8       service;
+
+    service = (guint8)qmi_message_get_service (entry->message);
+    if (self->priv->in_flight_limit[service] > 0 &&
+        self->priv->in_flight[service] >= self->priv->in_flight_limit[service])
+        return FALSE;
+
+    tr = g_hash_table_lookup (self->priv->transactions, entry->transaction_key);
+    g_assert (tr && !tr->in_flight);
+    tr->in_flight = TRUE;
+    self->priv->in_flight[service]++;
+    return TRUE;
+}
+
+static void
+pending_queue_dispatch (QmiDevice *self)
+{
+    guint n_admitted;
+
+    /* Messages are moved in small batches, and only while the stream is
+     * writable, so that the output queue never grows beyond what can be
+     * written right away */
+    do {
+        GList *l;
+        GList *next;
+
+        n_admitted = 0;
+        for (l = self->priv->pending_queue->head;
+             l && n_admitted < QMI_IO_MAX_OUTPUT_VECTORS && !self->priv->output_source;
+             l = next) {
+            OutputEntry *entry = l->data;
+
+            next = g_list_next (l);
+            if (output_entry_is_stale (self, entry)) {
+                g_queue_delete_link (self->priv->pending_queue, l);
+                output_entry_free (entry);
+                continue;
+            }
+
+            /* If the service is at its limit, requests of other services
+             * may still go ahead */
+            if (!pending_queue_admit (self, entry))
+                continue;
+
+            g_queue_unlink (self->priv->pending_queue, l);
+            g_queue_push_tail_link (self->priv->output_queue, l);
+            n_admitted++;
+        }
+
+        if (n_admitted > 0)
+            output_queue_flush (self);
+    } while (n_admitted > 0 && !self->priv->output_source);
+}
+
+static gboolean
+pending_source_cb (QmiDevice *self)
+{
+    g_clear_pointer (&self->priv->pending_source, g_source_unref);
+    pending_queue_dispatch (self);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+pending_queue_schedule (QmiDevice *self)
+{
+    if (self->priv->pending_source || g_queue_is_empty (self->priv->pending_queue))
+        return;
+
+    /* Not dispatched right away, as we may be in the middle of completing
+     * transactions */
+    self->priv->pending_source = g_idle_source_new ();
+    g_source_set_priority (self->priv->pending_source, G_PRIORITY_DEFAULT);
+    g_source_set_callback (self->priv->pending_source,
+                           (GSourceFunc)pending_source_cb,
+                           self,
+                           NULL);
+    g_source_attach (self->priv->pending_source, device_peek_context (self));
+}
+
+static void
+device_in_flight_release (QmiDevice   *self,
+                          Transaction *tr)
+{
+    guint8 service;
+
+    service = (guint8)qmi_message_get_service (tr->message);
+    g_assert (self->priv->in_flight[service] > 0);
+    self->priv->in_flight[service]--;
+    tr->in_flight = FALSE;
+
+    if (self->priv->in_flight_limit[service] > 0)
+        pending_queue_schedule (self);
+}
+
+static gboolean
+output_queue_push (QmiDevice   *self,
+                   Transaction *tr,
+                   GError     **error)
+{
+    OutputEntry *entry;
+    GList       *l;
+    guint        depth;
+
+    depth = g_queue_get_length (self->priv->pending_queue) + g_queue_get_length (self->priv->output_queue);
+    if (self->priv->output_queue_limit > 0 && depth >= self->priv->output_queue_limit) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_WRONG_STATE,
+                     "Output queue is full (%u messages pending)",
+                     depth);
+        return FALSE;
+    }
+
+    entry = g_slice_new0 (OutputEntry);
+    entry->message = qmi_message_ref (tr->message);
+    entry->transaction_key = build_transaction_key (tr->message);
+    entry->priority = device_get_message_priority (self, tr->message);
+
+    /* Keep the queue sorted by priority, in request order within the same
+     * priority */
+    for (l = self->priv->pending_queue->tail; l; l = g_list_previous (l)) {
+        if (((OutputEntry *)l->data)->priority <= entry->priority)
+            break;
+    }
+    if (l)
+        g_queue_insert_after (self->priv->pending_queue, l, entry);
+    else
+        g_queue_push_head (self->priv->pending_queue, entry);
+
+    /* If we're already waiting for the stream to be writable, the message
+     * will be moved to the output queue once it is */
+    pending_queue_dispatch (self);
+
+    return TRUE;
+}
+
+guint
+qmi_device_get_output_queue_depth (QmiDevice *self)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), 0);
+
+    return (g_queue_get_length (self->priv->pending_queue) +
+            g_queue_get_length (self->priv->output_queue));
+}
+
+guint
+qmi_device_get_service_in_flight (QmiDevice  *self,
+                                  QmiService  service)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), 0);
+    g_return_val_if_fail (service <= G_MAXUINT8, 0);
+
+    return self->priv->in_flight[service];
+}
+
+void
+qmi_device_set_service_in_flight_limit (QmiDevice  *self,
+                                        QmiService  service,
+                                        guint       limit)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (service <= G_MAXUINT8);
+
+    self->priv->in_flight_limit[service] = limit;
+
+    /* Requests held back by the previous limit may go now */
+    pending_queue_schedule (self);
+}
+
+guint
+qmi_device_get_service_in_flight_limit (QmiDevice  *self,
+                                        QmiService  service)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), 0);
+    g_return_val_if_fail (service <= G_MAXUINT8, 0);
+
+    return self->priv->in_flight_limit[service];
+}
+
+void
+qmi_device_set_message_priority (QmiDevice  *self,
+                                 QmiService  service,
+                                 guint16     message_id,
+                                 gint        priority)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (service <= G_MAXUINT8);
+
+    g_hash_table_insert (self->priv->message_priorities,
+                         GUINT_TO_POINTER (((guint)service << 16) | message_id),
+                         GINT_TO_POINTER (priority));
+}
+
+/*****************************************************************************/
+/* Traffic capture */
+
+gboolean
+qmi_device_start_capture (QmiDevice    *self,
+                          const gchar  *path,
+                          GError      **error)
+{
+    QmiCapture *capture;
+
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+    g_return_val_if_fail (path != NULL, FALSE);
+
+    capture = __qmi_capture_new (path, self->priv->path, error);
+    if (!capture)
+        return FALSE;
+
+    qmi_device_stop_capture (self, NULL);
+    self->priv->capture = capture;
+    return TRUE;
+}
+
+gboolean
+qmi_device_stop_capture (QmiDevice  *self,
+                         GError    **error)
+{
+    gboolean success;
+
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
 
-    g_return_if_fail (QMI_IS_DEVICE (self));
+    if (!self->priv->capture)
+        return TRUE;
 
-    flags_str = qmi_device_open_flags_build_string_from_mask (flags);
-    g_debug ("[%s] Opening device with flags '%s'...",
-             self->priv->path_display,
-             flags_str);
-    g_free (flags_str);
+    success = __qmi_capture_flush (self->priv->capture, error);
+    g_clear_pointer (&self->priv->capture, __qmi_capture_free);
+    return success;
+}
 
-    ctx = g_slice_new (DeviceOpenContext);
-    ctx->step = DEVICE_OPEN_CONTEXT_STEP_FIRST;
-    ctx->flags = flags;
-    ctx->timeout = timeout;
+/*****************************************************************************/
+/* Message pool */
 
-    task = g_task_new (self, cancellable, callback, user_data);
-    g_task_set_task_data (task, ctx, (GDestroyNotify)device_open_context_free);
+static void
+message_pool_set_enabled (QmiDevice *self,
+                          gboolean   enabled)
+{
+    if (enabled && !self->priv->message_pool)
+        self->priv->message_pool = __qmi_message_pool_new ();
+    else if (!enabled && self->priv->message_pool)
+        g_clear_pointer (&self->priv->message_pool, __qmi_message_pool_close);
+}
 
-    /* Start processing */
-    device_open_step (task);
+QmiMessagePool *
+__qmi_device_peek_message_pool (QmiDevice *self)
+{
+    return self->priv->message_pool;
+}
+
+gboolean
+qmi_device_get_message_pool_stats (QmiDevice *self,
+                                   guint64   *hits,
+                                   guint64   *misses)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+
+    if (!self->priv->message_pool) {
+        if (hits)
+            *hits = 0;
+        if (misses)
+            *misses = 0;
+        return FALSE;
+    }
+
+    __qmi_message_pool_get_stats (self->priv->message_pool, hits, misses);
+    return TRUE;
 }
 
 /*****************************************************************************/
@@ -2412,7 +4544,9 @@ destroy_iostream (QmiDevice *self)
         g_source_destroy (self->priv->input_source);
         g_clear_pointer (&self->priv->input_source, g_source_unref);
     }
-    g_clear_pointer (&self->priv->buffer, g_byte_array_unref);
+    output_queue_clear (self);
+    __qmi_io_receive_buffer_clear (&self->priv->buffer);
+    cid_pools_flush (self, FALSE, 0, NULL);
     g_clear_object (&self->priv->istream);
     g_clear_object (&self->priv->ostream);
     g_clear_object (&self->priv->socket_connection);
@@ -2437,6 +4571,35 @@ mbim_device_close_ready (MbimDevice   *dev,
 
 #endif
 
+typedef struct {
+    QmiDevice *self;
+    guint      n_pending_releases;
+} CloseContext;
+
+static void
+close_context_free (CloseContext *ctx)
+{
+    g_object_unref (ctx->self);
+    g_slice_free (CloseContext, ctx);
+}
+
+static void
+close_context_release_done (GTask *task)
+{
+    CloseContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+    g_assert (ctx->n_pending_releases > 0);
+    if (--ctx->n_pending_releases > 0) {
+        g_object_unref (task);
+        return;
+    }
+
+    destroy_iostream (ctx->self);
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+}
+
 gboolean
 qmi_device_close_finish (QmiDevice     *self,
                          GAsyncResult  *res,
@@ -2456,6 +4619,22 @@ qmi_device_close_async (QmiDevice           *self,
 
     task = g_task_new (self, cancellable, callback, user_data);
 
+    /* Pooled CIDs are released before closing, if there is time to wait for
+     * it; the task is completed once all of them are done */
+    if (timeout > 0 && qmi_device_is_open (self)) {
+        CloseContext *ctx;
+
+        ctx = g_slice_new0 (CloseContext);
+        ctx->self = g_object_ref (self);
+        g_task_set_task_data (task, ctx, (GDestroyNotify)close_context_free);
+
+        ctx->n_pending_releases = cid_pools_flush (self, TRUE, timeout, task);
+        if (ctx->n_pending_releases > 0) {
+            g_object_unref (task);
+            return;
+        }
+    }
+
 #if defined MBIM_QMUX_ENABLED
     if (self->priv->mbimdev) {
         /* Schedule in new main context */
@@ -2549,9 +4728,7 @@ mbim_device_command_ready (MbimDevice             *dev,
     /* Store the raw information buffer in the internal reception buffer,
      * as if we had read from a iochannel. */
     buf = mbim_message_command_done_get_raw_information_buffer (response, &len);
-    if (!G_UNLIKELY (ctx->self->priv->buffer))
-        ctx->self->priv->buffer = g_byte_array_sized_new (len);
-    g_byte_array_append (ctx->self->priv->buffer, buf, len);
+    __qmi_io_receive_buffer_append (&ctx->self->priv->buffer, buf, len);
 
     /* And parse it as QMI; it should remove and cleanup the transaction */
     parse_response (ctx->self);
@@ -2606,6 +4783,8 @@ mbim_command (QmiDevice      *self,
                          (GAsyncReadyCallback) mbim_device_command_ready,
                          mbim_transaction_context_new (self, transaction_key));
 
+    self->priv->stats.bytes_out += raw_message_len;
+    self->priv->stats.messages_out++;
     mbim_message_unref (mbim_message);
     return TRUE;
 }
@@ -2644,36 +4823,69 @@ transaction_early_error (QmiDevice   *self,
     g_error_free (error);
 }
 
-void
-qmi_device_command_full (QmiDevice           *self,
-                         QmiMessage          *message,
-                         QmiMessageContext   *message_context,
-                         guint                timeout,
-                         GCancellable        *cancellable,
-                         GAsyncReadyCallback  callback,
-                         gpointer             user_data)
+/* Sends a request already stored */
+static void
+device_command_send (QmiDevice   *self,
+                     Transaction *tr)
 {
     GError *error = NULL;
-    Transaction *tr;
-    gconstpointer raw_message;
-    gsize raw_message_len;
-    guint transaction_timeout;
 
-    g_return_if_fail (QMI_IS_DEVICE (self));
-    g_return_if_fail (message != NULL);
-    g_return_if_fail (timeout > 0);
+    /* Device must be open, it may have been closed while a coalesced request
+     * waited */
+    if (!self->priv->istream || !self->priv->ostream) {
+#if defined MBIM_QMUX_ENABLED
+        if (!self->priv->mbimdev)
+#endif
+        {
+            error = g_error_new (QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_WRONG_STATE,
+                                 "Device must be open to send commands");
+            transaction_early_error (self, tr, TRUE, error);
+            return;
+        }
+    }
 
-    /* Use a proper transaction id for CTL messages if they don't have one */
-    if (qmi_message_get_service (message) == QMI_SERVICE_CTL &&
-        qmi_message_get_transaction_id (message) == 0) {
-        qmi_message_set_transaction_id (
-            message,
-            qmi_client_get_next_transaction_id (
-                QMI_CLIENT (
-                    self->priv->client_ctl)));
+    trace_message (self, tr->message, TRUE, "request", tr->message_context);
+
+#if defined MBIM_QMUX_ENABLED
+    if (self->priv->mbimdev) {
+        gconstpointer raw_message;
+        gsize raw_message_len;
+
+        raw_message = qmi_message_get_raw (tr->message, &raw_message_len, NULL);
+        if (!mbim_command (self,
+                           raw_message,
+                           raw_message_len,
+                           build_transaction_key (tr->message),
+                           tr->timeout,
+                           tr->cancellable,
+                           &error)) {
+            g_prefix_error (&error, "Cannot create MBIM command: ");
+            transaction_early_error (self, tr, TRUE, error);
+        }
+        return;
     }
+#endif
 
-    tr = transaction_new (self, message, message_context, cancellable, callback, user_data);
+    /* Queue the message; it is written right away unless the stream would
+     * block, in which case it is written as soon as the stream is writable */
+    if (!output_queue_push (self, tr, &error)) {
+        g_prefix_error (&error, "Cannot queue message: ");
+        transaction_early_error (self, tr, TRUE, error);
+        return;
+    }
+}
+
+static void
+device_command (QmiDevice   *self,
+                Transaction *tr,
+                guint        timeout)
+{
+    GError *error = NULL;
+    QmiMessage *message = tr->message;
+    guint transaction_timeout;
+
+    tr->timeout = timeout;
 
     /* Device must be open */
     if (!self->priv->istream || !self->priv->ostream) {
@@ -2708,14 +4920,6 @@ qmi_device_command_full (QmiDevice           *self,
         return;
     }
 
-    /* Get raw message */
-    raw_message = qmi_message_get_raw (message, &raw_message_len, &error);
-    if (!raw_message) {
-        g_prefix_error (&error, "Cannot get raw message: ");
-        transaction_early_error (self, tr, FALSE, error);
-        return;
-    }
-
     /* For transactions using the MBIM backend, no explicit timeout is set.
      * Instead, we rely on the timeout management in libmbim. */
     transaction_timeout = timeout;
@@ -2724,6 +4928,10 @@ qmi_device_command_full (QmiDevice           *self,
         transaction_timeout = 0;
 #endif
 
+    /* Identical requests may share the same transaction */
+    if (coalesce_request (self, tr, transaction_timeout))
+        return;
+
     /* Setup context to match response */
     if (!device_store_transaction (self, tr, transaction_timeout, &error)) {
         g_prefix_error (&error, "Cannot store transaction: ");
@@ -2734,37 +4942,75 @@ qmi_device_command_full (QmiDevice           *self,
     /* From now on, if we want to complete the transaction with an early error,
      *  it needs to be removed from the tracking table as well. */
 
-    trace_message (self, message, TRUE, "request", message_context);
+    device_command_send (self, tr);
+}
 
-#if defined MBIM_QMUX_ENABLED
-    if (self->priv->mbimdev) {
-        if (!mbim_command (self,
-                           raw_message,
-                           raw_message_len,
-                           build_transaction_key (message),
-                           timeout,
-                           cancellable,
-                           &error)) {
-            g_prefix_error (&error, "Cannot create MBIM command: ");
-            transaction_early_error (self, tr, TRUE, error);
-        }
-        return;
+typedef struct {
+    QmiDevice   *self;
+    Transaction *tr;
+    guint        timeout;
+} DeviceCommandContext;
+
+static void
+device_command_context_free (DeviceCommandContext *ctx)
+{
+    g_object_unref (ctx->self);
+    g_slice_free (DeviceCommandContext, ctx);
+}
+
+static gboolean
+device_command_in_context (DeviceCommandContext *ctx)
+{
+    device_command (ctx->self, ctx->tr, ctx->timeout);
+    return G_SOURCE_REMOVE;
+}
+
+void
+qmi_device_command_full (QmiDevice           *self,
+                         QmiMessage          *message,
+                         QmiMessageContext   *message_context,
+                         guint                timeout,
+                         GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data)
+{
+    Transaction *tr;
+    DeviceCommandContext *ctx;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (message != NULL);
+    g_return_if_fail (timeout > 0);
+
+    /* Use a proper transaction id for CTL messages if they don't have one */
+    if (qmi_message_get_service (message) == QMI_SERVICE_CTL &&
+        qmi_message_get_transaction_id (message) == 0) {
+        qmi_message_set_transaction_id (
+            message,
+            qmi_client_get_next_transaction_id (
+                QMI_CLIENT (
+                    self->priv->client_ctl)));
     }
-#endif
 
-    if (!g_output_stream_write_all (self->priv->ostream,
-                                    raw_message,
-                                    raw_message_len,
-                                    NULL, /* bytes_written */
-                                    NULL, /* cancellable */
-                                    &error)) {
-        g_prefix_error (&error, "Cannot write message: ");
-        transaction_early_error (self, tr, TRUE, error);
+    /* The async result is created here, so that the operation completes in
+     * the thread-default main context of the caller */
+    tr = transaction_new (self, message, message_context, cancellable, callback, user_data);
+
+    if (!self->priv->io_context) {
+        device_command (self, tr, timeout);
         return;
     }
 
-    /* Flush explicitly if correctly written */
-    g_output_stream_flush (self->priv->ostream, NULL, NULL);
+    /* The request is processed right away if the I/O context is owned by the
+     * caller or if it can be acquired; otherwise it is scheduled in it */
+    ctx = g_slice_new (DeviceCommandContext);
+    ctx->self = g_object_ref (self);
+    ctx->tr = tr;
+    ctx->timeout = timeout;
+    g_main_context_invoke_full (self->priv->io_context,
+                                G_PRIORITY_DEFAULT,
+                                (GSourceFunc) device_command_in_context,
+                                ctx,
+                                (GDestroyNotify) device_command_context_free);
 }
 
 /*****************************************************************************/
@@ -2973,6 +5219,27 @@ set_property (GObject *object,
         g_free (self->priv->proxy_path);
         self->priv->proxy_path = g_value_dup_string (value);
         break;
+    case PROP_READ_SIZE:
+        self->priv->read_size = g_value_get_uint (value);
+        break;
+    case PROP_OUTPUT_QUEUE_LIMIT:
+        self->priv->output_queue_limit = g_value_get_uint (value);
+        break;
+    case PROP_MESSAGE_POOL:
+        message_pool_set_enabled (self, g_value_get_boolean (value));
+        break;
+    case PROP_STATS_INTERVAL:
+        self->priv->stats_interval = g_value_get_uint (value);
+        stats_source_update (self);
+        break;
+    case PROP_VERSION_INFO_CACHE:
+        g_free (self->priv->version_info_cache);
+        self->priv->version_info_cache = g_value_dup_string (value);
+        break;
+    case PROP_IO_CONTEXT:
+        g_assert (self->priv->io_context == NULL);
+        self->priv->io_context = g_value_dup_boxed (value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -2995,6 +5262,24 @@ get_property (GObject *object,
         reload_wwan_iface_name (self);
         g_value_set_string (value, self->priv->wwan_iface);
         break;
+    case PROP_READ_SIZE:
+        g_value_set_uint (value, self->priv->read_size);
+        break;
+    case PROP_OUTPUT_QUEUE_LIMIT:
+        g_value_set_uint (value, self->priv->output_queue_limit);
+        break;
+    case PROP_MESSAGE_POOL:
+        g_value_set_boolean (value, !!self->priv->message_pool);
+        break;
+    case PROP_STATS_INTERVAL:
+        g_value_set_uint (value, self->priv->stats_interval);
+        break;
+    case PROP_VERSION_INFO_CACHE:
+        g_value_set_string (value, self->priv->version_info_cache);
+        break;
+    case PROP_IO_CONTEXT:
+        g_value_set_boxed (value, self->priv->io_context);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -3010,12 +5295,39 @@ qmi_device_init (QmiDevice *self)
 
     self->priv->transactions = g_hash_table_new (g_direct_hash,
                                                  g_direct_equal);
+    self->priv->timeout_heap = g_ptr_array_new ();
 
     self->priv->registered_clients = g_hash_table_new_full (g_direct_hash,
                                                             g_direct_equal,
                                                             NULL,
                                                             g_object_unref);
+    self->priv->service_clients = g_hash_table_new_full (g_direct_hash,
+                                                         g_direct_equal,
+                                                         NULL,
+                                                         (GDestroyNotify)g_ptr_array_unref);
+    self->priv->indication_queue = g_queue_new ();
     self->priv->proxy_path = g_strdup (QMI_PROXY_SOCKET_PATH);
+    self->priv->read_size = BUFFER_SIZE;
+    self->priv->output_queue = g_queue_new ();
+    self->priv->pending_queue = g_queue_new ();
+
+    /* Tearing down a connection should not wait for bulk requests */
+    self->priv->message_priorities = g_hash_table_new (g_direct_hash, g_direct_equal);
+    g_hash_table_insert (self->priv->message_priorities,
+                         GUINT_TO_POINTER (((guint)QMI_SERVICE_WDS << 16) | QMI_MESSAGE_WDS_STOP_NETWORK),
+                         GINT_TO_POINTER (G_PRIORITY_HIGH));
+
+    self->priv->coalesced_messages = g_hash_table_new (g_direct_hash, g_direct_equal);
+    self->priv->coalesce_entries = g_hash_table_new_full (g_bytes_hash,
+                                                          g_bytes_equal,
+                                                          NULL,
+                                                          (GDestroyNotify)coalesce_entry_free);
+
+    self->priv->message_stats = g_hash_table_new_full (g_direct_hash,
+                                                       g_direct_equal,
+                                                       NULL,
+                                                       g_free);
+    self->priv->stats_start_time = g_get_monotonic_time ();
 }
 
 static gboolean
@@ -3048,6 +5360,10 @@ dispose (GObject *object)
     g_hash_table_foreach_remove (self->priv->registered_clients,
                                  (GHRFunc)foreach_warning,
                                  self);
+    g_hash_table_remove_all (self->priv->service_clients);
+
+    /* Indications not yet dispatched are lost */
+    indication_queue_clear (self);
 
     if (self->priv->sync_indication_id &&
         self->priv->client_ctl) {
@@ -3057,6 +5373,9 @@ dispose (GObject *object)
     }
     g_clear_object (&self->priv->client_ctl);
 
+    self->priv->stats_interval = 0;
+    stats_source_update (self);
+
     G_OBJECT_CLASS (qmi_device_parent_class)->dispose (object);
 }
 
@@ -3064,6 +5383,7 @@ static void
 finalize (GObject *object)
 {
     QmiDevice *self = QMI_DEVICE (object);
+    guint i;
 
     /* Transactions keep refs to the device, so it's actually
      * impossible to have any content in the HT */
@@ -3072,17 +5392,39 @@ finalize (GObject *object)
         g_hash_table_unref (self->priv->transactions);
     }
 
+    g_assert (self->priv->timeout_heap->len == 0);
+    g_ptr_array_unref (self->priv->timeout_heap);
+    timeout_source_destroy (self);
+
     g_hash_table_unref (self->priv->registered_clients);
+    g_hash_table_unref (self->priv->service_clients);
+    g_queue_free (self->priv->indication_queue);
 
-    if (self->priv->supported_services)
-        g_array_unref (self->priv->supported_services);
+    service_table_clear (self);
+    g_clear_pointer (&self->priv->supported_services, g_array_unref);
+
+    for (i = 0; i < G_N_ELEMENTS (self->priv->cid_pools); i++)
+        g_clear_pointer (&self->priv->cid_pools[i], cid_pool_free);
 
     g_free (self->priv->path);
     g_free (self->priv->path_display);
     g_free (self->priv->proxy_path);
     g_free (self->priv->wwan_iface);
+    g_free (self->priv->version_info_cache);
 
     destroy_iostream (self);
+    g_queue_free (self->priv->output_queue);
+    g_queue_free (self->priv->pending_queue);
+    g_hash_table_unref (self->priv->message_priorities);
+    g_hash_table_unref (self->priv->coalesce_entries);
+    g_hash_table_unref (self->priv->coalesced_messages);
+    g_hash_table_unref (self->priv->message_stats);
+
+    message_pool_set_enabled (self, FALSE);
+    qmi_device_stop_capture (self, NULL);
+
+    if (self->priv->io_context)
+        g_main_context_unref (self->priv->io_context);
 
     G_OBJECT_CLASS (qmi_device_parent_class)->finalize (object);
 }
@@ -3158,6 +5500,110 @@ qmi_device_class_init (QmiDeviceClass *klass)
                              G_PARAM_READABLE);
     g_object_class_install_property (object_class, PROP_WWAN_IFACE, properties[PROP_WWAN_IFACE]);
 
+    /**
+     * QmiDevice:device-read-size:
+     *
+     * Since: 1.22
+     */
+    properties[PROP_READ_SIZE] =
+        g_param_spec_uint (QMI_DEVICE_READ_SIZE,
+                           "Read size",
+                           "Maximum number of bytes to read from the port at once.",
+                           MIN_BUFFER_SIZE,
+                           MAX_BUFFER_SIZE,
+                           BUFFER_SIZE,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_READ_SIZE, properties[PROP_READ_SIZE]);
+
+    /**
+     * QmiDevice:device-output-queue-limit:
+     *
+     * Since: 1.22
+     */
+    properties[PROP_OUTPUT_QUEUE_LIMIT] =
+        g_param_spec_uint (QMI_DEVICE_OUTPUT_QUEUE_LIMIT,
+                           "Output queue limit",
+                           "Maximum number of messages pending to be written, 0 for no limit.",
+                           0,
+                           G_MAXUINT,
+                           0,
+                           G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_OUTPUT_QUEUE_LIMIT, properties[PROP_OUTPUT_QUEUE_LIMIT]);
+
+    /**
+     * QmiDevice:device-message-pool:
+     *
+     * Whether request and response messages should reuse buffers from a pool
+     * owned by the device, instead of allocating new ones every time.
+     *
+     * Since: 1.22
+     */
+    properties[PROP_MESSAGE_POOL] =
+        g_param_spec_boolean (QMI_DEVICE_MESSAGE_POOL,
+                              "Message pool",
+                              "Reuse message buffers from a pool owned by the device.",
+                              FALSE,
+                              G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_MESSAGE_POOL, properties[PROP_MESSAGE_POOL]);
+
+    /**
+     * QmiDevice:device-stats-interval:
+     *
+     * Interval, in seconds, at which the #QmiDevice::stats signal is emitted,
+     * or 0 to disable it.
+     *
+     * Since: 1.22
+     */
+    properties[PROP_STATS_INTERVAL] =
+        g_param_spec_uint (QMI_DEVICE_STATS_INTERVAL,
+                           "Stats interval",
+                           "Interval in seconds between stats signals, 0 to disable them.",
+                           0,
+                           G_MAXUINT,
+                           0,
+                           G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_STATS_INTERVAL, properties[PROP_STATS_INTERVAL]);
+
+    /**
+     * QmiDevice:device-version-info-cache:
+     *
+     * Path of the file where the services supported by the device are cached
+     * when opening it with %QMI_DEVICE_OPEN_FLAGS_VERSION_INFO, or %NULL to
+     * always query the device.
+     *
+     * Since: 1.22
+     */
+    properties[PROP_VERSION_INFO_CACHE] =
+        g_param_spec_string (QMI_DEVICE_VERSION_INFO_CACHE,
+                             "Version info cache",
+                             "Path of the file where the supported services are cached.",
+                             NULL,
+                             G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_VERSION_INFO_CACHE, properties[PROP_VERSION_INFO_CACHE]);
+
+    /**
+     * QmiDevice:device-io-context:
+     *
+     * #GMainContext owning the device I/O, or %NULL to use the thread-default
+     * main context of the caller of each operation.
+     *
+     * When given, the device must be opened, closed and configured from the
+     * thread running this context, and its signals (including the indications
+     * of the clients) are emitted in it. qmi_device_command_full() and
+     * qmi_device_command(), and therefore the client requests, may be issued
+     * from any thread, and they complete in the thread-default main context of
+     * the caller.
+     *
+     * Since: 1.22
+     */
+    properties[PROP_IO_CONTEXT] =
+        g_param_spec_boxed (QMI_DEVICE_IO_CONTEXT,
+                            "I/O context",
+                            "Main context owning the device I/O.",
+                            G_TYPE_MAIN_CONTEXT,
+                            G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property (object_class, PROP_IO_CONTEXT, properties[PROP_IO_CONTEXT]);
+
     /**
      * QmiDevice::indication:
      * @object: A #QmiDevice.
@@ -3198,4 +5644,26 @@ qmi_device_class_init (QmiDeviceClass *klass)
                       NULL,
                       G_TYPE_NONE,
                       0);
+
+    /**
+     * QmiDevice::stats:
+     * @object: A #QmiDevice.
+     * @output: none
+     *
+     * The ::stats signal is emitted periodically if the
+     * #QmiDevice:device-stats-interval property is set, so that a snapshot of
+     * the runtime statistics can be taken with qmi_device_get_stats().
+     *
+     * Since: 1.22
+     */
+    signals[SIGNAL_STATS] =
+        g_signal_new (QMI_DEVICE_SIGNAL_STATS,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      0);
 }
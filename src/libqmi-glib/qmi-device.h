@@ -95,6 +95,60 @@ typedef struct _QmiDevicePrivate QmiDevicePrivate;
  */
 #define QMI_DEVICE_WWAN_IFACE "device-wwan-iface"
 
+/**
+ * QMI_DEVICE_READ_SIZE:
+ *
+ * Symbol defining the #QmiDevice:device-read-size property.
+ *
+ * Since: 1.22
+ */
+#define QMI_DEVICE_READ_SIZE "device-read-size"
+
+/**
+ * QMI_DEVICE_OUTPUT_QUEUE_LIMIT:
+ *
+ * Symbol defining the #QmiDevice:device-output-queue-limit property.
+ *
+ * Since: 1.22
+ */
+#define QMI_DEVICE_OUTPUT_QUEUE_LIMIT "device-output-queue-limit"
+
+/**
+ * QMI_DEVICE_MESSAGE_POOL:
+ *
+ * Symbol defining the #QmiDevice:device-message-pool property.
+ *
+ * Since: 1.22
+ */
+#define QMI_DEVICE_MESSAGE_POOL "device-message-pool"
+
+/**
+ * QMI_DEVICE_STATS_INTERVAL:
+ *
+ * Symbol defining the #QmiDevice:device-stats-interval property.
+ *
+ * Since: 1.22
+ */
+#define QMI_DEVICE_STATS_INTERVAL "device-stats-interval"
+
+/**
+ * QMI_DEVICE_VERSION_INFO_CACHE:
+ *
+ * Symbol defining the #QmiDevice:device-version-info-cache property.
+ *
+ * Since: 1.22
+ */
+#define QMI_DEVICE_VERSION_INFO_CACHE "device-version-info-cache"
+
+/**
+ * QMI_DEVICE_IO_CONTEXT:
+ *
+ * Symbol defining the #QmiDevice:device-io-context property.
+ *
+ * Since: 1.22
+ */
+#define QMI_DEVICE_IO_CONTEXT "device-io-context"
+
 /**
  * QMI_DEVICE_SIGNAL_INDICATION:
  *
@@ -113,6 +167,15 @@ typedef struct _QmiDevicePrivate QmiDevicePrivate;
  */
 #define QMI_DEVICE_SIGNAL_REMOVED "device-removed"
 
+/**
+ * QMI_DEVICE_SIGNAL_STATS:
+ *
+ * Symbol defining the #QmiDevice::stats signal.
+ *
+ * Since: 1.22
+ */
+#define QMI_DEVICE_SIGNAL_STATS "stats"
+
 /**
  * QmiDevice:
  *
@@ -351,6 +414,9 @@ gboolean qmi_device_close (QmiDevice  *self,
  * operation will wait for the response of the underlying MBIM close
  * sequence.
  *
+ * If @timeout is not 0, the client IDs pooled with qmi_device_set_cid_pool()
+ * are released before closing the device.
+ *
  * Closing a #QmiDevice multiple times will not return an error.
  *
  * When the operation is finished @callback will be called. You can then call
@@ -447,6 +513,56 @@ typedef enum {
  * Since: 1.0
  */
 
+/**
+ * qmi_device_set_cid_pool:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService, other than %QMI_SERVICE_CTL.
+ * @low_watermark: number of pooled CIDs below which new ones are allocated.
+ * @high_watermark: maximum number of pooled CIDs, or 0 to disable the pool.
+ *
+ * Sets up a pool of client IDs for the given @service, so that short-lived
+ * clients don't need a CTL Allocate CID and a CTL Release CID round trip
+ * each.
+ *
+ * qmi_device_allocate_client() takes a CID from the pool if it is given
+ * %QMI_CID_NONE and the pool isn't empty. qmi_device_release_client() with
+ * %QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID puts the CID back in the pool
+ * if there is room, instead of releasing it. Whenever the pool has less
+ * than @low_watermark CIDs, new ones are allocated in the background until
+ * it has @high_watermark CIDs.
+ *
+ * A pooled CID keeps the state the device associates with it, e.g. the
+ * indications registered by its previous client. The pool is therefore
+ * best suited for clients that only run queries.
+ *
+ * The CIDs over a lowered @high_watermark are released. The pool is emptied
+ * when the device is closed: qmi_device_close_async() releases the pooled
+ * CIDs before closing if it is given a @timeout, otherwise they are just
+ * dropped and the device should be opened with %QMI_DEVICE_OPEN_FLAGS_SYNC
+ * the next time. The pool is refilled once the device is open again.
+ *
+ * Since: 1.22
+ */
+void qmi_device_set_cid_pool (QmiDevice  *self,
+                              QmiService  service,
+                              guint       low_watermark,
+                              guint       high_watermark);
+
+/**
+ * qmi_device_get_cid_pool_size:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ *
+ * Gets the number of CIDs available in the pool set up with
+ * qmi_device_set_cid_pool().
+ *
+ * Returns: the number of pooled CIDs of @service.
+ *
+ * Since: 1.22
+ */
+guint qmi_device_get_cid_pool_size (QmiDevice  *self,
+                                    QmiService  service);
+
 /**
  * qmi_device_release_client:
  * @self: a #QmiDevice.
@@ -599,6 +715,10 @@ QmiMessage  *qmi_device_command_finish (QmiDevice     *self,
  *
  * If no @context given, the behavior is the same as qmi_device_command().
  *
+ * If the device was created with a #QmiDevice:device-io-context, this method
+ * may be called from any thread, and @callback is called in the
+ * thread-default main context of the caller.
+ *
  * Since: 1.18
  */
 void qmi_device_command_full (QmiDevice           *self,
@@ -625,6 +745,309 @@ QmiMessage *qmi_device_command_full_finish (QmiDevice     *self,
                                             GAsyncResult  *res,
                                             GError       **error);
 
+/**
+ * qmi_device_get_output_queue_depth:
+ * @self: a #QmiDevice.
+ *
+ * Gets the number of messages which have been queued with
+ * qmi_device_command_full() but which haven't been fully written to the
+ * device yet, e.g. because the underlying port isn't accepting more data.
+ *
+ * Callers may use this value to throttle their requests. If the
+ * #QmiDevice:device-output-queue-limit property is set, requests exceeding
+ * that limit will fail right away with a %QMI_CORE_ERROR_WRONG_STATE error.
+ *
+ * Returns: the number of messages pending to be written.
+ *
+ * Since: 1.22
+ */
+guint qmi_device_get_output_queue_depth (QmiDevice *self);
+
+/**
+ * qmi_device_set_service_in_flight_limit:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ * @limit: the maximum number of requests, or 0 to disable the limit.
+ *
+ * Sets the maximum number of requests of the given @service which may be
+ * written to the device while waiting for their responses.
+ *
+ * Requests over the limit are kept queued, and are written as soon as
+ * other requests of the same service get their response, time out or are
+ * cancelled. Requests of other services are not blocked by them. The
+ * timeout given to qmi_device_command_full() includes the time spent in the
+ * queue.
+ *
+ * By default there is no limit. Limits don't apply to devices using the MBIM
+ * backend.
+ *
+ * Since: 1.22
+ */
+void qmi_device_set_service_in_flight_limit (QmiDevice  *self,
+                                             QmiService  service,
+                                             guint       limit);
+
+/**
+ * qmi_device_get_service_in_flight_limit:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ *
+ * Gets the limit set with qmi_device_set_service_in_flight_limit().
+ *
+ * Returns: the maximum number of in-flight requests of @service, or 0 if unlimited.
+ *
+ * Since: 1.22
+ */
+guint qmi_device_get_service_in_flight_limit (QmiDevice  *self,
+                                              QmiService  service);
+
+/**
+ * qmi_device_get_service_in_flight:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ *
+ * Gets the number of requests of the given @service which have been queued
+ * for writing and are waiting for their responses. Requests held back by the
+ * limit set with qmi_device_set_service_in_flight_limit() are not included.
+ *
+ * Returns: the number of in-flight requests of @service.
+ *
+ * Since: 1.22
+ */
+guint qmi_device_get_service_in_flight (QmiDevice  *self,
+                                        QmiService  service);
+
+/**
+ * qmi_device_set_message_priority:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ * @message_id: the id of the request message.
+ * @priority: the priority, e.g. %G_PRIORITY_HIGH or %G_PRIORITY_LOW.
+ *
+ * Sets the priority of the requests with the given @service and
+ * @message_id. As with GLib sources, lower values are more urgent.
+ *
+ * Queued requests are written in priority order, and in the order they were
+ * issued within the same priority. This only matters when requests are held
+ * back, either because the device isn't accepting more data or because of
+ * the limit set with qmi_device_set_service_in_flight_limit(). A request
+ * which has started to be written is never interrupted.
+ *
+ * All CTL requests and the WDS Stop Network request default to
+ * %G_PRIORITY_HIGH. All other requests default to %G_PRIORITY_DEFAULT.
+ * For example, periodic NAS polling can be set to %G_PRIORITY_LOW.
+ *
+ * Since: 1.22
+ */
+void qmi_device_set_message_priority (QmiDevice  *self,
+                                      QmiService  service,
+                                      guint16     message_id,
+                                      gint        priority);
+
+/**
+ * qmi_device_set_message_coalescing:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ * @message_id: the id of the request message.
+ * @enabled: whether identical requests should be coalesced.
+ * @cache_ttl: time, in milliseconds, during which successful responses are reused, or 0 to disable the cache.
+ *
+ * Enables or disables coalescing of the requests with the given @service and
+ * @message_id. This is only meant for read-only queries, e.g. NAS Get Signal
+ * Strength or DMS Get IDs, which may be issued by several users of the same
+ * device.
+ *
+ * When enabled, a request with the same vendor and the same TLVs as one
+ * already in flight is not sent to the device. It gets a copy of the response
+ * to the first request, with its own client and transaction ids, or the error
+ * if that one could not be sent or received. Each request keeps its own
+ * timeout and cancellation: if the first request times out or is cancelled,
+ * the oldest of the requests merged into it is sent instead.
+ *
+ * If @cache_ttl is given, successful responses are also kept for that long
+ * and used to complete new identical requests right away.
+ *
+ * Changing the setup of a message drops its cached responses.
+ *
+ * Since: 1.22
+ */
+void qmi_device_set_message_coalescing (QmiDevice  *self,
+                                        QmiService  service,
+                                        guint16     message_id,
+                                        gboolean    enabled,
+                                        guint       cache_ttl);
+
+/**
+ * qmi_device_start_capture:
+ * @self: a #QmiDevice.
+ * @path: path of the capture file to create.
+ * @error: Return location for error or %NULL.
+ *
+ * Starts capturing all the messages sent and received by @self into the file
+ * at @path, replacing any capture already ongoing.
+ *
+ * The capture file uses the pcapng format, with one packet per message
+ * including a timestamp, the direction, the raw frame and the vendor id of the
+ * message context. The device path is given as interface name. Capturing
+ * costs one copy of each message into a preallocated buffer. Full buffers are
+ * written to the file from a separate thread, so that @self never blocks on
+ * the capture; if the file can't keep up, messages are dropped from the
+ * capture until a buffer is available again.
+ *
+ * Captures can be decoded offline with the qmi-capture-decode tool.
+ *
+ * Returns: %TRUE if the capture was started, %FALSE if @error is set.
+ *
+ * Since: 1.22
+ */
+gboolean qmi_device_start_capture (QmiDevice    *self,
+                                   const gchar  *path,
+                                   GError      **error);
+
+/**
+ * qmi_device_stop_capture:
+ * @self: a #QmiDevice.
+ * @error: Return location for error or %NULL.
+ *
+ * Stops the capture started with qmi_device_start_capture(), writing to the
+ * file all the messages still pending. Does nothing if there is no ongoing
+ * capture.
+ *
+ * Returns: %TRUE if the capture was completely written, %FALSE if @error is set
+ * because writing the file failed or because messages were dropped from the
+ * capture.
+ *
+ * Since: 1.22
+ */
+gboolean qmi_device_stop_capture (QmiDevice  *self,
+                                  GError    **error);
+
+/**
+ * qmi_device_get_message_pool_stats:
+ * @self: a #QmiDevice.
+ * @hits: (out) (optional): return location for the number of messages reusing a pooled buffer, or %NULL.
+ * @misses: (out) (optional): return location for the number of messages that needed a new buffer, or %NULL.
+ *
+ * Gets the usage counters of the message pool enabled with the
+ * #QmiDevice:device-message-pool property.
+ *
+ * In steady state, e.g. when polling the device periodically, all requests
+ * and responses should end up reusing pooled buffers.
+ *
+ * Returns: %TRUE if the message pool is enabled, %FALSE otherwise.
+ *
+ * Since: 1.22
+ */
+gboolean qmi_device_get_message_pool_stats (QmiDevice *self,
+                                            guint64   *hits,
+                                            guint64   *misses);
+
+/**
+ * QMI_DEVICE_STATS_LATENCY_BUCKETS:
+ *
+ * Number of buckets in the latency histogram of #QmiDeviceMessageStats.
+ *
+ * Bucket 0 counts the responses received in less than 1ms. Bucket N counts
+ * the responses received in [2^(N-1), 2^N) ms, except for the last bucket,
+ * which counts all responses received in 2^(N-1) ms or more.
+ *
+ * Since: 1.22
+ */
+#define QMI_DEVICE_STATS_LATENCY_BUCKETS 16
+
+/**
+ * QmiDeviceMessageStats:
+ * @service: a #QmiService.
+ * @message_id: the message id.
+ * @requests: number of requests issued.
+ * @responses: number of requests completed with a response, including the ones reporting a QMI protocol error.
+ * @timeouts: number of requests that timed out.
+ * @aborts: number of requests that were cancelled or aborted.
+ * @errors: number of requests that failed for any other reason, e.g. a write error.
+ * @coalesced: number of requests merged into an identical one in flight, see qmi_device_set_message_coalescing().
+ * @cached: number of requests completed with a cached response, see qmi_device_set_message_coalescing().
+ * @indications: number of indications received.
+ * @latency_total: sum of the latencies of all responses, in microseconds.
+ * @latency_max: maximum latency of a response, in microseconds.
+ * @latency_histogram: number of responses in each latency bucket, see %QMI_DEVICE_STATS_LATENCY_BUCKETS.
+ *
+ * Runtime statistics of the requests and indications with a given @service
+ * and @message_id.
+ *
+ * Latencies are measured from the moment the request is issued until its
+ * response is received, so they include the time spent in the output queue.
+ *
+ * Since: 1.22
+ */
+typedef struct {
+    QmiService service;
+    guint16    message_id;
+    guint64    requests;
+    guint64    responses;
+    guint64    timeouts;
+    guint64    aborts;
+    guint64    errors;
+    guint64    coalesced;
+    guint64    cached;
+    guint64    indications;
+    guint64    latency_total;
+    guint64    latency_max;
+    guint64    latency_histogram[QMI_DEVICE_STATS_LATENCY_BUCKETS];
+} QmiDeviceMessageStats;
+
+/**
+ * QmiDeviceStats:
+ * @elapsed: time since the statistics were last reset, in microseconds.
+ * @bytes_in: number of bytes read from the device.
+ * @bytes_out: number of bytes written to the device.
+ * @messages_in: number of messages read from the device.
+ * @messages_out: number of messages written to the device.
+ * @indications: number of indications received.
+ * @max_in_flight: maximum number of requests waiting for a response at the same time.
+ *
+ * Runtime statistics of a #QmiDevice.
+ *
+ * Since: 1.22
+ */
+typedef struct {
+    gint64  elapsed;
+    guint64 bytes_in;
+    guint64 bytes_out;
+    guint64 messages_in;
+    guint64 messages_out;
+    guint64 indications;
+    guint   max_in_flight;
+} QmiDeviceStats;
+
+/**
+ * qmi_device_get_stats:
+ * @self: a #QmiDevice.
+ * @stats: (out) (optional): return location for the device totals, or %NULL.
+ *
+ * Gets a snapshot of the runtime statistics of the device, collected since
+ * the device was created or since the last qmi_device_reset_stats() call.
+ *
+ * Per-service figures are the sum of the elements with the same service, and
+ * rates can be computed with the elapsed time reported in @stats.
+ *
+ * Returns: a #GArray of #QmiDeviceMessageStats elements, one for each message
+ * seen. The returned value should be freed with g_array_unref().
+ *
+ * Since: 1.22
+ */
+GArray *qmi_device_get_stats (QmiDevice      *self,
+                              QmiDeviceStats *stats);
+
+/**
+ * qmi_device_reset_stats:
+ * @self: a #QmiDevice.
+ *
+ * Resets all the runtime statistics of the device.
+ *
+ * Since: 1.22
+ */
+void qmi_device_reset_stats (QmiDevice *self);
+
 /**
  * QmiDeviceServiceVersionInfo:
  * @service: a #QmiService.
@@ -678,6 +1101,74 @@ void qmi_device_get_service_version_info (QmiDevice           *self,
 GArray *qmi_device_get_service_version_info_finish (QmiDevice     *self,
                                                     GAsyncResult  *res,
                                                     GError       **error);
+
+/**
+ * qmi_device_get_service_version:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ * @major: (out) (optional): return location for the major version, or %NULL.
+ * @minor: (out) (optional): return location for the minor version, or %NULL.
+ *
+ * Gets the version of @service reported by the device when it was opened
+ * with %QMI_DEVICE_OPEN_FLAGS_VERSION_INFO.
+ *
+ * Unlike qmi_device_get_service_version_info(), this method doesn't query
+ * the device.
+ *
+ * Returns: %TRUE if the version of @service is known, %FALSE otherwise.
+ *
+ * Since: 1.22
+ */
+gboolean qmi_device_get_service_version (QmiDevice  *self,
+                                         QmiService  service,
+                                         guint16    *major,
+                                         guint16    *minor);
+
+/**
+ * qmi_device_set_service_supported_messages:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService, other than %QMI_SERVICE_CTL.
+ * @supported_messages: (element-type guint8) (nullable): a #GArray with the bitmap of supported messages, or %NULL.
+ *
+ * Sets the messages supported by @service, in the bitmap format reported by
+ * the Get Supported Messages request of the service (e.g.
+ * qmi_client_dms_get_supported_messages()): bit N of byte M is set if the
+ * message with id (8 * M + N) is supported.
+ *
+ * Once set, requests of @service not included in the bitmap fail right away
+ * with a %QMI_CORE_ERROR_UNSUPPORTED error, without being sent to the device.
+ * Passing %NULL removes the bitmap.
+ *
+ * The bitmaps of all services are removed when the device reports new
+ * service versions.
+ *
+ * Since: 1.22
+ */
+void qmi_device_set_service_supported_messages (QmiDevice  *self,
+                                                QmiService  service,
+                                                GArray     *supported_messages);
+
+/**
+ * qmi_device_is_message_supported:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ * @message_id: the id of the request message.
+ *
+ * Checks whether a request may be sent to the device, given the services
+ * reported when opening the device with %QMI_DEVICE_OPEN_FLAGS_VERSION_INFO
+ * and the bitmap set with qmi_device_set_service_supported_messages().
+ *
+ * If the support is unknown, the message is assumed to be supported. When
+ * the request is sent, the service version in which it was introduced is
+ * also checked.
+ *
+ * Returns: %FALSE if the message is known to be unsupported, %TRUE otherwise.
+ *
+ * Since: 1.22
+ */
+gboolean qmi_device_is_message_supported (QmiDevice  *self,
+                                          QmiService  service,
+                                          guint16     message_id);
 /**
  * QmiDeviceExpectedDataFormat:
  * @QMI_DEVICE_EXPECTED_DATA_FORMAT_UNKNOWN: Unknown.
@@ -735,6 +1226,11 @@ gboolean qmi_device_set_expected_data_format (QmiDevice                    *self
                                               QmiDeviceExpectedDataFormat   format,
                                               GError                      **error);
 
+#if defined (LIBQMI_GLIB_COMPILATION)
+G_GNUC_INTERNAL
+QmiMessagePool *__qmi_device_peek_message_pool (QmiDevice *self);
+#endif
+
 G_END_DECLS
 
 #endif /* _LIBQMI_GLIB_QMI_DEVICE_H_ */
@@ -0,0 +1,278 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "qmi-io.h"
+#include "qmi-errors.h"
+#include "qmi-error-types.h"
+
+/*****************************************************************************/
+/* Writer */
+
+/* Sockets are plain byte streams, so all the queued messages can be coalesced
+ * in a single write */
+gssize
+__qmi_io_write_vectored (GSocket           *socket,
+                         GList             *items,
+                         gsize              head_written,
+                         QmiIoPeekRawFunc   peek_raw,
+                         GError           **error)
+{
+    struct iovec  vectors[QMI_IO_MAX_OUTPUT_VECTORS];
+    struct msghdr msg;
+    GList        *l;
+    guint         n_vectors = 0;
+    gssize        written;
+    gint          fd;
+
+    for (l = items; l && n_vectors < QMI_IO_MAX_OUTPUT_VECTORS; l = g_list_next (l)) {
+        const guint8 *raw;
+        gsize         raw_len;
+        gsize         offset;
+
+        raw = peek_raw (l->data, &raw_len);
+        offset = (n_vectors == 0 ? head_written : 0);
+        vectors[n_vectors].iov_base = (gpointer)(raw + offset);
+        vectors[n_vectors].iov_len = raw_len - offset;
+        n_vectors++;
+    }
+
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_iov = vectors;
+    msg.msg_iovlen = n_vectors;
+
+    fd = g_socket_get_fd (socket);
+    do {
+        written = sendmsg (fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+    } while (written < 0 && errno == EINTR);
+
+    if (written < 0) {
+        gint errsv = errno;
+
+        g_set_error (error,
+                     G_IO_ERROR,
+                     g_io_error_from_errno (errsv),
+                     "%s",
+                     g_strerror (errsv));
+    }
+
+    return written;
+}
+
+/*****************************************************************************/
+/* Output queue */
+
+static const guint8 *
+message_peek_raw (gconstpointer  item,
+                  gsize         *length)
+{
+    const QmiMessage *message = item;
+
+    *length = message->len;
+    return message->data;
+}
+
+void
+__qmi_io_output_queue_init (QmiIoOutputQueue *queue)
+{
+    memset (queue, 0, sizeof (QmiIoOutputQueue));
+    g_queue_init (&queue->messages);
+}
+
+void
+__qmi_io_output_queue_clear (QmiIoOutputQueue *queue)
+{
+    QmiMessage *message;
+
+    while ((message = g_queue_pop_head (&queue->messages)) != NULL)
+        qmi_message_unref (message);
+    queue->head_written = 0;
+}
+
+gboolean
+__qmi_io_output_queue_push (QmiIoOutputQueue  *queue,
+                            QmiMessage        *message,
+                            guint              limit,
+                            gboolean           fail_if_full,
+                            GError           **error)
+{
+    guint depth;
+
+    depth = g_queue_get_length (&queue->messages);
+    if (limit > 0 && depth >= limit) {
+        /* Responses are always queued, the peer is waiting for them and
+         * their number is bounded by its own requests */
+        if (!fail_if_full && qmi_message_is_indication (message)) {
+            queue->dropped++;
+            return TRUE;
+        }
+
+        if (fail_if_full) {
+            g_set_error (error,
+                         QMI_CORE_ERROR,
+                         QMI_CORE_ERROR_WRONG_STATE,
+                         "Output queue full (%u messages pending)",
+                         depth);
+            return FALSE;
+        }
+    }
+
+    g_queue_push_tail (&queue->messages, qmi_message_ref (message));
+    if (++depth > queue->depth_max)
+        queue->depth_max = depth;
+    return TRUE;
+}
+
+static void
+output_queue_advance (QmiIoOutputQueue *queue,
+                      gsize             written)
+{
+    while (written > 0) {
+        QmiMessage *message;
+        gsize       pending;
+
+        message = g_queue_peek_head (&queue->messages);
+        g_assert (message);
+
+        pending = message->len - queue->head_written;
+        if (written < pending) {
+            queue->head_written += written;
+            return;
+        }
+
+        written -= pending;
+        queue->head_written = 0;
+        qmi_message_unref (g_queue_pop_head (&queue->messages));
+    }
+}
+
+/* Writes until the queue is empty or the socket would block; returns the
+ * number of bytes written, or -1 if @error is set */
+gssize
+__qmi_io_output_queue_write (QmiIoOutputQueue  *queue,
+                             GSocket           *socket,
+                             GError           **error)
+{
+    gssize total = 0;
+
+    while (!g_queue_is_empty (&queue->messages)) {
+        GError *inner_error = NULL;
+        gssize  written;
+
+        written = __qmi_io_write_vectored (socket,
+                                           queue->messages.head,
+                                           queue->head_written,
+                                           message_peek_raw,
+                                           &inner_error);
+        if (written < 0) {
+            if (!g_error_matches (inner_error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+                g_propagate_error (error, inner_error);
+                return -1;
+            }
+            g_error_free (inner_error);
+            break;
+        }
+
+        output_queue_advance (queue, written);
+        total += written;
+    }
+
+    return total;
+}
+
+/*****************************************************************************/
+/* Receive buffer */
+
+guint8 *
+__qmi_io_receive_buffer_reserve (QmiIoReceiveBuffer *buffer,
+                                 gsize               len)
+{
+    gsize pending;
+
+    if (buffer->size - buffer->end >= len)
+        return buffer->data + buffer->end;
+
+    /* Not enough room at the end, so move the pending data (usually just a
+     * partial frame) back to the beginning of the buffer */
+    pending = buffer->end - buffer->start;
+    if (buffer->start > 0) {
+        if (pending > 0)
+            memmove (buffer->data, buffer->data + buffer->start, pending);
+        buffer->start = 0;
+        buffer->end = pending;
+    }
+
+    /* And grow the buffer if still not enough */
+    if (buffer->size - buffer->end < len) {
+        buffer->size = MAX (buffer->size * 2, pending + len);
+        buffer->data = g_realloc (buffer->data, buffer->size);
+    }
+
+    return buffer->data + buffer->end;
+}
+
+void
+__qmi_io_receive_buffer_commit (QmiIoReceiveBuffer *buffer,
+                                gsize               len)
+{
+    g_assert (buffer->end + len <= buffer->size);
+    buffer->end += len;
+}
+
+void
+__qmi_io_receive_buffer_consume (QmiIoReceiveBuffer *buffer,
+                                 gsize               len)
+{
+    g_assert (buffer->start + len <= buffer->end);
+    buffer->start += len;
+
+    /* Rewind as soon as everything is consumed, so that the next read
+     * starts at the beginning of the buffer */
+    if (buffer->start == buffer->end) {
+        buffer->start = 0;
+        buffer->end = 0;
+    }
+}
+
+void
+__qmi_io_receive_buffer_append (QmiIoReceiveBuffer *buffer,
+                                const guint8       *data,
+                                gsize               len)
+{
+    memcpy (__qmi_io_receive_buffer_reserve (buffer, len), data, len);
+    __qmi_io_receive_buffer_commit (buffer, len);
+}
+
+void
+__qmi_io_receive_buffer_clear (QmiIoReceiveBuffer *buffer)
+{
+    g_clear_pointer (&buffer->data, g_free);
+    buffer->size = 0;
+    buffer->start = 0;
+    buffer->end = 0;
+}
@@ -0,0 +1,106 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_IO_H_
+#define _LIBQMI_GLIB_QMI_IO_H_
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "qmi-message.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Non-blocking I/O shared by the device, when talking to the port or to the
+ * proxy, and by the proxy, when talking to its clients.
+ *
+ * Not part of the public API, but exported by the library (and so not
+ * G_GNUC_INTERNAL) so that the tests can use it.
+ */
+
+/* Max number of queued messages coalesced in a single write */
+#define QMI_IO_MAX_OUTPUT_VECTORS 16
+
+/* Writer */
+
+/* Gets the raw frame of an item of the list given to the writer */
+typedef const guint8 * (* QmiIoPeekRawFunc) (gconstpointer  item,
+                                             gsize         *length);
+
+gssize __qmi_io_write_vectored (GSocket           *socket,
+                                GList             *items,
+                                gsize              head_written,
+                                QmiIoPeekRawFunc   peek_raw,
+                                GError           **error);
+
+/* Output queue, written without blocking */
+
+/* Messages not yet written, how much of the first one was written, and the
+ * statistics reported for proxy clients */
+typedef struct {
+    GQueue   messages;
+    gsize    head_written;
+    guint    depth_max;
+    guint64  dropped;
+} QmiIoOutputQueue;
+
+void     __qmi_io_output_queue_init  (QmiIoOutputQueue  *queue);
+void     __qmi_io_output_queue_clear (QmiIoOutputQueue  *queue);
+/* Once @limit messages are queued, indications are dropped and counted, or
+ * the push fails if @fail_if_full is set; responses are always queued unless
+ * @fail_if_full is set */
+gboolean __qmi_io_output_queue_push  (QmiIoOutputQueue  *queue,
+                                      QmiMessage        *message,
+                                      guint              limit,
+                                      gboolean           fail_if_full,
+                                      GError           **error);
+gssize   __qmi_io_output_queue_write (QmiIoOutputQueue  *queue,
+                                      GSocket           *socket,
+                                      GError           **error);
+
+/* Receive buffer. Reads go straight into it and complete frames are consumed
+ * in place by moving the start offset; pending data is only moved back to the
+ * beginning of the buffer when more room is needed at the end. */
+
+typedef struct {
+    guint8 *data;
+    gsize   size;
+    gsize   start;
+    gsize   end;
+} QmiIoReceiveBuffer;
+
+guint8 *__qmi_io_receive_buffer_reserve (QmiIoReceiveBuffer *buffer,
+                                         gsize               len);
+void    __qmi_io_receive_buffer_commit  (QmiIoReceiveBuffer *buffer,
+                                         gsize               len);
+void    __qmi_io_receive_buffer_consume (QmiIoReceiveBuffer *buffer,
+                                         gsize               len);
+void    __qmi_io_receive_buffer_append  (QmiIoReceiveBuffer *buffer,
+                                         const guint8       *data,
+                                         gsize               len);
+void    __qmi_io_receive_buffer_clear   (QmiIoReceiveBuffer *buffer);
+
+G_END_DECLS
+
+#endif /* _LIBQMI_GLIB_QMI_IO_H_ */
@@ -291,6 +291,31 @@ qmi_tlv_next (QmiMessage *self,
     return (next < end ? next : NULL);
 }
 
+/* Raw contents of all the TLVs */
+const guint8 *
+__qmi_message_get_tlvs (QmiMessage *self,
+                        gsize      *length)
+{
+    *length = get_all_tlvs_length (self);
+    return (const guint8 *) qmi_tlv (self);
+}
+
+/* Copy of the message, addressed to a different client and transaction */
+QmiMessage *
+__qmi_message_dup_for_client (QmiMessage *self,
+                              guint8      client_id,
+                              guint16     transaction_id)
+{
+    GByteArray *copy;
+
+    copy = g_byte_array_sized_new (self->len);
+    g_byte_array_append (copy, self->data, self->len);
+    ((struct full_message *)(copy->data))->qmux.client = client_id;
+    qmi_message_set_transaction_id ((QmiMessage *)copy, transaction_id);
+
+    return (QmiMessage *)copy;
+}
+
 /*
  * Checks the validity of a QMI message.
  *
@@ -300,10 +325,14 @@ qmi_tlv_next (QmiMessage *self,
  *    field are all consistent.
  * 3. The TLVs in the message fit exactly in the payload size.
  *
+ * If @tlv_offsets is given, the offset of the first TLV of each type is stored
+ * in it along the way; it must be zeroed by the caller.
+ *
  * Returns: %TRUE if the message is valid, %FALSE otherwise.
  */
 static gboolean
 message_check (QmiMessage *self,
+               guint16 *tlv_offsets,
                GError **error)
 {
     gsize header_length;
@@ -380,6 +409,8 @@ message_check (QmiMessage *self,
                          tlv->value, GUINT16_FROM_LE (tlv->length), end);
             return FALSE;
         }
+        if (tlv_offsets && !tlv_offsets[tlv->type])
+            tlv_offsets[tlv->type] = (guint16)(((guint8 *)tlv) - self->data);
     }
 
     /*
@@ -391,11 +422,331 @@ message_check (QmiMessage *self,
     return TRUE;
 }
 
+/*****************************************************************************/
+/* Message pool
+ *
+ * QmiMessage is a plain GByteArray, so its reference count can't be observed
+ * and there is no room in it for any pool state. Each buffer created by a pool
+ * is therefore owned by a pool entry, which keeps the reference count of the
+ * message while it's in use; qmi_message_ref() and qmi_message_unref() update
+ * that one instead of the GByteArray one, so that when the last reference is
+ * dropped the buffer can go back to the free list of its size class instead of
+ * being freed.
+ *
+ * Entries are found from the message in a fixed-size table of atomic slots,
+ * indexed by the address of the message, without taking any lock. A buffer
+ * takes its slot when it's created and only gives it back when it's destroyed,
+ * not each time it's reused; if the slot is already taken by another buffer,
+ * the message is just not pooled. The free lists keep the entries linked, so
+ * reusing a pooled message doesn't allocate nor touch the table.
+ *
+ * Entries also keep the TLV index of their message; see qmi_tlv_find().
+ */
+
+/* The last class is able to hold the largest possible QMUX frame */
+static const gsize message_pool_class_sizes[] = { 128, 512, 2048, 8192, G_MAXUINT16 + 1 };
+#define MESSAGE_POOL_N_CLASSES G_N_ELEMENTS (message_pool_class_sizes)
+
+/* Maximum number of free messages kept in each size class */
+#define MESSAGE_POOL_MAX_FREE 8
+
+struct _QmiMessagePool {
+    volatile gint  ref_count;
+    GMutex         mutex;
+    gboolean       closed;
+    GQueue         free[MESSAGE_POOL_N_CLASSES];
+    guint64        hits;
+    guint64        misses;
+};
+
+typedef struct {
+    GList           link;
+    QmiMessage     *message;
+    QmiMessagePool *pool;
+    guint           size_class;
+    volatile gint   ref_count;
+
+    /* Offset of the first TLV of each type, 0 if there is none; only valid
+     * while tlv_indexed is set */
+    gboolean        tlv_indexed;
+    guint16         tlv_offsets[G_MAXUINT8 + 1];
+} MessagePoolEntry;
+
+#define POOLED_MESSAGE_SLOTS_BITS 12
+#define POOLED_MESSAGE_SLOTS      (1 << POOLED_MESSAGE_SLOTS_BITS)
+
+static gpointer          pooled_message_keys[POOLED_MESSAGE_SLOTS];
+static MessagePoolEntry *pooled_message_entries[POOLED_MESSAGE_SLOTS];
+static volatile gint     n_pooled_messages;
+
+static inline guint
+pooled_message_slot (QmiMessage *self)
+{
+    return (guint)(((guint32)(((gsize) self) >> 4) * 2654435761u) >> (32 - POOLED_MESSAGE_SLOTS_BITS));
+}
+
+static gboolean
+pooled_message_register (MessagePoolEntry *entry)
+{
+    guint slot;
+
+    slot = pooled_message_slot (entry->message);
+    if (!g_atomic_pointer_compare_and_exchange (&pooled_message_keys[slot], NULL, entry->message))
+        return FALSE;
+
+    /* The message isn't visible to anyone else yet, so nobody looks for its
+     * entry before it's set */
+    g_atomic_pointer_set (&pooled_message_entries[slot], entry);
+    g_atomic_int_inc (&n_pooled_messages);
+    return TRUE;
+}
+
+static void
+pooled_message_unregister (MessagePoolEntry *entry)
+{
+    guint slot;
+
+    slot = pooled_message_slot (entry->message);
+    g_atomic_int_add (&n_pooled_messages, -1);
+    g_atomic_pointer_set (&pooled_message_entries[slot], NULL);
+    g_atomic_pointer_set (&pooled_message_keys[slot], NULL);
+}
+
+static inline MessagePoolEntry *
+pooled_message_lookup (QmiMessage *self)
+{
+    guint slot;
+
+    slot = pooled_message_slot (self);
+    if (g_atomic_pointer_get (&pooled_message_keys[slot]) != self)
+        return NULL;
+    return g_atomic_pointer_get (&pooled_message_entries[slot]);
+}
+
+static void
+message_pool_entry_free (MessagePoolEntry *entry)
+{
+    pooled_message_unregister (entry);
+    g_byte_array_unref (entry->message);
+    g_slice_free (MessagePoolEntry, entry);
+}
+
+QmiMessagePool *
+__qmi_message_pool_new (void)
+{
+    QmiMessagePool *pool;
+    guint           i;
+
+    pool = g_slice_new0 (QmiMessagePool);
+    pool->ref_count = 1;
+    g_mutex_init (&pool->mutex);
+    for (i = 0; i < MESSAGE_POOL_N_CLASSES; i++)
+        g_queue_init (&pool->free[i]);
+    return pool;
+}
+
+static void
+message_pool_clear (QmiMessagePool *pool)
+{
+    GList *link;
+    guint  i;
+
+    for (i = 0; i < MESSAGE_POOL_N_CLASSES; i++) {
+        while ((link = g_queue_pop_head_link (&pool->free[i])) != NULL)
+            message_pool_entry_free (link->data);
+    }
+}
+
+static void
+message_pool_unref (QmiMessagePool *pool)
+{
+    if (g_atomic_int_dec_and_test (&pool->ref_count)) {
+        message_pool_clear (pool);
+        g_mutex_clear (&pool->mutex);
+        g_slice_free (QmiMessagePool, pool);
+    }
+}
+
+void
+__qmi_message_pool_close (QmiMessagePool *pool)
+{
+    /* Messages still in use are freed as soon as they're released */
+    g_mutex_lock (&pool->mutex);
+    pool->closed = TRUE;
+    message_pool_clear (pool);
+    g_mutex_unlock (&pool->mutex);
+
+    message_pool_unref (pool);
+}
+
+void
+__qmi_message_pool_get_stats (QmiMessagePool *pool,
+                              guint64        *hits,
+                              guint64        *misses)
+{
+    g_mutex_lock (&pool->mutex);
+    if (hits)
+        *hits = pool->hits;
+    if (misses)
+        *misses = pool->misses;
+    g_mutex_unlock (&pool->mutex);
+}
+
+static GByteArray *
+message_pool_acquire (QmiMessagePool *pool,
+                      gsize           size)
+{
+    MessagePoolEntry *entry;
+    GList            *link;
+    guint             size_class;
+
+    for (size_class = 0; size_class < MESSAGE_POOL_N_CLASSES - 1; size_class++) {
+        if (size <= message_pool_class_sizes[size_class])
+            break;
+    }
+
+    g_mutex_lock (&pool->mutex);
+    link = g_queue_pop_head_link (&pool->free[size_class]);
+    if (link)
+        pool->hits++;
+    else
+        pool->misses++;
+    g_mutex_unlock (&pool->mutex);
+
+    if (link)
+        entry = link->data;
+    else {
+        entry = g_slice_new0 (MessagePoolEntry);
+        entry->link.data = entry;
+        entry->message = g_byte_array_sized_new (message_pool_class_sizes[size_class]);
+        entry->size_class = size_class;
+
+        /* Slot taken by another buffer, this one is a plain message */
+        if (!pooled_message_register (entry)) {
+            GByteArray *message;
+
+            message = entry->message;
+            g_slice_free (MessagePoolEntry, entry);
+            return message;
+        }
+    }
+    entry->ref_count = 1;
+    entry->pool = pool;
+    g_atomic_int_inc (&pool->ref_count);
+
+    return entry->message;
+}
+
+static void
+message_pool_release (MessagePoolEntry *entry)
+{
+    QmiMessagePool *pool;
+
+    pool = entry->pool;
+    entry->pool = NULL;
+
+    g_mutex_lock (&pool->mutex);
+    if (!pool->closed && pool->free[entry->size_class].length < MESSAGE_POOL_MAX_FREE) {
+        g_byte_array_set_size (entry->message, 0);
+        entry->tlv_indexed = FALSE;
+        g_queue_push_head_link (&pool->free[entry->size_class], &entry->link);
+        entry = NULL;
+    }
+    g_mutex_unlock (&pool->mutex);
+
+    if (entry)
+        message_pool_entry_free (entry);
+
+    message_pool_unref (pool);
+}
+
+/* Returns TRUE if the message is pooled */
+static gboolean
+pooled_message_ref (QmiMessage *self)
+{
+    MessagePoolEntry *entry;
+
+    entry = pooled_message_lookup (self);
+    if (!entry)
+        return FALSE;
+
+    g_atomic_int_inc (&entry->ref_count);
+    return TRUE;
+}
+
+/* Returns TRUE if the message is pooled */
+static gboolean
+pooled_message_unref (QmiMessage *self)
+{
+    MessagePoolEntry *entry;
+
+    entry = pooled_message_lookup (self);
+    if (!entry)
+        return FALSE;
+
+    if (g_atomic_int_dec_and_test (&entry->ref_count))
+        message_pool_release (entry);
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* TLV index
+ *
+ * Pooled messages are indexed when they're parsed, in the same walk that
+ * validates them, so that looking up a TLV by type is a direct table hit
+ * instead of a walk of the TLV chain. The index is dropped as soon as the
+ * message is modified, and messages without index (not pooled, or built
+ * instead of parsed) are just walked.
+ */
+
+static void
+tlv_index_invalidate (QmiMessage *self)
+{
+    MessagePoolEntry *entry;
+
+    if (g_atomic_int_get (&n_pooled_messages) > 0 && (entry = pooled_message_lookup (self)) != NULL)
+        entry->tlv_indexed = FALSE;
+}
+
+/* Returns the first TLV of the given type, if any */
+static struct tlv *
+qmi_tlv_find (QmiMessage *self,
+              guint8      type)
+{
+    MessagePoolEntry *entry;
+    struct tlv       *tlv;
+
+    if (g_atomic_int_get (&n_pooled_messages) > 0 &&
+        (entry = pooled_message_lookup (self)) != NULL &&
+        entry->tlv_indexed)
+        return (entry->tlv_offsets[type] ? (struct tlv *) &(self->data[entry->tlv_offsets[type]]) : NULL);
+
+    for (tlv = qmi_tlv_first (self); tlv; tlv = qmi_tlv_next (self, tlv)) {
+        if (tlv->type == type)
+            return tlv;
+    }
+
+    return NULL;
+}
+
+/*****************************************************************************/
+
 QmiMessage *
 qmi_message_new (QmiService service,
                  guint8 client_id,
                  guint16 transaction_id,
                  guint16 message_id)
+{
+    return qmi_message_new_sized (service, client_id, transaction_id, message_id, 0);
+}
+
+static QmiMessage *
+message_new (QmiMessagePool *pool,
+             QmiService service,
+             guint8 client_id,
+             guint16 transaction_id,
+             guint16 message_id,
+             gsize tlvs_size_hint)
 {
     GByteArray *self;
     struct full_message *buffer;
@@ -417,8 +768,16 @@ qmi_message_new (QmiService service,
      * https://bugzilla.gnome.org/show_bug.cgi?id=738170
      */
 
-    /* Create the GByteArray with buffer_len bytes preallocated */
-    self = g_byte_array_sized_new (buffer_len);
+    /* The whole message length must fit in the 16bit QMUX length field, so
+     * there is no point in preallocating more than that */
+    tlvs_size_hint = MIN (tlvs_size_hint, G_MAXUINT16 - (buffer_len - 1));
+
+    /* Create the GByteArray with buffer_len bytes preallocated, plus the
+     * room requested for the TLVs */
+    if (pool)
+        self = message_pool_acquire (pool, buffer_len + tlvs_size_hint);
+    else
+        self = g_byte_array_sized_new (buffer_len + tlvs_size_hint);
     /* Actually flag as all the buffer_len bytes being used. */
     g_byte_array_set_size (self, buffer_len);
 
@@ -443,11 +802,32 @@ qmi_message_new (QmiService service,
     set_all_tlvs_length (self, 0);
 
     /* We shouldn't create invalid empty messages */
-    g_assert (message_check (self, NULL));
+    g_assert (message_check (self, NULL, NULL));
 
     return (QmiMessage *)self;
 }
 
+QmiMessage *
+qmi_message_new_sized (QmiService service,
+                       guint8 client_id,
+                       guint16 transaction_id,
+                       guint16 message_id,
+                       gsize tlvs_size_hint)
+{
+    return message_new (NULL, service, client_id, transaction_id, message_id, tlvs_size_hint);
+}
+
+QmiMessage *
+__qmi_message_pool_new_message (QmiMessagePool *pool,
+                                QmiService service,
+                                guint8 client_id,
+                                guint16 transaction_id,
+                                guint16 message_id,
+                                gsize tlvs_size_hint)
+{
+    return message_new (pool, service, client_id, transaction_id, message_id, tlvs_size_hint);
+}
+
 QmiMessage *
 qmi_message_response_new (QmiMessage       *request,
                           QmiProtocolError  error)
@@ -476,7 +856,7 @@ qmi_message_response_new (QmiMessage       *request,
     g_assert (qmi_message_tlv_write_complete (response, tlv_offset, NULL));
 
     /* We shouldn't create invalid response messages */
-    g_assert (message_check (response, NULL));
+    g_assert (message_check (response, NULL, NULL));
 
     return response;
 }
@@ -486,6 +866,9 @@ qmi_message_ref (QmiMessage *self)
 {
     g_return_val_if_fail (self != NULL, NULL);
 
+    if (g_atomic_int_get (&n_pooled_messages) > 0 && pooled_message_ref (self))
+        return self;
+
     return (QmiMessage *)g_byte_array_ref (self);
 }
 
@@ -494,6 +877,9 @@ qmi_message_unref (QmiMessage *self)
 {
     g_return_if_fail (self != NULL);
 
+    if (g_atomic_int_get (&n_pooled_messages) > 0 && pooled_message_unref (self))
+        return;
+
     g_byte_array_unref (self);
 }
 
@@ -551,6 +937,8 @@ qmi_message_tlv_write_init (QmiMessage  *self,
     if (!tlv_error_if_write_overflow (self, sizeof (struct tlv) + 1, error))
         return 0;
 
+    tlv_index_invalidate (self);
+
     /* Store where exactly we started adding the TLV */
     init_offset = self->len;
 
@@ -571,6 +959,7 @@ qmi_message_tlv_write_reset (QmiMessage *self,
 {
     g_return_if_fail (self != NULL);
 
+    tlv_index_invalidate (self);
     g_byte_array_set_size (self, tlv_offset);
 }
 
@@ -602,7 +991,7 @@ qmi_message_tlv_write_complete (QmiMessage  *self,
     set_all_tlvs_length (self, (guint16)(get_all_tlvs_length (self) + tlv_length));
 
     /* Make sure we didn't break anything. */
-    g_assert (message_check (self, NULL));
+    g_assert (message_check (self, NULL, NULL));
 
     return TRUE;
 }
@@ -849,22 +1238,14 @@ qmi_message_tlv_write_string (QmiMessage   *self,
 /*****************************************************************************/
 /* TLV reader */
 
-gsize
-qmi_message_tlv_read_init (QmiMessage  *self,
-                           guint8       type,
-                           guint16     *out_tlv_length,
-                           GError     **error)
+static gsize
+tlv_read_init (QmiMessage  *self,
+               struct tlv  *tlv,
+               guint8       type,
+               guint16     *out_tlv_length,
+               GError     **error)
 {
-    struct tlv *tlv;
-    guint16     tlv_length;
-
-    g_return_val_if_fail (self != NULL, 0);
-    g_return_val_if_fail (self->len > 0, 0);
-
-    for (tlv = qmi_tlv_first (self); tlv; tlv = qmi_tlv_next (self, tlv)) {
-        if (tlv->type == type)
-            break;
-    }
+    guint16 tlv_length;
 
     if (!tlv) {
         g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TLV_NOT_FOUND,
@@ -891,6 +1272,65 @@ qmi_message_tlv_read_init (QmiMessage  *self,
     return (((guint8 *)tlv) - self->data);
 }
 
+gsize
+qmi_message_tlv_read_init (QmiMessage  *self,
+                           guint8       type,
+                           guint16     *out_tlv_length,
+                           GError     **error)
+{
+    g_return_val_if_fail (self != NULL, 0);
+    g_return_val_if_fail (self->len > 0, 0);
+
+    return tlv_read_init (self, qmi_tlv_find (self, type), type, out_tlv_length, error);
+}
+
+gsize
+__qmi_message_tlv_read_next (QmiMessage *self,
+                             gsize       tlv_offset,
+                             guint8     *out_tlv_type)
+{
+    struct tlv *tlv;
+
+    g_return_val_if_fail (self != NULL, 0);
+    g_return_val_if_fail (out_tlv_type != NULL, 0);
+
+    if (!tlv_offset)
+        tlv = qmi_tlv_first (self);
+    else
+        tlv = qmi_tlv_next (self, (struct tlv *) &(self->data[tlv_offset]));
+
+    if (!tlv)
+        return 0;
+
+    *out_tlv_type = tlv->type;
+    return (((guint8 *)tlv) - self->data);
+}
+
+gsize
+__qmi_message_tlv_read_init_at (QmiMessage  *self,
+                                gsize        tlv_offset,
+                                guint8       type,
+                                guint16     *out_tlv_length,
+                                GError     **error)
+{
+    struct tlv *tlv = NULL;
+
+    g_return_val_if_fail (self != NULL, 0);
+    g_return_val_if_fail (self->len > 0, 0);
+
+    if (tlv_offset) {
+        tlv = (struct tlv *) &(self->data[tlv_offset]);
+        if (tlv->type != type) {
+            g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                         "TLV at offset %" G_GSIZE_FORMAT " is 0x%02X, not 0x%02X",
+                         tlv_offset, tlv->type, type);
+            return 0;
+        }
+    }
+
+    return tlv_read_init (self, tlv, type, out_tlv_length, error);
+}
+
 static const guint8 *
 tlv_error_if_read_overflow (QmiMessage  *self,
                             gsize        tlv_offset,
@@ -1208,13 +1648,14 @@ qmi_message_tlv_read_gdouble (QmiMessage  *self,
 }
 
 gboolean
-qmi_message_tlv_read_string (QmiMessage  *self,
-                             gsize        tlv_offset,
-                             gsize       *offset,
-                             guint8       n_size_prefix_bytes,
-                             guint16      max_size,
-                             gchar      **out,
-                             GError     **error)
+__qmi_message_tlv_read_string_peek (QmiMessage   *self,
+                                    gsize         tlv_offset,
+                                    gsize        *offset,
+                                    guint8        n_size_prefix_bytes,
+                                    guint16       max_size,
+                                    const gchar **out,
+                                    guint16      *out_length,
+                                    GError      **error)
 {
     const guint8 *ptr;
     guint16 string_length;
@@ -1223,6 +1664,7 @@ qmi_message_tlv_read_string (QmiMessage  *self,
     g_return_val_if_fail (self != NULL, FALSE);
     g_return_val_if_fail (offset != NULL, FALSE);
     g_return_val_if_fail (out != NULL, FALSE);
+    g_return_val_if_fail (out_length != NULL, FALSE);
     g_return_val_if_fail (n_size_prefix_bytes <= 2, FALSE);
 
     switch (n_size_prefix_bytes) {
@@ -1253,11 +1695,6 @@ qmi_message_tlv_read_string (QmiMessage  *self,
         g_assert_not_reached ();
     }
 
-    if (string_length == 0) {
-        *out = g_strdup ("");
-        return TRUE;
-    }
-
     if (max_size > 0 && string_length > max_size)
         valid_string_length = max_size;
     else
@@ -1266,14 +1703,36 @@ qmi_message_tlv_read_string (QmiMessage  *self,
     if (!(ptr = tlv_error_if_read_overflow (self, tlv_offset, *offset, valid_string_length, error)))
         return FALSE;
 
-    *out = g_malloc (valid_string_length + 1);
-    memcpy (*out, ptr, valid_string_length);
-    (*out)[valid_string_length] = '\0';
+    *out = (const gchar *) ptr;
+    *out_length = valid_string_length;
 
     *offset = (*offset + string_length);
     return TRUE;
 }
 
+gboolean
+qmi_message_tlv_read_string (QmiMessage  *self,
+                             gsize        tlv_offset,
+                             gsize       *offset,
+                             guint8       n_size_prefix_bytes,
+                             guint16      max_size,
+                             gchar      **out,
+                             GError     **error)
+{
+    const gchar *str;
+    guint16      str_length;
+
+    g_return_val_if_fail (out != NULL, FALSE);
+
+    if (!__qmi_message_tlv_read_string_peek (self, tlv_offset, offset, n_size_prefix_bytes, max_size, &str, &str_length, error))
+        return FALSE;
+
+    *out = g_malloc (str_length + 1);
+    memcpy (*out, str, str_length);
+    (*out)[str_length] = '\0';
+    return TRUE;
+}
+
 gboolean
 qmi_message_tlv_read_fixed_size_string (QmiMessage  *self,
                                         gsize        tlv_offset,
@@ -1314,6 +1773,37 @@ __qmi_message_tlv_read_remaining_size (QmiMessage *self,
     return (GUINT16_FROM_LE (tlv->length) >= offset ? (GUINT16_FROM_LE (tlv->length) - offset) : 0);
 }
 
+const guint8 *
+__qmi_message_tlv_read_items (QmiMessage  *self,
+                              gsize        tlv_offset,
+                              gsize       *offset,
+                              guint32      n_items,
+                              gsize        item_size,
+                              GError     **error)
+{
+    const guint8 *ptr;
+
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (offset != NULL, NULL);
+    g_return_val_if_fail (item_size > 0 && item_size <= G_MAXUINT16, NULL);
+
+    /* A TLV value is never longer than G_MAXUINT16 bytes, so this also
+     * ensures the multiplication below doesn't overflow */
+    if (n_items > G_MAXUINT16) {
+        g_set_error (error,
+                     QMI_CORE_ERROR,
+                     QMI_CORE_ERROR_TLV_TOO_LONG,
+                     "Reading TLV would overflow");
+        return NULL;
+    }
+
+    if (!(ptr = tlv_error_if_read_overflow (self, tlv_offset, *offset, n_items * item_size, error)))
+        return NULL;
+
+    *offset = *offset + (n_items * item_size);
+    return ptr;
+}
+
 /*****************************************************************************/
 
 const guint8 *
@@ -1326,14 +1816,12 @@ qmi_message_get_raw_tlv (QmiMessage *self,
     g_return_val_if_fail (self != NULL, NULL);
     g_return_val_if_fail (length != NULL, NULL);
 
-    for (tlv = qmi_tlv_first (self); tlv; tlv = qmi_tlv_next (self, tlv)) {
-        if (tlv->type == type) {
-            *length = GUINT16_FROM_LE (tlv->length);
-            return (guint8 *)&(tlv->value[0]);
-        }
-    }
+    tlv = qmi_tlv_find (self, type);
+    if (!tlv)
+        return NULL;
 
-    return NULL;
+    *length = GUINT16_FROM_LE (tlv->length);
+    return (guint8 *)&(tlv->value[0]);
 }
 
 void
@@ -1380,6 +1868,8 @@ qmi_message_add_raw_tlv (QmiMessage *self,
         return FALSE;
     }
 
+    tlv_index_invalidate (self);
+
     /* Resize buffer. */
     g_byte_array_set_size (self, self->len + tlv_len);
 
@@ -1394,48 +1884,82 @@ qmi_message_add_raw_tlv (QmiMessage *self,
     set_all_tlvs_length (self, (guint16)(get_all_tlvs_length (self) + tlv_len));
 
     /* Make sure we didn't break anything. */
-    g_assert (message_check (self, NULL));
+    g_assert (message_check (self, NULL, NULL));
 
     return TRUE;
 }
 
 QmiMessage *
-qmi_message_new_from_raw (GByteArray *raw,
-                          GError **error)
+__qmi_message_new_from_data (QmiMessagePool *pool,
+                             const guint8  *data,
+                             gsize          data_len,
+                             gsize         *frame_len,
+                             GError       **error)
 {
     GByteArray *self;
+    MessagePoolEntry *entry;
     gsize message_len;
 
-    g_return_val_if_fail (raw != NULL, NULL);
+    g_assert (frame_len != NULL);
+    *frame_len = 0;
 
     /* If we didn't even read the QMUX header (comes after the 1-byte marker),
      * leave */
-    if (raw->len < (sizeof (struct qmux) + 1))
+    if (data_len < (sizeof (struct qmux) + 1))
         return NULL;
 
     /* We need to have read the length reported by the QMUX header (plus the
      * initial 1-byte marker) */
-    message_len = GUINT16_FROM_LE (((struct full_message *)raw->data)->qmux.length);
-    if (raw->len < (message_len + 1))
+    message_len = GUINT16_FROM_LE (((struct full_message *)data)->qmux.length);
+    if (data_len < (message_len + 1))
         return NULL;
 
-    /* Ok, so we should have all the data available already */
-    self = g_byte_array_sized_new (message_len + 1);
-    g_byte_array_prepend (self, raw->data, message_len + 1);
-
-    /* We got a complete QMI message, remove from input buffer */
-    g_byte_array_remove_range (raw, 0, self->len);
+    /* Ok, so we should have all the data available already; the frame is
+     * consumed from the input data even if it ends up being invalid */
+    *frame_len = message_len + 1;
+    entry = NULL;
+    if (pool) {
+        self = message_pool_acquire (pool, *frame_len);
+        entry = pooled_message_lookup (self);
+    } else
+        self = g_byte_array_sized_new (*frame_len);
+    g_byte_array_append (self, data, *frame_len);
+
+    /* Pooled messages are indexed while checked */
+    if (entry)
+        memset (entry->tlv_offsets, 0, sizeof (entry->tlv_offsets));
 
     /* Check input message validity as soon as we create the QmiMessage */
-    if (!message_check (self, error)) {
+    if (!message_check (self, entry ? entry->tlv_offsets : NULL, error)) {
         /* Yes, we lose the whole message here */
         qmi_message_unref (self);
         return NULL;
     }
 
+    if (entry)
+        entry->tlv_indexed = TRUE;
+
     return (QmiMessage *)self;
 }
 
+QmiMessage *
+qmi_message_new_from_raw (GByteArray *raw,
+                          GError **error)
+{
+    QmiMessage *self;
+    gsize frame_len;
+
+    g_return_val_if_fail (raw != NULL, NULL);
+
+    self = __qmi_message_new_from_data (NULL, raw->data, raw->len, &frame_len, error);
+
+    /* We got a complete QMI message, remove from input buffer */
+    if (frame_len > 0)
+        g_byte_array_remove_range (raw, 0, frame_len);
+
+    return self;
+}
+
 gchar *
 qmi_message_get_tlv_printable (QmiMessage *self,
                                const gchar *line_prefix,
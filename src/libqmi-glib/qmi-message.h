@@ -106,6 +106,31 @@ QmiMessage *qmi_message_new (QmiService service,
                              guint16    transaction_id,
                              guint16    message_id);
 
+/**
+ * qmi_message_new_sized:
+ * @service: a #QmiService
+ * @client_id: client ID of the originating control point.
+ * @transaction_id: transaction ID.
+ * @message_id: message ID.
+ * @tlvs_size_hint: expected size of all the TLVs that will be added.
+ *
+ * Create a new #QmiMessage with the specified parameters, just like
+ * qmi_message_new(), but preallocating enough room for @tlvs_size_hint bytes
+ * of TLVs, so that the message buffer doesn't need to be reallocated while
+ * they are added.
+ *
+ * The hint doesn't need to be exact: TLVs exceeding it can still be added.
+ *
+ * Returns: (transfer full): a newly created #QmiMessage. The returned value should be freed with qmi_message_unref().
+ *
+ * Since: 1.22
+ */
+QmiMessage *qmi_message_new_sized (QmiService service,
+                                   guint8     client_id,
+                                   guint16    transaction_id,
+                                   guint16    message_id,
+                                   gsize      tlvs_size_hint);
+
 /**
  * qmi_message_new_from_raw:
  * @raw: (inout): raw data buffer.
@@ -122,6 +147,38 @@ QmiMessage *qmi_message_new (QmiService service,
 QmiMessage *qmi_message_new_from_raw (GByteArray  *raw,
                                       GError     **error);
 
+#if defined (LIBQMI_GLIB_COMPILATION)
+
+/* Pool of recycled message buffers; messages created from a pool go back to it
+ * when their last reference is dropped with qmi_message_unref(). Messages
+ * parsed into a pool also keep an index of their TLVs.
+ *
+ * Not part of the public API, but creating and closing pools and parsing into
+ * them are exported by the library (and so not G_GNUC_INTERNAL) so that the
+ * tests can use them. */
+typedef struct _QmiMessagePool QmiMessagePool;
+
+QmiMessagePool *__qmi_message_pool_new (void);
+void __qmi_message_pool_close (QmiMessagePool *pool);
+G_GNUC_INTERNAL
+void __qmi_message_pool_get_stats (QmiMessagePool *pool,
+                                   guint64        *hits,
+                                   guint64        *misses);
+G_GNUC_INTERNAL
+QmiMessage *__qmi_message_pool_new_message (QmiMessagePool *pool,
+                                            QmiService      service,
+                                            guint8          client_id,
+                                            guint16         transaction_id,
+                                            guint16         message_id,
+                                            gsize           tlvs_size_hint);
+
+QmiMessage *__qmi_message_new_from_data (QmiMessagePool  *pool,
+                                         const guint8    *data,
+                                         gsize            data_len,
+                                         gsize           *frame_len,
+                                         GError         **error);
+#endif
+
 /**
  * qmi_message_response_new:
  * @request: a request #QmiMessage.
@@ -942,6 +999,45 @@ G_GNUC_INTERNAL
 guint16 __qmi_message_tlv_read_remaining_size (QmiMessage  *self,
                                                gsize        tlv_offset,
                                                gsize        offset);
+
+/* Bounds-checks @n_items items of @item_size bytes each at @offset within the
+ * TLV value and returns a pointer to them, updating @offset past the last one */
+G_GNUC_INTERNAL
+const guint8 *__qmi_message_tlv_read_items (QmiMessage  *self,
+                                            gsize        tlv_offset,
+                                            gsize       *offset,
+                                            guint32      n_items,
+                                            gsize        item_size,
+                                            GError     **error);
+
+/* Same as qmi_message_tlv_read_string(), but returning the location of the
+ * (not NUL-terminated) string within the message instead of a copy */
+G_GNUC_INTERNAL
+gboolean __qmi_message_tlv_read_string_peek (QmiMessage   *self,
+                                             gsize         tlv_offset,
+                                             gsize        *offset,
+                                             guint8        n_size_prefix_bytes,
+                                             guint16       max_size,
+                                             const gchar **out,
+                                             guint16      *out_length,
+                                             GError      **error);
+
+/* Iterate all TLVs in wire order: pass 0 to get the offset of the first one,
+ * then the previous offset to get the next one; 0 is returned at the end. */
+G_GNUC_INTERNAL
+gsize __qmi_message_tlv_read_next (QmiMessage *self,
+                                   gsize       tlv_offset,
+                                   guint8     *out_tlv_type);
+
+/* Same as qmi_message_tlv_read_init(), but for a TLV offset already known
+ * (e.g. from __qmi_message_tlv_read_next()); 0 means the TLV wasn't found,
+ * or that the one at the given offset is of a different type. */
+G_GNUC_INTERNAL
+gsize __qmi_message_tlv_read_init_at (QmiMessage  *self,
+                                      gsize        tlv_offset,
+                                      guint8       type,
+                                      guint16     *out_tlv_length,
+                                      GError     **error);
 #endif
 
 /*****************************************************************************/
@@ -1029,6 +1125,16 @@ gboolean qmi_message_add_raw_tlv (QmiMessage   *self,
 void qmi_message_set_transaction_id (QmiMessage *self,
                                      guint16 transaction_id);
 
+#if defined (LIBQMI_GLIB_COMPILATION)
+G_GNUC_INTERNAL
+const guint8 *__qmi_message_get_tlvs (QmiMessage *self,
+                                      gsize      *length);
+G_GNUC_INTERNAL
+QmiMessage *__qmi_message_dup_for_client (QmiMessage *self,
+                                          guint8      client_id,
+                                          guint16     transaction_id);
+#endif
+
 /*****************************************************************************/
 /* Printable helpers */
 
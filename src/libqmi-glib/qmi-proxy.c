@@ -38,8 +38,10 @@
 #include "qmi-ctl.h"
 #include "qmi-utils.h"
 #include "qmi-proxy.h"
+#include "qmi-io.h"
 
-#define BUFFER_SIZE 512
+/* Read size; the receive buffer grows if a frame doesn't fit */
+#define BUFFER_SIZE 2048
 
 #define QMI_MESSAGE_OUTPUT_TLV_RESULT 0x02
 #define QMI_MESSAGE_OUTPUT_TLV_ALLOCATION_INFO 0x01
@@ -54,6 +56,8 @@ G_DEFINE_TYPE (QmiProxy, qmi_proxy, G_TYPE_OBJECT)
 enum {
     PROP_0,
     PROP_N_CLIENTS,
+    PROP_CLIENT_QUEUE_LIMIT,
+    PROP_CLIENT_QUEUE_POLICY,
     PROP_LAST
 };
 
@@ -63,11 +67,16 @@ struct _QmiProxyPrivate {
     /* Unix socket service */
     GSocketService *socket_service;
 
-    /* Clients */
-    GList *clients;
+    /* Set of clients */
+    GHashTable *clients;
 
-    /* Devices */
-    GList *devices;
+    /* HT of device path to DeviceInfo, for the open devices */
+    GHashTable *devices;
+
+    /* Max number of messages queued per client (0 if unlimited), and what
+     * to do when a client reaches it */
+    guint client_queue_limit;
+    QmiProxyClientQueuePolicy client_queue_policy;
 };
 
 /*****************************************************************************/
@@ -77,7 +86,7 @@ qmi_proxy_get_n_clients (QmiProxy *self)
 {
     g_return_val_if_fail (QMI_IS_PROXY (self), 0);
 
-    return g_list_length (self->priv->clients);
+    return g_hash_table_size (self->priv->clients);
 }
 
 /*****************************************************************************/
@@ -87,18 +96,42 @@ typedef struct {
     guint8 cid;
 } QmiClientInfo;
 
+typedef struct {
+    QmiDevice *device;
+    guint indication_id;
+
+    /* Number of clients using the device */
+    guint n_clients;
+
+    /* HT of (service << 8 | cid) to the Client owning the CID */
+    GHashTable *cids;
+
+    /* HT of service to HT of Client to the number of CIDs it owns in the
+     * service, so that broadcast indications are sent once per client */
+    GHashTable *services;
+} DeviceInfo;
+
 typedef struct {
     volatile gint ref_count;
 
     QmiProxy *proxy; /* not full ref */
     GSocketConnection *connection;
     GSource *connection_readable_source;
-    GByteArray *buffer;
+
+    /* Receive buffer, frames are consumed in place */
+    QmiIoReceiveBuffer buffer;
+
     QmiDevice *device;
+    DeviceInfo *device_info; /* set while counted in the device clients */
     QmiMessage *internal_proxy_open_request;
     GArray *qmi_client_info_array;
-    guint indication_id;
     guint device_removed_id;
+    guint32 pid;
+
+    /* Messages not yet written to the client; the writable source is set
+     * while waiting for the socket to accept more data */
+    QmiIoOutputQueue output_queue;
+    GSource *connection_writable_source;
 } Client;
 
 static gboolean connection_readable_cb (GSocket *socket, GIOCondition condition, Client *client);
@@ -114,6 +147,14 @@ client_disconnect (Client *client)
         client->connection_readable_source = 0;
     }
 
+    if (client->connection_writable_source) {
+        g_source_destroy (client->connection_writable_source);
+        g_clear_pointer (&client->connection_writable_source, g_source_unref);
+    }
+
+    /* Whatever wasn't written is lost */
+    __qmi_io_output_queue_clear (&client->output_queue);
+
     if (client->connection) {
         g_debug ("Client (%d) connection closed...", g_socket_get_fd (g_socket_connection_get_socket (client->connection)));
         g_output_stream_close (g_io_stream_get_output_stream (G_IO_STREAM (client->connection)), NULL, NULL);
@@ -130,18 +171,15 @@ client_unref (Client *client)
         client_disconnect (client);
 
         if (client->device) {
-            if (g_signal_handler_is_connected (client->device, client->indication_id))
-                g_signal_handler_disconnect (client->device, client->indication_id);
             if (g_signal_handler_is_connected (client->device, client->device_removed_id))
                 g_signal_handler_disconnect (client->device, client->device_removed_id);
             g_object_unref (client->device);
         }
 
-        if (client->buffer)
-            g_byte_array_unref (client->buffer);
+        __qmi_io_receive_buffer_clear (&client->buffer);
 
         if (client->internal_proxy_open_request)
-            g_byte_array_unref (client->internal_proxy_open_request);
+            qmi_message_unref (client->internal_proxy_open_request);
 
         g_array_unref (client->qmi_client_info_array);
 
@@ -156,11 +194,95 @@ client_ref (Client *client)
     return client;
 }
 
+/*****************************************************************************/
+/* Client output queue
+ *
+ * Messages are never written to a client with a blocking call, so that a
+ * client not reading from its socket doesn't stall the others; they are
+ * queued instead, and written as soon as the socket is writable.
+ */
+
+static gboolean
+client_untrack_idle (Client *client)
+{
+    QmiProxy *self = client->proxy;
+
+    untrack_client (self, client);
+    g_object_unref (self);
+    client_unref (client);
+    return G_SOURCE_REMOVE;
+}
+
+/* The client may be in use by the caller (e.g. while going through the
+ * clients of a device), so the untracking is scheduled */
+static void
+client_schedule_untrack (Client *client)
+{
+    client_disconnect (client);
+
+    g_object_ref (client->proxy);
+    g_idle_add ((GSourceFunc) client_untrack_idle, client_ref (client));
+}
+
+static gboolean connection_writable_cb (GSocket      *socket,
+                                        GIOCondition  condition,
+                                        Client       *client);
+
+static gboolean
+client_output_flush (Client  *client,
+                     GError **error)
+{
+    GSocket *socket;
+    gssize   written;
+
+    socket = g_socket_connection_get_socket (client->connection);
+    written = __qmi_io_output_queue_write (&client->output_queue, socket, error);
+    if (written < 0)
+        return FALSE;
+
+    if (written > 0)
+        g_debug ("Client (%d) TX: %" G_GSSIZE_FORMAT " bytes", g_socket_get_fd (socket), written);
+
+    /* Wait until the socket is writable again */
+    if (!g_queue_is_empty (&client->output_queue.messages) && !client->connection_writable_source) {
+        client->connection_writable_source = g_socket_create_source (socket, G_IO_OUT, NULL);
+        g_source_set_callback (client->connection_writable_source,
+                               (GSourceFunc)connection_writable_cb,
+                               client,
+                               NULL);
+        g_source_attach (client->connection_writable_source, g_main_context_get_thread_default ());
+    }
+
+    return TRUE;
+}
+
+static gboolean
+connection_writable_cb (GSocket      *socket,
+                        GIOCondition  condition,
+                        Client       *client)
+{
+    GError *error = NULL;
+
+    /* A new source is created during the flush if we would block again */
+    g_clear_pointer (&client->connection_writable_source, g_source_unref);
+
+    if (!client_output_flush (client, &error)) {
+        g_warning ("Cannot send message to client: %s", error->message);
+        g_error_free (error);
+        untrack_client (client->proxy, client);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
 static gboolean
 client_send_message (Client      *client,
                      QmiMessage  *message,
                      GError     **error)
 {
+    QmiProxy *self = client->proxy;
+    guint64   n_dropped;
+
     if (!client->connection) {
         g_set_error (error,
                      QMI_CORE_ERROR,
@@ -169,13 +291,30 @@ client_send_message (Client      *client,
         return FALSE;
     }
 
-    g_debug ("Client (%d) TX: %u bytes", g_socket_get_fd (g_socket_connection_get_socket (client->connection)), message->len);
-    if (!g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (client->connection)),
-                                    message->data,
-                                    message->len,
-                                    NULL, /* bytes_written */
-                                    NULL, /* cancellable */
-                                    error)) {
+    n_dropped = client->output_queue.dropped;
+    if (!__qmi_io_output_queue_push (&client->output_queue,
+                                     message,
+                                     self->priv->client_queue_limit,
+                                     (self->priv->client_queue_policy ==
+                                      QMI_PROXY_CLIENT_QUEUE_POLICY_DISCONNECT),
+                                     error)) {
+        g_prefix_error (error, "Cannot send message to client: ");
+        client_schedule_untrack (client);
+        return FALSE;
+    }
+
+    if (client->output_queue.dropped != n_dropped) {
+        g_debug ("Client (%d) output queue full: indication dropped",
+                 g_socket_get_fd (g_socket_connection_get_socket (client->connection)));
+        return TRUE;
+    }
+
+    /* If already waiting for the socket to be writable, the message is
+     * written once it is */
+    if (client->connection_writable_source)
+        return TRUE;
+
+    if (!client_output_flush (client, error)) {
         g_prefix_error (error, "Cannot send message to client: ");
         return FALSE;
     }
@@ -184,92 +323,234 @@ client_send_message (Client      *client,
 }
 
 /*****************************************************************************/
-/* Track/untrack clients */
+/* Client stats */
+
+GArray *
+qmi_proxy_get_client_stats (QmiProxy *self)
+{
+    GArray         *array;
+    GHashTableIter  iter;
+    Client         *client;
+
+    g_return_val_if_fail (QMI_IS_PROXY (self), NULL);
+
+    array = g_array_sized_new (FALSE, FALSE, sizeof (QmiProxyClientStats), g_hash_table_size (self->priv->clients));
+    g_hash_table_iter_init (&iter, self->priv->clients);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&client, NULL)) {
+        QmiProxyClientStats stats;
+
+        stats.pid = client->pid;
+        stats.queue_depth = g_queue_get_length (&client->output_queue.messages);
+        stats.queue_depth_max = client->output_queue.depth_max;
+        stats.dropped = client->output_queue.dropped;
+        g_array_append_val (array, stats);
+    }
+
+    return array;
+}
+
+/*****************************************************************************/
+/* Devices */
+
+static inline gpointer
+build_cid_key (QmiService service,
+               guint8     cid)
+{
+    return GUINT_TO_POINTER (((guint)service << 8) | cid);
+}
 
 static void
-track_client (QmiProxy *self,
-              Client   *client)
+client_forward_indication (Client     *client,
+                           QmiMessage *message)
 {
-    self->priv->clients = g_list_append (self->priv->clients, client_ref (client));
-    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_CLIENTS]);
+    GError *error = NULL;
+
+    if (!client_send_message (client, message, &error)) {
+        g_warning ("couldn't forward indication to client: %s", error->message);
+        g_error_free (error);
+    }
 }
 
-static guint
-get_n_clients_with_device (QmiProxy *self,
-                           QmiDevice *device)
+static void
+indication_cb (QmiDevice  *device,
+               QmiMessage *message,
+               DeviceInfo *info)
 {
-    GList *l;
-    guint n = 0;
+    QmiService service;
+    guint8 cid;
+    Client *client;
 
-    for (l = self->priv->clients; l; l = g_list_next (l)) {
-        Client *client = l->data;
+    service = qmi_message_get_service (message);
+    cid = qmi_message_get_client_id (message);
 
-        if (client->device && (device == client->device ||
-            g_str_equal (qmi_device_get_path (device), qmi_device_get_path (client->device))))
-            n++;
+    /* Broadcast indications go once to each client with a CID in the
+     * service */
+    if (cid == QMI_CID_BROADCAST) {
+        GHashTable *service_clients;
+        GHashTableIter iter;
+
+        service_clients = g_hash_table_lookup (info->services, GUINT_TO_POINTER (service));
+        if (!service_clients)
+            return;
+
+        g_hash_table_iter_init (&iter, service_clients);
+        while (g_hash_table_iter_next (&iter, (gpointer *)&client, NULL))
+            client_forward_indication (client, message);
+        return;
     }
 
-    return n;
+    client = g_hash_table_lookup (info->cids, build_cid_key (service, cid));
+    if (client)
+        client_forward_indication (client, message);
+}
+
+static DeviceInfo *
+device_info_new (QmiDevice *device)
+{
+    DeviceInfo *info;
+
+    info = g_slice_new0 (DeviceInfo);
+    info->device = g_object_ref (device);
+    info->cids = g_hash_table_new (g_direct_hash, g_direct_equal);
+    info->services = g_hash_table_new_full (g_direct_hash,
+                                            g_direct_equal,
+                                            NULL,
+                                            (GDestroyNotify)g_hash_table_unref);
+    info->indication_id = g_signal_connect (device,
+                                            "indication",
+                                            G_CALLBACK (indication_cb),
+                                            info);
+    return info;
 }
 
 static void
-untrack_client (QmiProxy *self,
-                Client   *client)
+device_info_free (DeviceInfo *info)
 {
-    QmiDevice *device;
+    if (g_signal_handler_is_connected (info->device, info->indication_id))
+        g_signal_handler_disconnect (info->device, info->indication_id);
+    g_hash_table_unref (info->cids);
+    g_hash_table_unref (info->services);
+    g_object_unref (info->device);
+    g_slice_free (DeviceInfo, info);
+}
 
-    device = client->device ? g_object_ref (client->device) : NULL;
+static void
+device_info_add_cid (DeviceInfo          *info,
+                     Client              *client,
+                     const QmiClientInfo *client_info)
+{
+    GHashTable *service_clients;
+    guint n;
 
-    /* Disconnect the client explicitly when untracking */
-    client_disconnect (client);
+    g_hash_table_insert (info->cids, build_cid_key (client_info->service, client_info->cid), client);
 
-    if (g_list_find (self->priv->clients, client)) {
-        self->priv->clients = g_list_remove (self->priv->clients, client);
-        client_unref (client);
-        g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_CLIENTS]);
+    service_clients = g_hash_table_lookup (info->services, GUINT_TO_POINTER (client_info->service));
+    if (!service_clients) {
+        service_clients = g_hash_table_new (g_direct_hash, g_direct_equal);
+        g_hash_table_insert (info->services, GUINT_TO_POINTER (client_info->service), service_clients);
     }
 
-    if (!device)
+    n = GPOINTER_TO_UINT (g_hash_table_lookup (service_clients, client));
+    g_hash_table_insert (service_clients, client, GUINT_TO_POINTER (n + 1));
+}
+
+static void
+device_info_remove_cid (DeviceInfo          *info,
+                        Client              *client,
+                        const QmiClientInfo *client_info)
+{
+    GHashTable *service_clients;
+    gpointer key;
+    guint n;
+
+    key = build_cid_key (client_info->service, client_info->cid);
+    if (g_hash_table_lookup (info->cids, key) == client)
+        g_hash_table_remove (info->cids, key);
+
+    service_clients = g_hash_table_lookup (info->services, GUINT_TO_POINTER (client_info->service));
+    if (!service_clients)
         return;
 
-    /* If no more clients using the device, close and cleanup */
-    if (get_n_clients_with_device (self, device) == 0) {
-        GList *l;
-
-        for (l = self->priv->devices; l; l = g_list_next (l)) {
-            QmiDevice *device_in_list = QMI_DEVICE (l->data);
-
-            if (device_in_list && (device == device_in_list ||
-                g_str_equal (qmi_device_get_path (device), qmi_device_get_path (device_in_list)))) {
-                g_debug ("closing device '%s': no longer used", qmi_device_get_path_display (device));
-                qmi_device_close (device_in_list, NULL);
-                g_object_unref (device_in_list);
-                self->priv->devices = g_list_remove (self->priv->devices, device_in_list);
-                break;
-            }
-        }
-    }
+    n = GPOINTER_TO_UINT (g_hash_table_lookup (service_clients, client));
+    if (n > 1)
+        g_hash_table_insert (service_clients, client, GUINT_TO_POINTER (n - 1));
+    else
+        g_hash_table_remove (service_clients, client);
 
-    g_object_unref (device);
+    if (g_hash_table_size (service_clients) == 0)
+        g_hash_table_remove (info->services, GUINT_TO_POINTER (client_info->service));
 }
 
-static QmiDevice *
-find_device_for_path (QmiProxy *self,
-                      const gchar *path)
+static void device_removed_cb (QmiDevice *device, Client *client);
+
+static void
+client_attach_device (Client     *client,
+                      DeviceInfo *info)
 {
-    GList *l;
+    guint i;
 
-    for (l = self->priv->devices; l; l = g_list_next (l)) {
-        QmiDevice *device;
+    g_assert (!client->device_info);
+    g_assert (client->device == info->device);
 
-        device = (QmiDevice *)l->data;
+    client->device_info = info;
+    info->n_clients++;
 
-        /* Return if found */
-        if (g_str_equal (qmi_device_get_path (device), path))
-            return device;
+    for (i = 0; i < client->qmi_client_info_array->len; i++)
+        device_info_add_cid (info, client, &g_array_index (client->qmi_client_info_array, QmiClientInfo, i));
+
+    client->device_removed_id = g_signal_connect (client->device,
+                                                  "device-removed",
+                                                  G_CALLBACK (device_removed_cb),
+                                                  client);
+}
+
+static void
+client_detach_device (QmiProxy *self,
+                      Client   *client)
+{
+    DeviceInfo *info;
+    guint i;
+
+    info = client->device_info;
+    if (!info)
+        return;
+    client->device_info = NULL;
+
+    for (i = 0; i < client->qmi_client_info_array->len; i++)
+        device_info_remove_cid (info, client, &g_array_index (client->qmi_client_info_array, QmiClientInfo, i));
+
+    /* If no more clients using the device, close and cleanup */
+    g_assert (info->n_clients > 0);
+    if (--info->n_clients == 0) {
+        g_debug ("closing device '%s': no longer used", qmi_device_get_path_display (info->device));
+        qmi_device_close (info->device, NULL);
+        g_hash_table_remove (self->priv->devices, qmi_device_get_path (info->device));
     }
+}
 
-    return NULL;
+/*****************************************************************************/
+/* Track/untrack clients */
+
+static void
+track_client (QmiProxy *self,
+              Client   *client)
+{
+    g_hash_table_add (self->priv->clients, client_ref (client));
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_CLIENTS]);
+}
+
+static void
+untrack_client (QmiProxy *self,
+                Client   *client)
+{
+    /* Disconnect the client explicitly when untracking */
+    client_disconnect (client);
+
+    client_detach_device (self, client);
+
+    /* May release the last reference */
+    if (g_hash_table_remove (self->priv->clients, client))
+        g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_CLIENTS]);
 }
 
 static void
@@ -295,35 +576,6 @@ complete_internal_proxy_open (QmiProxy *self,
     qmi_message_unref (response);
 }
 
-static void
-indication_cb (QmiDevice *device,
-               QmiMessage *message,
-               Client *client)
-{
-    guint i;
-
-    for (i = 0; i < client->qmi_client_info_array->len; i++) {
-        QmiClientInfo *info;
-
-        info = &g_array_index (client->qmi_client_info_array, QmiClientInfo, i);
-        /* If service and CID match; or if service and broadcast, forward to
-         * the remote client */
-        if ((qmi_message_get_service (message) == info->service) &&
-            (qmi_message_get_client_id (message) == info->cid ||
-             qmi_message_get_client_id (message) == QMI_CID_BROADCAST)) {
-            GError *error = NULL;
-
-            if (!client_send_message (client, message, &error)) {
-                g_warning ("couldn't forward indication to client: %s", error->message);
-                g_error_free (error);
-            }
-
-            /* Avoid forwarding broadcast messages multiple times */
-            break;
-        }
-    }
-}
-
 static void
 device_removed_cb (QmiDevice *device,
                    Client *client)
@@ -337,7 +589,7 @@ device_open_ready (QmiDevice *device,
                    Client *client)
 {
     QmiProxy *self = client->proxy;
-    QmiDevice *existing;
+    DeviceInfo *info;
     GError *error = NULL;
 
     /* Note: we get a full client ref */
@@ -350,25 +602,18 @@ device_open_ready (QmiDevice *device,
     }
 
     /* Store device in the proxy independently */
-    existing = find_device_for_path (self, qmi_device_get_path (client->device));
-    if (existing) {
+    info = g_hash_table_lookup (self->priv->devices, qmi_device_get_path (client->device));
+    if (info) {
         /* Race condition, we created two QmiDevices for the same port, just skip ours, no big deal */
         g_object_unref (client->device);
-        client->device = g_object_ref (existing);
+        client->device = g_object_ref (info->device);
     } else {
         /* Keep the newly added device in the proxy */
-        self->priv->devices = g_list_append (self->priv->devices, g_object_ref (client->device));
+        info = device_info_new (client->device);
+        g_hash_table_insert (self->priv->devices, g_strdup (qmi_device_get_path (client->device)), info);
     }
 
-    /* Register for device indications */
-    client->indication_id = g_signal_connect (client->device,
-                                              "indication",
-                                              G_CALLBACK (indication_cb),
-                                              client);
-    client->device_removed_id = g_signal_connect (client->device,
-                                                  "device-removed",
-                                                  G_CALLBACK (device_removed_cb),
-                                                  client);
+    client_attach_device (client, info);
 
     complete_internal_proxy_open (self, client);
 
@@ -395,6 +640,10 @@ device_new_ready (GObject *source,
         goto out;
     }
 
+    /* Every request and response goes through the proxy, so recycle their
+     * buffers */
+    g_object_set (client->device, QMI_DEVICE_MESSAGE_POOL, TRUE, NULL);
+
     qmi_device_open (client->device,
                      QMI_DEVICE_OPEN_FLAGS_NONE,
                      10,
@@ -415,6 +664,7 @@ process_internal_proxy_open (QmiProxy   *self,
     const guint8 *buffer;
     guint16 buffer_len;
     gchar *device_file_path;
+    DeviceInfo *info;
 
     buffer = qmi_message_get_raw_tlv (message,
                                       QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN_INPUT_TLV_DEVICE_PATH,
@@ -430,10 +680,10 @@ process_internal_proxy_open (QmiProxy   *self,
     /* Keep it */
     client->internal_proxy_open_request = qmi_message_ref (message);
 
-    client->device = find_device_for_path (self, device_file_path);
+    info = g_hash_table_lookup (self->priv->devices, device_file_path);
 
     /* Need to create a device ourselves */
-    if (!client->device) {
+    if (!info) {
         GFile *file;
 
         file = g_file_new_for_path (device_file_path);
@@ -449,7 +699,8 @@ process_internal_proxy_open (QmiProxy   *self,
     g_free (device_file_path);
 
     /* Keep a reference to the device in the client */
-    g_object_ref (client->device);
+    client->device = g_object_ref (info->device);
+    client_attach_device (client, info);
 
     complete_internal_proxy_open (self, client);
     return FALSE;
@@ -510,11 +761,15 @@ track_cid (Client *client,
                  qmi_service_get_string (info.service),
                  info.cid);
         g_array_append_val (client->qmi_client_info_array, info);
+        if (client->device_info)
+            device_info_add_cid (client->device_info, client, &info);
     } else if (!track && exists) {
         g_debug ("QMI client untracked [%s,%s,%u]",
                  qmi_device_get_path_display (client->device),
                  qmi_service_get_string (info.service),
                  info.cid);
+        if (client->device_info)
+            device_info_remove_cid (client->device_info, client, &info);
         g_array_remove_index (client->qmi_client_info_array, i);
     }
 }
@@ -612,41 +867,60 @@ process_message (QmiProxy   *self,
     return TRUE;
 }
 
+/*****************************************************************************/
+
 static void
 parse_request (QmiProxy *self,
                Client   *client)
 {
-    do {
+    /* Stop as soon as the client is disconnected while processing */
+    while (client->connection &&
+           client->buffer.end > client->buffer.start) {
         GError *error = NULL;
         QmiMessage *message;
+        const guint8 *data;
+        gsize data_len;
+        gsize frame_len;
+
+        data = client->buffer.data + client->buffer.start;
+        data_len = client->buffer.end - client->buffer.start;
 
         /* Every message received must start with the QMUX marker.
          * If it doesn't, we broke framing :-/
          * If we broke framing, an error should be reported and the device
          * should get closed */
-        if (client->buffer->len > 0 &&
-            client->buffer->data[0] != QMI_MESSAGE_QMUX_MARKER) {
+        if (data[0] != QMI_MESSAGE_QMUX_MARKER) {
             /* TODO: Report fatal error */
             g_warning ("QMI framing error detected");
             return;
         }
 
-        message = qmi_message_new_from_raw (client->buffer, &error);
-        if (!message) {
-            if (!error)
-                /* More data we need */
-                return;
+        /* The frame is copied once, straight into the message passed to the
+         * device, recycled from the device pool; no device yet for the
+         * internal proxy open request */
+        message = __qmi_message_new_from_data (client->device ? __qmi_device_peek_message_pool (client->device) : NULL,
+                                               data,
+                                               data_len,
+                                               &frame_len,
+                                               &error);
+        if (!message && !error)
+            /* More data we need */
+            return;
+
+        __qmi_io_receive_buffer_consume (&client->buffer, frame_len);
 
+        if (!message) {
             /* Warn about the issue */
             g_warning ("Invalid QMI message received: '%s'",
                        error->message);
             g_error_free (error);
-        } else {
-            /* Play with the received message */
-            process_message (self, client, message);
-            qmi_message_unref (message);
+            continue;
         }
-    } while (client->buffer->len > 0);
+
+        /* Play with the received message */
+        process_message (self, client, message);
+        qmi_message_unref (message);
+    }
 }
 
 static gboolean
@@ -655,7 +929,7 @@ connection_readable_cb (GSocket *socket,
                         Client *client)
 {
     QmiProxy *self;
-    guint8 buffer[BUFFER_SIZE];
+    guint8 *buffer;
     GError *error = NULL;
     gssize r;
 
@@ -669,12 +943,18 @@ connection_readable_cb (GSocket *socket,
     if (!(condition & G_IO_IN || condition & G_IO_PRI))
         return TRUE;
 
-    r = g_input_stream_read (g_io_stream_get_input_stream (G_IO_STREAM (client->connection)),
-                             buffer,
-                             BUFFER_SIZE,
-                             NULL,
-                             &error);
+    /* Read directly into the receive buffer */
+    buffer = __qmi_io_receive_buffer_reserve (&client->buffer, BUFFER_SIZE);
+    r = g_pollable_input_stream_read_nonblocking (G_POLLABLE_INPUT_STREAM (g_io_stream_get_input_stream (G_IO_STREAM (client->connection))),
+                                                  buffer,
+                                                  BUFFER_SIZE,
+                                                  NULL,
+                                                  &error);
     if (r < 0) {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+            g_error_free (error);
+            return TRUE;
+        }
         g_warning ("Error reading from istream: %s", error ? error->message : "unknown");
         if (error)
             g_error_free (error);
@@ -686,12 +966,12 @@ connection_readable_cb (GSocket *socket,
         return TRUE;
 
     /* else, r > 0 */
-    if (!G_UNLIKELY (client->buffer))
-        client->buffer = g_byte_array_sized_new (r);
-    g_byte_array_append (client->buffer, buffer, r);
+    __qmi_io_receive_buffer_commit (&client->buffer, r);
 
-    /* Try to parse input messages */
+    /* Try to parse input messages; processing them may untrack the client */
+    client_ref (client);
     parse_request (self, client);
+    client_unref (client);
 
     return TRUE;
 }
@@ -706,6 +986,7 @@ incoming_cb (GSocketService *service,
     GCredentials *credentials;
     GError *error = NULL;
     uid_t uid;
+    pid_t pid;
 
     g_debug ("Client (%d) connection open...", g_socket_get_fd (g_socket_connection_get_socket (connection)));
 
@@ -716,6 +997,9 @@ incoming_cb (GSocketService *service,
         return;
     }
 
+    /* Only used to identify the client in the stats */
+    pid = g_credentials_get_unix_pid (credentials, NULL);
+
     uid = g_credentials_get_unix_user (credentials, &error);
     g_object_unref (credentials);
     if (error) {
@@ -743,6 +1027,8 @@ incoming_cb (GSocketService *service,
                            NULL);
     g_source_attach (client->connection_readable_source, g_main_context_get_thread_default ());
     client->qmi_client_info_array = g_array_sized_new (FALSE, FALSE, sizeof (QmiClientInfo), 8);
+    __qmi_io_output_queue_init (&client->output_queue);
+    client->pid = (pid > 0 ? (guint32) pid : 0);
 
     /* Keep the client info around */
     track_client (self, client);
@@ -822,6 +1108,36 @@ qmi_proxy_init (QmiProxy *self)
     self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
                                               QMI_TYPE_PROXY,
                                               QmiProxyPrivate);
+
+    self->priv->clients = g_hash_table_new_full (g_direct_hash,
+                                                 g_direct_equal,
+                                                 (GDestroyNotify)client_unref,
+                                                 NULL);
+    self->priv->devices = g_hash_table_new_full (g_str_hash,
+                                                 g_str_equal,
+                                                 g_free,
+                                                 (GDestroyNotify)device_info_free);
+}
+
+static void
+set_property (GObject *object,
+              guint prop_id,
+              const GValue *value,
+              GParamSpec *pspec)
+{
+    QmiProxy *self = QMI_PROXY (object);
+
+    switch (prop_id) {
+    case PROP_CLIENT_QUEUE_LIMIT:
+        self->priv->client_queue_limit = g_value_get_uint (value);
+        break;
+    case PROP_CLIENT_QUEUE_POLICY:
+        self->priv->client_queue_policy = g_value_get_enum (value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
 }
 
 static void
@@ -834,7 +1150,13 @@ get_property (GObject *object,
 
     switch (prop_id) {
     case PROP_N_CLIENTS:
-        g_value_set_uint (value, g_list_length (self->priv->clients));
+        g_value_set_uint (value, g_hash_table_size (self->priv->clients));
+        break;
+    case PROP_CLIENT_QUEUE_LIMIT:
+        g_value_set_uint (value, self->priv->client_queue_limit);
+        break;
+    case PROP_CLIENT_QUEUE_POLICY:
+        g_value_set_enum (value, self->priv->client_queue_policy);
         break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -847,10 +1169,8 @@ dispose (GObject *object)
 {
     QmiProxyPrivate *priv = QMI_PROXY (object)->priv;
 
-    if (priv->clients) {
-        g_list_free_full (priv->clients, (GDestroyNotify) client_unref);
-        priv->clients = NULL;
-    }
+    g_clear_pointer (&priv->clients, g_hash_table_unref);
+    g_clear_pointer (&priv->devices, g_hash_table_unref);
 
     if (priv->socket_service) {
         if (g_socket_service_is_active (priv->socket_service))
@@ -871,6 +1191,7 @@ qmi_proxy_class_init (QmiProxyClass *proxy_class)
     g_type_class_add_private (object_class, sizeof (QmiProxyPrivate));
 
     object_class->get_property = get_property;
+    object_class->set_property = set_property;
     object_class->dispose = dispose;
 
     /**
@@ -887,4 +1208,39 @@ qmi_proxy_class_init (QmiProxyClass *proxy_class)
                            0,
                            G_PARAM_READABLE);
     g_object_class_install_property (object_class, PROP_N_CLIENTS, properties[PROP_N_CLIENTS]);
+
+    /**
+     * QmiProxy:qmi-proxy-client-queue-limit:
+     *
+     * Maximum number of messages queued for a client not reading them fast
+     * enough, or 0 to queue them without limit.
+     *
+     * Since: 1.22
+     */
+    properties[PROP_CLIENT_QUEUE_LIMIT] =
+        g_param_spec_uint (QMI_PROXY_CLIENT_QUEUE_LIMIT,
+                           "Client queue limit",
+                           "Maximum number of messages queued per client, 0 if unlimited",
+                           0,
+                           G_MAXUINT,
+                           0,
+                           G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_CLIENT_QUEUE_LIMIT, properties[PROP_CLIENT_QUEUE_LIMIT]);
+
+    /**
+     * QmiProxy:qmi-proxy-client-queue-policy:
+     *
+     * What to do with a client once its queue reaches the
+     * #QmiProxy:qmi-proxy-client-queue-limit.
+     *
+     * Since: 1.22
+     */
+    properties[PROP_CLIENT_QUEUE_POLICY] =
+        g_param_spec_enum (QMI_PROXY_CLIENT_QUEUE_POLICY,
+                           "Client queue policy",
+                           "Action taken when a client queue is full",
+                           QMI_TYPE_PROXY_CLIENT_QUEUE_POLICY,
+                           QMI_PROXY_CLIENT_QUEUE_POLICY_DROP,
+                           G_PARAM_READWRITE);
+    g_object_class_install_property (object_class, PROP_CLIENT_QUEUE_POLICY, properties[PROP_CLIENT_QUEUE_POLICY]);
 }
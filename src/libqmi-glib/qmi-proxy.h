@@ -70,6 +70,45 @@ typedef struct _QmiProxyPrivate QmiProxyPrivate;
  */
 #define QMI_PROXY_N_CLIENTS   "qmi-proxy-n-clients"
 
+/**
+ * QMI_PROXY_CLIENT_QUEUE_LIMIT:
+ *
+ * Symbol defining the #QmiProxy:qmi-proxy-client-queue-limit property.
+ *
+ * Since: 1.22
+ */
+#define QMI_PROXY_CLIENT_QUEUE_LIMIT  "qmi-proxy-client-queue-limit"
+
+/**
+ * QMI_PROXY_CLIENT_QUEUE_POLICY:
+ *
+ * Symbol defining the #QmiProxy:qmi-proxy-client-queue-policy property.
+ *
+ * Since: 1.22
+ */
+#define QMI_PROXY_CLIENT_QUEUE_POLICY "qmi-proxy-client-queue-policy"
+
+/**
+ * QmiProxyClientQueuePolicy:
+ * @QMI_PROXY_CLIENT_QUEUE_POLICY_DROP: Drop the indications for the client until its queue has room again; responses are still queued.
+ * @QMI_PROXY_CLIENT_QUEUE_POLICY_DISCONNECT: Disconnect the client.
+ *
+ * Action taken when the output queue of a client reaches the
+ * #QmiProxy:qmi-proxy-client-queue-limit.
+ *
+ * Since: 1.22
+ */
+typedef enum {
+    QMI_PROXY_CLIENT_QUEUE_POLICY_DROP       = 0,
+    QMI_PROXY_CLIENT_QUEUE_POLICY_DISCONNECT = 1,
+} QmiProxyClientQueuePolicy;
+
+/**
+ * qmi_proxy_client_queue_policy_get_string:
+ *
+ * Since: 1.22
+ */
+
 /**
  * QmiProxy:
  *
@@ -113,4 +152,37 @@ QmiProxy *qmi_proxy_new (GError **error);
  */
 guint qmi_proxy_get_n_clients (QmiProxy *self);
 
+/**
+ * QmiProxyClientStats:
+ * @pid: process ID of the client, or 0 if unknown.
+ * @queue_depth: number of messages pending to be written to the client.
+ * @queue_depth_max: maximum number of messages that were pending at once.
+ * @dropped: number of indications dropped because the queue was full.
+ *
+ * Output queue statistics of a client connected to the proxy.
+ *
+ * Since: 1.22
+ */
+typedef struct {
+    guint32 pid;
+    guint   queue_depth;
+    guint   queue_depth_max;
+    guint64 dropped;
+} QmiProxyClientStats;
+
+/**
+ * qmi_proxy_get_client_stats:
+ * @self: a #QmiProxy.
+ *
+ * Gets the output queue statistics of each client currently connected to the
+ * proxy.
+ *
+ * Returns: (transfer full) (element-type QmiProxyClientStats): a #GArray of
+ * #QmiProxyClientStats, one per client. The returned value should be freed
+ * with g_array_unref().
+ *
+ * Since: 1.22
+ */
+GArray *qmi_proxy_get_client_stats (QmiProxy *self);
+
 #endif /* QMI_PROXY_H */
@@ -755,6 +755,53 @@ __qmi_utils_get_driver (const gchar *cdc_wdm_path)
     return driver;
 }
 
+gchar *
+__qmi_utils_get_firmware_identity (const gchar *cdc_wdm_path)
+{
+    static const gchar *subsystems[] = { "usbmisc", "usb" };
+    static const gchar *attributes[] = { "idVendor", "idProduct", "bcdDevice" };
+    guint i;
+    gchar *device_basename;
+    gchar *identity = NULL;
+
+    device_basename = g_path_get_basename (cdc_wdm_path);
+
+    for (i = 0; !identity && i < G_N_ELEMENTS (subsystems); i++) {
+        GString *str;
+        guint j;
+
+        /* The attributes are in the USB device, parent of the interface; e.g.
+         * for subsystem usbmisc and name cdc-wdm0:
+         *    $ cat /sys/class/usbmisc/cdc-wdm0/device/../bcdDevice
+         *    0006
+         */
+        str = g_string_new ("usb");
+        for (j = 0; j < G_N_ELEMENTS (attributes); j++) {
+            gchar *path;
+            gchar *contents = NULL;
+
+            path = g_strdup_printf ("/sys/class/%s/%s/device/../%s", subsystems[i], device_basename, attributes[j]);
+            g_file_get_contents (path, &contents, NULL, NULL);
+            g_free (path);
+
+            if (!contents)
+                break;
+
+            g_string_append_printf (str, ":%s", g_strstrip (contents));
+            g_free (contents);
+        }
+
+        if (j == G_N_ELEMENTS (attributes))
+            identity = g_string_free (str, FALSE);
+        else
+            g_string_free (str, TRUE);
+    }
+
+    g_free (device_basename);
+
+    return identity;
+}
+
 /*****************************************************************************/
 
 static volatile gint __traces_enabled = FALSE;
@@ -655,6 +655,8 @@ gboolean __qmi_user_allowed (uid_t uid,
                              GError **error);
 G_GNUC_INTERNAL
 gchar *__qmi_utils_get_driver (const gchar *cdc_wdm_path);
+G_GNUC_INTERNAL
+gchar *__qmi_utils_get_firmware_identity (const gchar *cdc_wdm_path);
 
 static inline gfloat
 __QMI_GFLOAT_SWAP_LE_BE(gfloat in)
@@ -0,0 +1,923 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Benchmarks of the libqmi-glib request, response and indication paths,
+ * run against a simulated modem living in a thread of the same process.
+ * Not part of the test suite, run with 'make bench'.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <libqmi-glib.h>
+
+#define BUFFER_SIZE 4096
+
+/* Operations timed together when a single one is too fast for the clock */
+#define BATCH_SIZE 100
+
+#define QMI_MESSAGE_CTL_ALLOCATE_CID        0x0022
+#define QMI_MESSAGE_CTL_RELEASE_CID         0x0023
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN 0xFF00
+#define QMI_MESSAGE_DMS_GET_IDS             0x0025
+#define QMI_MESSAGE_DMS_UIM_VERIFY_PIN      0x0028
+
+/* Options */
+static gint n_iterations = 10000;
+static gint n_clients    = 8;
+static gint window       = 32;
+
+static GOptionEntry main_entries[] = {
+    { "iterations", 'n', 0, G_OPTION_ARG_INT, &n_iterations,
+      "Number of operations in each benchmark (default: 10000)",
+      "[N]"
+    },
+    { "clients", 'c', 0, G_OPTION_ARG_INT, &n_clients,
+      "Number of clients receiving indications (default: 8)",
+      "[N]"
+    },
+    { "window", 'w', 0, G_OPTION_ARG_INT, &window,
+      "Number of requests in flight in the throughput benchmark (default: 32)",
+      "[N]"
+    },
+    { NULL }
+};
+
+/* DMS Get IDs response, as in test-generated */
+static const guint8 get_ids_response[] = {
+    0x01,
+    0x45, 0x00, 0x80, 0x02, 0x01,
+    0x02, 0xFF, 0xFF, 0x25, 0x00, 0x39, 0x00, 0x02,
+    0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x13, 0x01,
+    0x00, 0x42, 0x12, 0x0E, 0x00, 0x33, 0x35, 0x39,
+    0x32, 0x32, 0x35, 0x30, 0x35, 0x30, 0x30, 0x33,
+    0x39, 0x39, 0x37, 0x10, 0x08, 0x00, 0x38, 0x30,
+    0x39, 0x39, 0x37, 0x38, 0x37, 0x34, 0x11, 0x0F,
+    0x00, 0x33, 0x35, 0x39, 0x32, 0x32, 0x35, 0x30,
+    0x35, 0x30, 0x30, 0x33, 0x39, 0x39, 0x37, 0x33
+};
+
+/* DMS Event Report broadcast indication, with the Power State TLV */
+static const guint8 event_report_indication[] = {
+    0x01,       /* marker */
+    /* QMUX */
+    0x11, 0x00, /* length */
+    0x80,       /* flags */
+    0x02,       /* service DMS */
+    0xFF,       /* client broadcast */
+    /* QMI header */
+    0x04,       /* flags: Indication */
+    0x00, 0x00, /* transaction */
+    0x01, 0x00, /* message: Event report */
+    0x05, 0x00, /* tlv length */
+    /* TLV */
+    0x10,       /* type: Power State */
+    0x02, 0x00, /* length */
+    0x01,       /* flags */
+    0x50        /* battery level */
+};
+
+/*****************************************************************************/
+/* Results */
+
+static gint
+compare_samples (const gdouble *a,
+                 const gdouble *b)
+{
+    return (*a > *b) - (*a < *b);
+}
+
+/* Samples are given in nanoseconds */
+static void
+report (const gchar *name,
+        GArray      *samples,
+        guint        n_messages,
+        gdouble      elapsed)
+{
+    gdouble *values;
+    guint    n;
+
+    g_assert (samples->len > 0);
+    g_array_sort (samples, (GCompareFunc) compare_samples);
+    values = (gdouble *) samples->data;
+    n = samples->len;
+
+    g_print ("%-24s p50 %10.0lf ns   p99 %10.0lf ns   %12.0lf msgs/s\n",
+             name,
+             values[(n * 50) / 100],
+             values[MIN (n - 1, (n * 99) / 100)],
+             elapsed > 0.0 ? n_messages / elapsed : 0.0);
+}
+
+/*****************************************************************************/
+/* Simulated modem
+ *
+ * Same setup as test-port-context: a thread with its own main context serving
+ * the abstract socket that the device connects to when opened through the
+ * proxy. Every request gets a successful response right away.
+ */
+
+typedef struct {
+    gchar             *name;
+    GThread           *thread;
+    GMainContext      *context;
+    GMainLoop         *loop;
+    gboolean           ready;
+    GCond              ready_cond;
+    GMutex             ready_mutex;
+    GSocketService    *socket_service;
+    GSocketConnection *connection;
+    GSource           *connection_readable_source;
+    GByteArray        *buffer;
+    guint8             next_cid;
+
+    /* Indication burst */
+    guint              n_indications;
+    gint64            *indication_times;
+} Modem;
+
+static void
+modem_send (Modem        *modem,
+            const guint8 *data,
+            gsize         len)
+{
+    GError *error = NULL;
+
+    if (!g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (modem->connection)),
+                                    data,
+                                    len,
+                                    NULL, /* bytes_written */
+                                    NULL, /* cancellable */
+                                    &error)) {
+        g_warning ("Cannot send message to device: %s", error->message);
+        g_error_free (error);
+    }
+}
+
+static void
+write_allocation_info (QmiMessage *response,
+                       guint8      service,
+                       guint8      cid)
+{
+    gsize init_offset;
+
+    init_offset = qmi_message_tlv_write_init (response, 0x01, NULL);
+    qmi_message_tlv_write_guint8 (response, service, NULL);
+    qmi_message_tlv_write_guint8 (response, cid, NULL);
+    qmi_message_tlv_write_complete (response, init_offset, NULL);
+}
+
+static void
+write_string (QmiMessage  *response,
+              guint8       type,
+              const gchar *str)
+{
+    gsize init_offset;
+
+    init_offset = qmi_message_tlv_write_init (response, type, NULL);
+    qmi_message_tlv_write_string (response, 0, str, -1, NULL);
+    qmi_message_tlv_write_complete (response, init_offset, NULL);
+}
+
+static void
+modem_process_request (Modem      *modem,
+                       QmiMessage *request)
+{
+    QmiMessage *response;
+    gsize       init_offset;
+    gsize       offset = 0;
+    guint8      service = 0;
+    guint8      cid = 0;
+
+    response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+
+    switch (qmi_message_get_service (request)) {
+    case QMI_SERVICE_CTL:
+        switch (qmi_message_get_message_id (request)) {
+        case QMI_MESSAGE_CTL_ALLOCATE_CID:
+            init_offset = qmi_message_tlv_read_init (request, 0x01, NULL, NULL);
+            if (init_offset)
+                qmi_message_tlv_read_guint8 (request, init_offset, &offset, &service, NULL);
+            write_allocation_info (response, service, modem->next_cid++);
+            break;
+        case QMI_MESSAGE_CTL_RELEASE_CID:
+            init_offset = qmi_message_tlv_read_init (request, 0x01, NULL, NULL);
+            if (init_offset) {
+                qmi_message_tlv_read_guint8 (request, init_offset, &offset, &service, NULL);
+                qmi_message_tlv_read_guint8 (request, init_offset, &offset, &cid, NULL);
+            }
+            write_allocation_info (response, service, cid);
+            break;
+        case QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN:
+        default:
+            break;
+        }
+        break;
+    case QMI_SERVICE_DMS:
+        if (qmi_message_get_message_id (request) == QMI_MESSAGE_DMS_GET_IDS) {
+            write_string (response, 0x10, "80997874");
+            write_string (response, 0x11, "359225050039973");
+            write_string (response, 0x12, "35922505003997");
+        }
+        break;
+    default:
+        break;
+    }
+
+    modem_send (modem, ((GByteArray *)response)->data, ((GByteArray *)response)->len);
+    qmi_message_unref (response);
+}
+
+static gboolean
+connection_readable_cb (GSocket      *socket,
+                        GIOCondition  condition,
+                        Modem        *modem)
+{
+    guint8  buffer[BUFFER_SIZE];
+    GError *error = NULL;
+    gssize  r;
+
+    if (condition & G_IO_HUP || condition & G_IO_ERR)
+        goto out;
+
+    if (!(condition & G_IO_IN || condition & G_IO_PRI))
+        return TRUE;
+
+    r = g_input_stream_read (g_io_stream_get_input_stream (G_IO_STREAM (modem->connection)),
+                             buffer,
+                             BUFFER_SIZE,
+                             NULL,
+                             &error);
+    if (r < 0) {
+        g_warning ("Error reading from istream: %s", error ? error->message : "unknown");
+        g_clear_error (&error);
+        goto out;
+    }
+
+    if (r == 0)
+        return TRUE;
+
+    g_byte_array_append (modem->buffer, buffer, r);
+
+    /* Process all complete requests */
+    while (modem->buffer->len > 0) {
+        QmiMessage *request;
+
+        request = qmi_message_new_from_raw (modem->buffer, &error);
+        if (!request) {
+            if (error) {
+                g_warning ("Invalid request received: %s", error->message);
+                g_clear_error (&error);
+                continue;
+            }
+            /* More data we need */
+            break;
+        }
+
+        modem_process_request (modem, request);
+        qmi_message_unref (request);
+    }
+
+    return TRUE;
+
+out:
+    g_source_unref (modem->connection_readable_source);
+    modem->connection_readable_source = NULL;
+    g_clear_object (&modem->connection);
+    return FALSE;
+}
+
+static void
+incoming_cb (GSocketService    *service,
+             GSocketConnection *connection,
+             GObject           *unused,
+             Modem             *modem)
+{
+    /* A single device is expected */
+    g_assert (!modem->connection);
+
+    modem->connection = g_object_ref (connection);
+    g_byte_array_set_size (modem->buffer, 0);
+    modem->connection_readable_source = g_socket_create_source (g_socket_connection_get_socket (connection),
+                                                                G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP,
+                                                                NULL);
+    g_source_set_callback (modem->connection_readable_source,
+                           (GSourceFunc)connection_readable_cb,
+                           modem,
+                           NULL);
+    g_source_attach (modem->connection_readable_source, modem->context);
+}
+
+static void
+create_socket_service (Modem *modem)
+{
+    GError         *error = NULL;
+    GSocketAddress *address;
+    GSocket        *socket;
+
+    socket = g_socket_new (G_SOCKET_FAMILY_UNIX,
+                           G_SOCKET_TYPE_STREAM,
+                           G_SOCKET_PROTOCOL_DEFAULT,
+                           &error);
+    if (!socket)
+        g_error ("Cannot create socket: %s", error->message);
+
+    address = g_unix_socket_address_new_with_type (modem->name, -1, G_UNIX_SOCKET_ADDRESS_ABSTRACT);
+    if (!g_socket_bind (socket, address, TRUE, &error))
+        g_error ("Cannot bind socket '%s': %s", modem->name, error->message);
+
+    if (!g_socket_listen (socket, &error))
+        g_error ("Cannot listen in socket: %s", error->message);
+
+    modem->socket_service = g_socket_service_new ();
+    g_signal_connect (modem->socket_service, "incoming", G_CALLBACK (incoming_cb), modem);
+    if (!g_socket_listener_add_socket (G_SOCKET_LISTENER (modem->socket_service), socket, NULL, &error))
+        g_error ("Cannot add listener to socket: %s", error->message);
+    g_socket_service_start (modem->socket_service);
+
+    g_object_unref (socket);
+    g_object_unref (address);
+}
+
+static gpointer
+modem_thread_func (Modem *modem)
+{
+    g_main_context_push_thread_default (modem->context);
+
+    create_socket_service (modem);
+    modem->loop = g_main_loop_new (modem->context, FALSE);
+
+    /* Signal that the thread is ready */
+    g_mutex_lock (&modem->ready_mutex);
+    modem->ready = TRUE;
+    g_cond_signal (&modem->ready_cond);
+    g_mutex_unlock (&modem->ready_mutex);
+
+    g_main_loop_run (modem->loop);
+    g_main_loop_unref (modem->loop);
+    modem->loop = NULL;
+
+    if (modem->connection_readable_source) {
+        g_source_destroy (modem->connection_readable_source);
+        g_source_unref (modem->connection_readable_source);
+        modem->connection_readable_source = NULL;
+    }
+    g_clear_object (&modem->connection);
+    g_socket_service_stop (modem->socket_service);
+    g_clear_object (&modem->socket_service);
+
+    g_main_context_pop_thread_default (modem->context);
+    return NULL;
+}
+
+static Modem *
+modem_new (const gchar *name)
+{
+    Modem *modem;
+
+    modem = g_slice_new0 (Modem);
+    modem->name = g_strdup (name);
+    modem->context = g_main_context_new ();
+    modem->buffer = g_byte_array_sized_new (BUFFER_SIZE);
+    modem->next_cid = 1;
+    g_cond_init (&modem->ready_cond);
+    g_mutex_init (&modem->ready_mutex);
+
+    modem->thread = g_thread_new (name, (GThreadFunc)modem_thread_func, modem);
+
+    g_mutex_lock (&modem->ready_mutex);
+    while (!modem->ready)
+        g_cond_wait (&modem->ready_cond, &modem->ready_mutex);
+    g_mutex_unlock (&modem->ready_mutex);
+
+    return modem;
+}
+
+static gboolean
+modem_quit_cb (Modem *modem)
+{
+    g_main_loop_quit (modem->loop);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+modem_free (Modem *modem)
+{
+    g_main_context_invoke (modem->context, (GSourceFunc)modem_quit_cb, modem);
+    g_thread_join (modem->thread);
+
+    g_cond_clear (&modem->ready_cond);
+    g_mutex_clear (&modem->ready_mutex);
+    g_byte_array_unref (modem->buffer);
+    g_main_context_unref (modem->context);
+    g_free (modem->name);
+    g_slice_free (Modem, modem);
+}
+
+static gboolean
+modem_send_indications_cb (Modem *modem)
+{
+    guint i;
+
+    for (i = 0; i < modem->n_indications; i++) {
+        modem->indication_times[i] = g_get_monotonic_time ();
+        modem_send (modem, event_report_indication, G_N_ELEMENTS (event_report_indication));
+    }
+    return G_SOURCE_REMOVE;
+}
+
+/* Sends the burst from the modem thread; the send time of each indication is
+ * stored in @times */
+static void
+modem_send_indications (Modem  *modem,
+                        guint   n_indications,
+                        gint64 *times)
+{
+    modem->n_indications = n_indications;
+    modem->indication_times = times;
+    g_main_context_invoke (modem->context, (GSourceFunc)modem_send_indications_cb, modem);
+}
+
+/*****************************************************************************/
+/* Message building and parsing */
+
+static void
+bench_request_encode (void)
+{
+    GArray *samples;
+    GTimer *timer;
+    gdouble elapsed = 0.0;
+    guint   n_batches;
+    guint   i, j;
+
+    n_batches = MAX (1, n_iterations / BATCH_SIZE);
+    samples = g_array_sized_new (FALSE, FALSE, sizeof (gdouble), n_batches);
+    timer = g_timer_new ();
+
+    for (i = 0; i < n_batches; i++) {
+        gdouble batch_elapsed;
+        gdouble sample;
+
+        g_timer_start (timer);
+        for (j = 0; j < BATCH_SIZE; j++) {
+            QmiMessage *request;
+            gsize       init_offset;
+
+            /* DMS UIM Verify PIN: PIN id and PIN value */
+            request = qmi_message_new (QMI_SERVICE_DMS, 1, (guint16) (j + 1), QMI_MESSAGE_DMS_UIM_VERIFY_PIN);
+            init_offset = qmi_message_tlv_write_init (request, 0x01, NULL);
+            qmi_message_tlv_write_guint8 (request, 0x01, NULL);
+            qmi_message_tlv_write_string (request, 1, "1234", -1, NULL);
+            qmi_message_tlv_write_complete (request, init_offset, NULL);
+            qmi_message_unref (request);
+        }
+        batch_elapsed = g_timer_elapsed (timer, NULL);
+        elapsed += batch_elapsed;
+        sample = (batch_elapsed * 1e9) / BATCH_SIZE;
+        g_array_append_val (samples, sample);
+    }
+
+    report ("request encode", samples, n_batches * BATCH_SIZE, elapsed);
+    g_timer_destroy (timer);
+    g_array_unref (samples);
+}
+
+static void
+bench_response_parse (void)
+{
+    static const guint8 types[] = { 0x10, 0x11, 0x12 };
+    GByteArray *buffer;
+    GArray     *samples;
+    GTimer     *timer;
+    gdouble     elapsed = 0.0;
+    guint       n_batches;
+    guint       i, j, k;
+
+    n_batches = MAX (1, n_iterations / BATCH_SIZE);
+    samples = g_array_sized_new (FALSE, FALSE, sizeof (gdouble), n_batches);
+    buffer = g_byte_array_sized_new (sizeof (get_ids_response));
+    timer = g_timer_new ();
+
+    for (i = 0; i < n_batches; i++) {
+        gdouble batch_elapsed;
+        gdouble sample;
+
+        g_timer_start (timer);
+        for (j = 0; j < BATCH_SIZE; j++) {
+            QmiMessage *response;
+
+            /* Same steps as when reading from the port: take the frame out of
+             * the input buffer, then read the ESN, IMEI and MEID */
+            g_byte_array_append (buffer, get_ids_response, sizeof (get_ids_response));
+            response = qmi_message_new_from_raw (buffer, NULL);
+            g_assert (response);
+            for (k = 0; k < G_N_ELEMENTS (types); k++) {
+                gsize  init_offset;
+                gsize  offset = 0;
+                gchar *str = NULL;
+
+                init_offset = qmi_message_tlv_read_init (response, types[k], NULL, NULL);
+                if (init_offset && qmi_message_tlv_read_string (response, init_offset, &offset, 0, 0, &str, NULL))
+                    g_free (str);
+            }
+            qmi_message_unref (response);
+        }
+        batch_elapsed = g_timer_elapsed (timer, NULL);
+        elapsed += batch_elapsed;
+        sample = (batch_elapsed * 1e9) / BATCH_SIZE;
+        g_array_append_val (samples, sample);
+    }
+
+    report ("response parse", samples, n_batches * BATCH_SIZE, elapsed);
+    g_timer_destroy (timer);
+    g_byte_array_unref (buffer);
+    g_array_unref (samples);
+}
+
+/*****************************************************************************/
+/* Device setup */
+
+typedef struct {
+    GMainLoop  *loop;
+    gchar      *path;
+    Modem      *modem;
+    QmiDevice  *device;
+    GPtrArray  *clients;
+
+    /* Running benchmark */
+    GArray     *samples;
+    guint       n_started;
+    guint       n_finished;
+    guint       n_expected;
+    gint64     *times;
+} Context;
+
+static void
+device_new_ready (GObject      *source,
+                  GAsyncResult *res,
+                  Context      *ctx)
+{
+    GError *error = NULL;
+
+    ctx->device = qmi_device_new_finish (res, &error);
+    if (!ctx->device)
+        g_error ("Cannot create device: %s", error->message);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+device_open_ready (QmiDevice    *device,
+                   GAsyncResult *res,
+                   Context      *ctx)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_open_finish (device, res, &error))
+        g_error ("Cannot open device: %s", error->message);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+device_allocate_client_ready (QmiDevice    *device,
+                              GAsyncResult *res,
+                              Context      *ctx)
+{
+    GError    *error = NULL;
+    QmiClient *client;
+
+    client = qmi_device_allocate_client_finish (device, res, &error);
+    if (!client)
+        g_error ("Cannot allocate client: %s", error->message);
+    g_ptr_array_add (ctx->clients, client);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+device_release_client_ready (QmiDevice    *device,
+                             GAsyncResult *res,
+                             Context      *ctx)
+{
+    GError *error = NULL;
+
+    if (!qmi_device_release_client_finish (device, res, &error))
+        g_error ("Cannot release client: %s", error->message);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+context_setup (Context *ctx)
+{
+    GFile *file;
+    guint  i;
+
+    ctx->loop = g_main_loop_new (NULL, FALSE);
+    ctx->clients = g_ptr_array_new_with_free_func (g_object_unref);
+    ctx->path = g_strdup_printf ("/dev/qmi%08lu%04u", (gulong) getpid (), 0);
+    ctx->modem = modem_new (ctx->path);
+
+    file = g_file_new_for_path (ctx->path);
+    g_async_initable_new_async (QMI_TYPE_DEVICE,
+                                G_PRIORITY_DEFAULT,
+                                NULL,
+                                (GAsyncReadyCallback) device_new_ready,
+                                ctx,
+                                QMI_DEVICE_FILE,          file,
+                                QMI_DEVICE_NO_FILE_CHECK, TRUE,
+                                QMI_DEVICE_PROXY_PATH,    ctx->path,
+                                NULL);
+    g_object_unref (file);
+    g_main_loop_run (ctx->loop);
+
+    qmi_device_open (ctx->device, QMI_DEVICE_OPEN_FLAGS_PROXY, 5, NULL,
+                     (GAsyncReadyCallback) device_open_ready,
+                     ctx);
+    g_main_loop_run (ctx->loop);
+
+    for (i = 0; i < (guint) MAX (1, n_clients); i++) {
+        qmi_device_allocate_client (ctx->device, QMI_SERVICE_DMS, QMI_CID_NONE, 5, NULL,
+                                    (GAsyncReadyCallback) device_allocate_client_ready,
+                                    ctx);
+        g_main_loop_run (ctx->loop);
+    }
+}
+
+static void
+context_teardown (Context *ctx)
+{
+    guint i;
+
+    for (i = 0; i < ctx->clients->len; i++) {
+        qmi_device_release_client (ctx->device,
+                                   g_ptr_array_index (ctx->clients, i),
+                                   QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID,
+                                   5, NULL,
+                                   (GAsyncReadyCallback) device_release_client_ready,
+                                   ctx);
+        g_main_loop_run (ctx->loop);
+    }
+    g_ptr_array_unref (ctx->clients);
+
+    g_object_unref (ctx->device);
+    modem_free (ctx->modem);
+    g_main_loop_unref (ctx->loop);
+    g_free (ctx->path);
+}
+
+static void
+context_add_sample (Context *ctx,
+                    gint64   start)
+{
+    gdouble sample;
+
+    sample = (gdouble) ((g_get_monotonic_time () - start) * 1000);
+    g_array_append_val (ctx->samples, sample);
+}
+
+/*****************************************************************************/
+/* Transaction latency: one request after the other, through the generated
+ * client API (request build, transaction and response parse) */
+
+static void get_ids_next (Context *ctx);
+
+static void
+get_ids_ready (QmiClientDms *client,
+               GAsyncResult *res,
+               Context      *ctx)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError                    *error = NULL;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    if (!output || !qmi_message_dms_get_ids_output_get_result (output, &error))
+        g_error ("Get IDs failed: %s", error->message);
+    qmi_message_dms_get_ids_output_unref (output);
+
+    context_add_sample (ctx, ctx->times[ctx->n_finished++]);
+    get_ids_next (ctx);
+}
+
+static void
+get_ids_next (Context *ctx)
+{
+    if (ctx->n_started == ctx->n_expected) {
+        g_main_loop_quit (ctx->loop);
+        return;
+    }
+
+    ctx->times[ctx->n_started++] = g_get_monotonic_time ();
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (g_ptr_array_index (ctx->clients, 0)), NULL, 5, NULL,
+                            (GAsyncReadyCallback) get_ids_ready,
+                            ctx);
+}
+
+static void
+bench_transaction_latency (Context *ctx)
+{
+    GTimer *timer;
+
+    ctx->n_started = ctx->n_finished = 0;
+    ctx->n_expected = n_iterations;
+    ctx->samples = g_array_sized_new (FALSE, FALSE, sizeof (gdouble), n_iterations);
+    ctx->times = g_new (gint64, n_iterations);
+
+    timer = g_timer_new ();
+    get_ids_next (ctx);
+    g_main_loop_run (ctx->loop);
+
+    report ("transaction latency", ctx->samples, n_iterations, g_timer_elapsed (timer, NULL));
+
+    g_timer_destroy (timer);
+    g_clear_pointer (&ctx->times, g_free);
+    g_clear_pointer (&ctx->samples, g_array_unref);
+}
+
+/*****************************************************************************/
+/* Transaction throughput: a window of requests in flight, given directly to
+ * qmi_device_command_full() */
+
+static void command_next (Context *ctx);
+
+static void
+command_ready (QmiDevice    *device,
+               GAsyncResult *res,
+               gpointer      user_data)
+{
+    Context    *ctx = user_data;
+    QmiMessage *response;
+    GError     *error = NULL;
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    if (!response)
+        g_error ("Command failed: %s", error->message);
+    qmi_message_unref (response);
+
+    ctx->n_finished++;
+    if (ctx->n_finished == ctx->n_expected) {
+        g_main_loop_quit (ctx->loop);
+        return;
+    }
+    command_next (ctx);
+}
+
+static void
+command_next (Context *ctx)
+{
+    QmiClient  *client;
+    QmiMessage *request;
+
+    if (ctx->n_started == ctx->n_expected)
+        return;
+
+    ctx->n_started++;
+    client = g_ptr_array_index (ctx->clients, 0);
+    request = qmi_message_new (QMI_SERVICE_DMS,
+                               qmi_client_get_cid (client),
+                               qmi_client_get_next_transaction_id (client),
+                               QMI_MESSAGE_DMS_GET_IDS);
+    qmi_device_command_full (ctx->device, request, NULL, 5, NULL, command_ready, ctx);
+    qmi_message_unref (request);
+}
+
+static void
+bench_transaction_throughput (Context *ctx)
+{
+    GTimer *timer;
+    gdouble elapsed;
+    gdouble sample;
+    guint   i;
+
+    ctx->n_started = ctx->n_finished = 0;
+    ctx->n_expected = n_iterations;
+    ctx->samples = g_array_new (FALSE, FALSE, sizeof (gdouble));
+
+    timer = g_timer_new ();
+    for (i = 0; i < (guint) MAX (1, window); i++)
+        command_next (ctx);
+    g_main_loop_run (ctx->loop);
+    elapsed = g_timer_elapsed (timer, NULL);
+
+    /* With requests pipelined, the meaningful figure is the average time
+     * per transaction */
+    sample = (elapsed * 1e9) / n_iterations;
+    g_array_append_val (ctx->samples, sample);
+    report ("transaction throughput", ctx->samples, n_iterations, elapsed);
+
+    g_timer_destroy (timer);
+    g_clear_pointer (&ctx->samples, g_array_unref);
+}
+
+/*****************************************************************************/
+/* Indication fan-out: a burst of broadcast DMS Event Report indications,
+ * received by every DMS client */
+
+static void
+device_indication_cb (QmiDevice  *device,
+                      QmiMessage *message,
+                      Context    *ctx)
+{
+    /* Indications arrive in the same order they were sent */
+    context_add_sample (ctx, ctx->times[ctx->n_started++]);
+}
+
+static void
+client_event_report_cb (QmiClientDms                      *client,
+                        QmiIndicationDmsEventReportOutput *output,
+                        Context                           *ctx)
+{
+    if (++ctx->n_finished == ctx->n_expected)
+        g_main_loop_quit (ctx->loop);
+}
+
+static void
+bench_indication_fan_out (Context *ctx)
+{
+    GTimer *timer;
+    gulong  device_handler;
+    gulong *client_handlers;
+    gchar  *name;
+    guint   i;
+
+    ctx->n_started = ctx->n_finished = 0;
+    ctx->n_expected = n_iterations * ctx->clients->len;
+    ctx->samples = g_array_sized_new (FALSE, FALSE, sizeof (gdouble), n_iterations);
+    ctx->times = g_new0 (gint64, n_iterations);
+
+    device_handler = g_signal_connect (ctx->device,
+                                       QMI_DEVICE_SIGNAL_INDICATION,
+                                       G_CALLBACK (device_indication_cb),
+                                       ctx);
+    client_handlers = g_new (gulong, ctx->clients->len);
+    for (i = 0; i < ctx->clients->len; i++)
+        client_handlers[i] = g_signal_connect (g_ptr_array_index (ctx->clients, i),
+                                               "event-report",
+                                               G_CALLBACK (client_event_report_cb),
+                                               ctx);
+
+    timer = g_timer_new ();
+    modem_send_indications (ctx->modem, n_iterations, ctx->times);
+    g_main_loop_run (ctx->loop);
+
+    name = g_strdup_printf ("indication (%u clients)", ctx->clients->len);
+    report (name, ctx->samples, ctx->n_expected, g_timer_elapsed (timer, NULL));
+    g_free (name);
+
+    for (i = 0; i < ctx->clients->len; i++)
+        g_signal_handler_disconnect (g_ptr_array_index (ctx->clients, i), client_handlers[i]);
+    g_free (client_handlers);
+    g_signal_handler_disconnect (ctx->device, device_handler);
+
+    g_timer_destroy (timer);
+    g_clear_pointer (&ctx->times, g_free);
+    g_clear_pointer (&ctx->samples, g_array_unref);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    GError         *error = NULL;
+    GOptionContext *option_context;
+    Context         ctx = { 0 };
+
+    option_context = g_option_context_new ("- Benchmark libqmi-glib");
+    g_option_context_add_main_entries (option_context, main_entries, NULL);
+    if (!g_option_context_parse (option_context, &argc, &argv, &error)) {
+        g_printerr ("error: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+    g_option_context_free (option_context);
+
+    if (n_iterations <= 0) {
+        g_printerr ("error: invalid number of iterations: %d\n", n_iterations);
+        exit (EXIT_FAILURE);
+    }
+
+    g_print ("libqmi-glib %s benchmarks: %d iterations, %d clients, window %d\n\n",
+             PACKAGE_VERSION, n_iterations, MAX (1, n_clients), MAX (1, window));
+
+    bench_request_encode ();
+    bench_response_parse ();
+
+    context_setup (&ctx);
+    bench_transaction_latency (&ctx);
+    bench_transaction_throughput (&ctx);
+    bench_indication_fan_out (&ctx);
+    context_teardown (&ctx);
+
+    return EXIT_SUCCESS;
+}
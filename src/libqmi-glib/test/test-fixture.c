@@ -76,38 +76,8 @@ device_virtual_new_ready (GObject      *source,
 }
 
 void
-test_fixture_setup (TestFixture *fixture)
+test_fixture_open (TestFixture *fixture)
 {
-    GFile *file;
-    guint  i;
-    static guint32 num = 0;
-
-    g_debug ("[%lu,%p] fixture setup", (gulong) pthread_self (), g_main_context_get_thread_default ());
-
-    qmi_utils_set_traces_enabled (TRUE);
-
-    /* Create port name, and add process ID so that multiple runs of this test
-     * in the same system don't clash with each other */
-    fixture->path = g_strdup_printf ("/dev/qmi%08lu%04u", (gulong) getpid (), num++);
-    fixture->service_info[QMI_SERVICE_CTL].transaction_id = 0x0001;
-    fixture->ctx = test_port_context_new (fixture->path);
-    test_port_context_start (fixture->ctx);
-
-    /* Create device */
-    file = g_file_new_for_path (fixture->path);
-    g_async_initable_new_async (QMI_TYPE_DEVICE,
-                                G_PRIORITY_DEFAULT,
-                                NULL,
-                                (GAsyncReadyCallback) device_virtual_new_ready,
-                                fixture,
-                                QMI_DEVICE_FILE,          file,
-                                QMI_DEVICE_NO_FILE_CHECK, TRUE,
-                                QMI_DEVICE_PROXY_PATH,    fixture->path,
-                                NULL);
-    g_object_unref (file);
-    test_fixture_loop_run (fixture);
-
-    /* Open device */
     {
         guint8 expected[] = {
             0x01, /* marker */
@@ -157,6 +127,42 @@ test_fixture_setup (TestFixture *fixture)
                      (GAsyncReadyCallback) device_open_ready,
                      fixture);
     test_fixture_loop_run (fixture);
+}
+
+void
+test_fixture_setup (TestFixture *fixture)
+{
+    GFile *file;
+    guint  i;
+    static guint32 num = 0;
+
+    g_debug ("[%lu,%p] fixture setup", (gulong) pthread_self (), g_main_context_get_thread_default ());
+
+    qmi_utils_set_traces_enabled (TRUE);
+
+    /* Create port name, and add process ID so that multiple runs of this test
+     * in the same system don't clash with each other */
+    fixture->path = g_strdup_printf ("/dev/qmi%08lu%04u", (gulong) getpid (), num++);
+    fixture->service_info[QMI_SERVICE_CTL].transaction_id = 0x0001;
+    fixture->ctx = test_port_context_new (fixture->path);
+    test_port_context_start (fixture->ctx);
+
+    /* Create device */
+    file = g_file_new_for_path (fixture->path);
+    g_async_initable_new_async (QMI_TYPE_DEVICE,
+                                G_PRIORITY_DEFAULT,
+                                NULL,
+                                (GAsyncReadyCallback) device_virtual_new_ready,
+                                fixture,
+                                QMI_DEVICE_FILE,          file,
+                                QMI_DEVICE_NO_FILE_CHECK, TRUE,
+                                QMI_DEVICE_PROXY_PATH,    fixture->path,
+                                NULL);
+    g_object_unref (file);
+    test_fixture_loop_run (fixture);
+
+    /* Open device */
+    test_fixture_open (fixture);
 
     /* Allocate clients */
     for (i = 0; i < G_N_ELEMENTS (services); i++) {
@@ -14,9 +14,13 @@
  */
 
 #include <config.h>
+#include <string.h>
+#include <unistd.h>
 #include <libqmi-glib.h>
+#include <glib/gstdio.h>
 
 #include "test-fixture.h"
+#include "qmi-capture.h"
 
 /*****************************************************************************/
 
@@ -26,9 +30,283 @@ test_generated_core (TestFixture *fixture)
     /* Noop */
 }
 
+/*****************************************************************************/
+/* CID pool */
+
+static void
+cid_pool_expect_allocate (TestFixture *fixture,
+                          guint8       cid)
+{
+    guint8 expected[] = {
+        0x01,       /* marker */
+        /* QMUX */
+        0x0F, 0x00, /* length */
+        0x00,       /* flags */
+        0x00,       /* service CTL */
+        0x00,       /* client */
+        /* QMI header */
+        0x00,       /* flags */
+        0xFF,       /* transaction */
+        0x22, 0x00, /* message: Allocate CID */
+        0x04, 0x00, /* tlv length */
+        /* TLV */
+        0x01,       /* type */
+        0x01, 0x00, /* length */
+        0x02        /* service: DMS */
+    };
+    guint8 response[] = {
+        0x01,       /* marker */
+        /* QMUX */
+        0x17, 0x00, /* length */
+        0x00,       /* flags */
+        0x00,       /* service */
+        0x00,       /* client */
+        /* QMI header */
+        0x01,       /* flags: Response */
+        0xFF,       /* transaction */
+        0x22, 0x00, /* message */
+        0x0C, 0x00, /* tlv length */
+        /* TLV */
+        0x02,       /* type: Result */
+        0x04, 0x00, /* length */
+        0x00, 0x00, /* error status */
+        0x00, 0x00, /* error code */
+        /* TLV */
+        0x01,       /* type: Allocation info */
+        0x02, 0x00, /* length */
+        0x02,       /* service: DMS */
+        0xFF,       /* UPDATE: cid */
+    };
+
+    response[23] = cid;
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_CTL].transaction_id++);
+}
+
+static void
+cid_pool_expect_release (TestFixture *fixture,
+                         guint8       cid)
+{
+    guint8 expected[] = {
+        0x01,       /* marker */
+        /* QMUX */
+        0x10, 0x00, /* length */
+        0x00,       /* flags */
+        0x00,       /* service CTL */
+        0x00,       /* client */
+        /* QMI header */
+        0x00,       /* flags */
+        0xFF,       /* transaction */
+        0x23, 0x00, /* message: Release CID */
+        0x05, 0x00, /* tlv length: 5 bytes */
+        /* TLV */
+        0x01,       /* type */
+        0x02, 0x00, /* length */
+        0x02,       /* service: DMS */
+        0xFF        /* UPDATE: cid */
+    };
+    guint8 response[] = {
+        0x01,       /* marker */
+        /* QMUX */
+        0x17, 0x00, /* length */
+        0x00,       /* flags */
+        0x00,       /* service */
+        0x00,       /* client */
+        /* QMI header */
+        0x01,       /* flags: Response */
+        0xFF,       /* transaction */
+        0x23, 0x00, /* message */
+        0x0C, 0x00, /* tlv length */
+        /* TLV */
+        0x02,       /* type: Result*/
+        0x04, 0x00, /* length */
+        0x00, 0x00, /* error status */
+        0x00, 0x00, /* error code */
+        /* TLV */
+        0x01,       /* type: Allocation Info */
+        0x02, 0x00, /* length */
+        0x02,       /* service: DMS */
+        0xFF,       /* UPDATE: cid */
+    };
+
+    expected[16] = cid;
+    response[23] = cid;
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_CTL].transaction_id++);
+}
+
+static guint64
+cid_pool_get_ctl_responses (TestFixture *fixture,
+                            guint16      message_id)
+{
+    GArray  *array;
+    guint64  responses = 0;
+    guint    i;
+
+    array = qmi_device_get_stats (fixture->device, NULL);
+    for (i = 0; i < array->len; i++) {
+        QmiDeviceMessageStats *stats = &g_array_index (array, QmiDeviceMessageStats, i);
+
+        if (stats->service == QMI_SERVICE_CTL && stats->message_id == message_id)
+            responses = stats->responses;
+    }
+    g_array_unref (array);
+    return responses;
+}
+
+static void
+cid_pool_wait_size (TestFixture *fixture,
+                    guint        size)
+{
+    while (qmi_device_get_cid_pool_size (fixture->device, QMI_SERVICE_DMS) != size)
+        g_main_context_iteration (NULL, TRUE);
+}
+
+static void
+cid_pool_allocate_client_ready (QmiDevice    *device,
+                                GAsyncResult *res,
+                                QmiClient   **client)
+{
+    GError *error = NULL;
+
+    *client = qmi_device_allocate_client_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (QMI_IS_CLIENT (*client));
+}
+
+static void
+cid_pool_release_client_ready (QmiDevice    *device,
+                               GAsyncResult *res,
+                               gboolean     *released)
+{
+    GError *error = NULL;
+
+    *released = qmi_device_release_client_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (*released);
+}
+
+static void
+cid_pool_close_ready (QmiDevice    *device,
+                      GAsyncResult *res,
+                      gboolean     *closed)
+{
+    GError *error = NULL;
+
+    *closed = qmi_device_close_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (*closed);
+}
+
+static void
+test_generated_core_cid_pool (TestFixture *fixture)
+{
+    QmiClient *client = NULL;
+    gboolean   released = FALSE;
+    gboolean   closed = FALSE;
+    guint64    n_releases;
+
+    /* Filled right away */
+    cid_pool_expect_allocate (fixture, 2);
+    qmi_device_set_cid_pool (fixture->device, QMI_SERVICE_DMS, 1, 1);
+    cid_pool_wait_size (fixture, 1);
+
+    /* The client gets the pooled CID, and the pool is refilled */
+    cid_pool_expect_allocate (fixture, 3);
+    qmi_device_allocate_client (fixture->device, QMI_SERVICE_DMS, QMI_CID_NONE, 10, NULL,
+                                (GAsyncReadyCallback) cid_pool_allocate_client_ready,
+                                &client);
+    while (!client)
+        g_main_context_iteration (NULL, TRUE);
+    g_assert_cmpuint (qmi_client_get_cid (client), ==, 2);
+    cid_pool_wait_size (fixture, 1);
+
+    /* With room in the pool, the CID isn't released */
+    qmi_device_set_cid_pool (fixture->device, QMI_SERVICE_DMS, 1, 2);
+    qmi_device_release_client (fixture->device, client, QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID, 10, NULL,
+                               (GAsyncReadyCallback) cid_pool_release_client_ready,
+                               &released);
+    while (!released)
+        g_main_context_iteration (NULL, TRUE);
+    g_clear_object (&client);
+    g_assert_cmpuint (qmi_device_get_cid_pool_size (fixture->device, QMI_SERVICE_DMS), ==, 2);
+
+    /* Shrinking the pool releases the last CID returned */
+    n_releases = cid_pool_get_ctl_responses (fixture, 0x0023);
+    cid_pool_expect_release (fixture, 2);
+    qmi_device_set_cid_pool (fixture->device, QMI_SERVICE_DMS, 1, 1);
+    g_assert_cmpuint (qmi_device_get_cid_pool_size (fixture->device, QMI_SERVICE_DMS), ==, 1);
+    while (cid_pool_get_ctl_responses (fixture, 0x0023) == n_releases)
+        g_main_context_iteration (NULL, TRUE);
+
+    /* And disabling it releases all of them */
+    cid_pool_expect_release (fixture, 3);
+    qmi_device_set_cid_pool (fixture->device, QMI_SERVICE_DMS, 0, 0);
+    g_assert_cmpuint (qmi_device_get_cid_pool_size (fixture->device, QMI_SERVICE_DMS), ==, 0);
+    while (cid_pool_get_ctl_responses (fixture, 0x0023) == n_releases + 1)
+        g_main_context_iteration (NULL, TRUE);
+
+    /* Closing the device releases the pooled CIDs; no low watermark, so that
+     * the pool isn't refilled once open again */
+    cid_pool_expect_allocate (fixture, 4);
+    qmi_device_set_cid_pool (fixture->device, QMI_SERVICE_DMS, 1, 1);
+    cid_pool_wait_size (fixture, 1);
+    qmi_device_set_cid_pool (fixture->device, QMI_SERVICE_DMS, 0, 1);
+
+    cid_pool_expect_release (fixture, 4);
+    qmi_device_close_async (fixture->device, 10, NULL,
+                            (GAsyncReadyCallback) cid_pool_close_ready,
+                            &closed);
+    while (!closed)
+        g_main_context_iteration (NULL, TRUE);
+    g_assert (!qmi_device_is_open (fixture->device));
+    g_assert_cmpuint (qmi_device_get_cid_pool_size (fixture->device, QMI_SERVICE_DMS), ==, 0);
+
+    /* Once reopened, the client gets a new CID instead of the stale one */
+    test_fixture_open (fixture);
+    cid_pool_expect_allocate (fixture, 5);
+    qmi_device_allocate_client (fixture->device, QMI_SERVICE_DMS, QMI_CID_NONE, 10, NULL,
+                                (GAsyncReadyCallback) cid_pool_allocate_client_ready,
+                                &client);
+    while (!client)
+        g_main_context_iteration (NULL, TRUE);
+    g_assert_cmpuint (qmi_client_get_cid (client), ==, 5);
+
+    /* Back in the pool, and released when disabling it */
+    released = FALSE;
+    qmi_device_release_client (fixture->device, client, QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID, 10, NULL,
+                               (GAsyncReadyCallback) cid_pool_release_client_ready,
+                               &released);
+    while (!released)
+        g_main_context_iteration (NULL, TRUE);
+    g_clear_object (&client);
+    g_assert_cmpuint (qmi_device_get_cid_pool_size (fixture->device, QMI_SERVICE_DMS), ==, 1);
+
+    n_releases = cid_pool_get_ctl_responses (fixture, 0x0023);
+    cid_pool_expect_release (fixture, 5);
+    qmi_device_set_cid_pool (fixture->device, QMI_SERVICE_DMS, 0, 0);
+    while (cid_pool_get_ctl_responses (fixture, 0x0023) == n_releases)
+        g_main_context_iteration (NULL, TRUE);
+}
+
 /*****************************************************************************/
 /* DMS Get IDs */
 
+static gpointer
+dms_get_ids_imei_thread (QmiMessageDmsGetIdsOutput *output)
+{
+    const gchar *str = NULL;
+    gboolean st;
+
+    st = qmi_message_dms_get_ids_output_get_imei (output, &str, NULL);
+    g_assert (st);
+    return (gpointer) str;
+}
+
 static void
 dms_get_ids_ready (QmiClientDms *client,
                    GAsyncResult *res,
@@ -38,6 +316,10 @@ dms_get_ids_ready (QmiClientDms *client,
     GError *error = NULL;
     gboolean st;
     const gchar *str;
+    const gchar *other_str;
+    gsize str_length;
+    GThread *threads[4];
+    guint i;
 
     output = qmi_client_dms_get_ids_finish (client, res, &error);
     g_assert_no_error (error);
@@ -51,14 +333,32 @@ dms_get_ids_ready (QmiClientDms *client,
      * 	 ESN: '80997874'
      * 	IMEI: '359225050039973'
      * 	MEID: '35922505003997' */
+    st = qmi_message_dms_get_ids_output_peek_esn (output, &str, &str_length, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert_cmpuint (str_length, ==, 8);
+    g_assert (memcmp (str, "80997874", str_length) == 0);
+
     st = qmi_message_dms_get_ids_output_get_esn (output, &str, &error);
     g_assert_no_error (error);
     g_assert (st);
     g_assert_cmpstr (str, ==, "80997874");
 
-    st = qmi_message_dms_get_ids_output_get_imei (output, &str, &error);
+    /* Fields are decoded once, even when built with lazy outputs */
+    st = qmi_message_dms_get_ids_output_get_esn (output, &other_str, &error);
     g_assert_no_error (error);
     g_assert (st);
+    g_assert (other_str == str);
+
+    /* And also when requested from several threads at the same time */
+    for (i = 0; i < G_N_ELEMENTS (threads); i++)
+        threads[i] = g_thread_new ("get-imei", (GThreadFunc) dms_get_ids_imei_thread, output);
+    for (i = 0; i < G_N_ELEMENTS (threads); i++) {
+        other_str = g_thread_join (threads[i]);
+        if (i == 0)
+            str = other_str;
+        g_assert (other_str == str);
+    }
     g_assert_cmpstr (str, ==, "359225050039973");
 
     st = qmi_message_dms_get_ids_output_get_meid (output, &str, &error);
@@ -103,6 +403,119 @@ test_generated_dms_get_ids (TestFixture *fixture)
     test_fixture_loop_run (fixture);
 }
 
+static void
+test_generated_dms_get_ids_unordered (TestFixture *fixture)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0xFF, 0xFF, 0x25, 0x00, 0x00, 0x00
+    };
+    /* Same contents as above, but with the Result TLV last, an unknown 0x30
+     * TLV in the middle and a second ESN TLV which must be ignored */
+    guint8 response[] = {
+        0x01,
+        0x51, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x25, 0x00, 0x45, 0x00, 0x10,
+        0x08, 0x00, 0x38, 0x30, 0x39, 0x39, 0x37, 0x38,
+        0x37, 0x34, 0x30, 0x02, 0x00, 0xAA, 0xBB, 0x12,
+        0x0E, 0x00, 0x33, 0x35, 0x39, 0x32, 0x32, 0x35,
+        0x30, 0x35, 0x30, 0x30, 0x33, 0x39, 0x39, 0x37,
+        0x11, 0x0F, 0x00, 0x33, 0x35, 0x39, 0x32, 0x32,
+        0x35, 0x30, 0x35, 0x30, 0x30, 0x33, 0x39, 0x39,
+        0x37, 0x33, 0x10, 0x08, 0x00, 0x30, 0x30, 0x30,
+        0x30, 0x30, 0x30, 0x30, 0x30, 0x02, 0x04, 0x00,
+        0x00, 0x00, 0x00, 0x00
+    };
+
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response, G_N_ELEMENTS (response),
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                            (GAsyncReadyCallback) dms_get_ids_ready,
+                            fixture);
+    test_fixture_loop_run (fixture);
+}
+
+static void
+test_generated_dms_get_ids_pooled (TestFixture *fixture)
+{
+    guint64 hits = 0;
+    guint64 misses = 0;
+
+    g_assert (!qmi_device_get_message_pool_stats (fixture->device, NULL, NULL));
+    g_object_set (fixture->device, QMI_DEVICE_MESSAGE_POOL, TRUE, NULL);
+
+    /* Each operation needs a request and a response; once the first one is
+     * finished, their buffers are available for the next one */
+    test_generated_dms_get_ids (fixture);
+    test_generated_dms_get_ids (fixture);
+
+    g_assert (qmi_device_get_message_pool_stats (fixture->device, &hits, &misses));
+    g_assert_cmpuint (hits + misses, ==, 4);
+    g_assert_cmpuint (hits, >=, 1);
+
+    g_object_set (fixture->device, QMI_DEVICE_MESSAGE_POOL, FALSE, NULL);
+}
+
+static void
+test_generated_dms_get_ids_captured (TestFixture *fixture)
+{
+    QmiCaptureReader *reader;
+    QmiCaptureRecord  record;
+    GError           *error = NULL;
+    gchar            *path;
+    gint              fd;
+    gboolean          st;
+
+    fd = g_file_open_tmp ("test-generated-capture-XXXXXX", &path, &error);
+    g_assert_no_error (error);
+    close (fd);
+
+    st = qmi_device_start_capture (fixture->device, path, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+
+    test_generated_dms_get_ids (fixture);
+
+    st = qmi_device_stop_capture (fixture->device, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+
+    reader = __qmi_capture_reader_new (path, &error);
+    g_assert_no_error (error);
+    g_assert (reader);
+    g_assert_cmpstr (__qmi_capture_reader_get_device (reader), ==, qmi_device_get_path (fixture->device));
+
+    /* Request */
+    st = __qmi_capture_reader_next (reader, &record, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert_cmpuint (record.direction, ==, QMI_CAPTURE_DIRECTION_OUT);
+    g_assert_cmpuint (record.vendor_id, ==, QMI_MESSAGE_VENDOR_GENERIC);
+    g_assert_cmpuint (record.frame_len, ==, 13);
+    g_assert_cmpuint (record.frame[0], ==, 0x01);
+    g_assert_cmpuint (record.frame[4], ==, QMI_SERVICE_DMS);
+
+    /* Response */
+    st = __qmi_capture_reader_next (reader, &record, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert_cmpuint (record.direction, ==, QMI_CAPTURE_DIRECTION_IN);
+    g_assert_cmpuint (record.frame_len, ==, 70);
+    g_assert_cmpuint (record.frame[3], ==, 0x80);
+
+    st = __qmi_capture_reader_next (reader, &record, &error);
+    g_assert_no_error (error);
+    g_assert (!st);
+
+    __qmi_capture_reader_free (reader);
+    g_unlink (path);
+    g_free (path);
+}
+
 /*****************************************************************************/
 /* DMS UIM Get PIN Status */
 
@@ -643,6 +1056,149 @@ test_generated_nas_get_cell_location_info (TestFixture *fixture)
     test_fixture_loop_run (fixture);
 }
 
+/*****************************************************************************/
+/* WDS Packet Service Status indication */
+
+typedef struct {
+    TestFixture *fixture;
+    gboolean     response_received;
+    guint        n_indications;
+} PacketServiceStatusContext;
+
+static void
+packet_service_status_context_check_done (PacketServiceStatusContext *ctx)
+{
+    if (ctx->response_received && ctx->n_indications > 0)
+        test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+wds_get_packet_service_status_ready (QmiClientWds               *client,
+                                     GAsyncResult               *res,
+                                     PacketServiceStatusContext *ctx)
+{
+    QmiMessageWdsGetPacketServiceStatusOutput *output;
+    GError *error = NULL;
+    gboolean st;
+    QmiWdsConnectionStatus status;
+
+    output = qmi_client_wds_get_packet_service_status_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+
+    st = qmi_message_wds_get_packet_service_status_output_get_result (output, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+
+    st = qmi_message_wds_get_packet_service_status_output_get_connection_status (output, &status, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert_cmpuint (status, ==, QMI_WDS_CONNECTION_STATUS_DISCONNECTED);
+
+    qmi_message_wds_get_packet_service_status_output_unref (output);
+
+    ctx->response_received = TRUE;
+    packet_service_status_context_check_done (ctx);
+}
+
+static void
+wds_packet_service_status_indication_cb (QmiClientWds                              *client,
+                                         QmiIndicationWdsPacketServiceStatusOutput *output,
+                                         PacketServiceStatusContext                *ctx)
+{
+    GError *error = NULL;
+    gboolean st;
+    QmiWdsConnectionStatus status;
+    gboolean reconfiguration_required;
+
+    st = qmi_indication_wds_packet_service_status_output_get_connection_status (output, &status, &reconfiguration_required, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    g_assert_cmpuint (status, ==, QMI_WDS_CONNECTION_STATUS_CONNECTED);
+    g_assert (!reconfiguration_required);
+
+    ctx->n_indications++;
+    packet_service_status_context_check_done (ctx);
+}
+
+static void
+wds_get_packet_service_status_with_indication (PacketServiceStatusContext *ctx,
+                                               const guint8               *indication,
+                                               gsize                       indication_size)
+{
+    TestFixture *fixture = ctx->fixture;
+    GByteArray  *response;
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x01, 0x01,
+        0x00, 0xFF, 0xFF, 0x22, 0x00, 0x00, 0x00
+    };
+    guint8 response_only[] = {
+        0x01,
+        0x17, 0x00, 0x80, 0x01, 0x01,
+        0x02, 0xFF, 0xFF, 0x22, 0x00, 0x0B, 0x00,
+        0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x01, 0x01, 0x00, 0x01
+    };
+
+    /* The indication is sent by the port right after the response */
+    response = g_byte_array_sized_new (sizeof (response_only) + indication_size);
+    g_byte_array_append (response, response_only, sizeof (response_only));
+    g_byte_array_append (response, indication, indication_size);
+
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   response->data, response->len,
+                                   fixture->service_info[QMI_SERVICE_WDS].transaction_id++);
+    g_byte_array_unref (response);
+
+    ctx->response_received = FALSE;
+    qmi_client_wds_get_packet_service_status (QMI_CLIENT_WDS (fixture->service_info[QMI_SERVICE_WDS].client), NULL, 3, NULL,
+                                              (GAsyncReadyCallback) wds_get_packet_service_status_ready,
+                                              ctx);
+}
+
+static void
+test_generated_wds_packet_service_status_indication (TestFixture *fixture)
+{
+    PacketServiceStatusContext ctx = { fixture, FALSE, 0 };
+    gulong handler_id;
+    /* The Connection Status TLV has one byte too many; if it were parsed, the
+     * 'bytes unread' warning would abort the test */
+    guint8 unparseable[] = {
+        0x01,
+        0x12, 0x00, 0x80, 0x01, 0x01,
+        0x04, 0x00, 0x00, 0x22, 0x00, 0x06, 0x00,
+        0x01, 0x03, 0x00, 0x02, 0x00, 0x00
+    };
+    guint8 indication[] = {
+        0x01,
+        0x11, 0x00, 0x80, 0x01, 0x01,
+        0x04, 0x00, 0x00, 0x22, 0x00, 0x05, 0x00,
+        0x01, 0x02, 0x00, 0x02, 0x00
+    };
+
+    /* Nobody listening: the indication is dropped without being parsed */
+    ctx.n_indications = 1;
+    wds_get_packet_service_status_with_indication (&ctx, unparseable, sizeof (unparseable));
+    test_fixture_loop_run (fixture);
+
+    /* Both frames were read at once, so the pending indication dispatch
+     * is already scheduled; let it run */
+    while (g_main_context_iteration (NULL, FALSE));
+
+    /* A connected handler gets the parsed indication */
+    ctx.n_indications = 0;
+    handler_id = g_signal_connect (fixture->service_info[QMI_SERVICE_WDS].client,
+                                   "packet-service-status",
+                                   G_CALLBACK (wds_packet_service_status_indication_cb),
+                                   &ctx);
+    wds_get_packet_service_status_with_indication (&ctx, indication, sizeof (indication));
+    test_fixture_loop_run (fixture);
+    g_assert_cmpuint (ctx.n_indications, ==, 1);
+
+    g_signal_handler_disconnect (fixture->service_info[QMI_SERVICE_WDS].client, handler_id);
+}
 
 /*****************************************************************************/
 
@@ -653,8 +1209,14 @@ int main (int argc, char **argv)
     /* Test the setup/teardown test methods */
     TEST_ADD ("/libqmi-glib/generated/core", test_generated_core);
 
+    /* Pre-allocated CIDs */
+    TEST_ADD ("/libqmi-glib/generated/core/cid-pool", test_generated_core_cid_pool);
+
     /* DMS */
     TEST_ADD ("/libqmi-glib/generated/dms/get-ids",                test_generated_dms_get_ids);
+    TEST_ADD ("/libqmi-glib/generated/dms/get-ids-unordered",      test_generated_dms_get_ids_unordered);
+    TEST_ADD ("/libqmi-glib/generated/dms/get-ids-pooled",         test_generated_dms_get_ids_pooled);
+    TEST_ADD ("/libqmi-glib/generated/dms/get-ids-captured",       test_generated_dms_get_ids_captured);
     TEST_ADD ("/libqmi-glib/generated/dms/uim-get-pin-status",     test_generated_dms_uim_get_pin_status);
     TEST_ADD ("/libqmi-glib/generated/dms/uim-verify-pin",         test_generated_dms_uim_verify_pin);
     TEST_ADD ("/libqmi-glib/generated/dms/get-time",               test_generated_dms_get_time);
@@ -662,5 +1224,7 @@ int main (int argc, char **argv)
     TEST_ADD ("/libqmi-glib/generated/nas/network-scan",           test_generated_nas_network_scan);
     TEST_ADD ("/libqmi-glib/generated/nas/get-cell-location-info", test_generated_nas_get_cell_location_info);
 
+    TEST_ADD ("/libqmi-glib/generated/wds/packet-service-status-indication", test_generated_wds_packet_service_status_indication);
+
     return g_test_run ();
 }
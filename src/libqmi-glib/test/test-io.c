@@ -0,0 +1,363 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <gio/gio.h>
+#include <libqmi-glib.h>
+
+#include "qmi-io.h"
+
+#define SERVICE_FLAG_RESPONSE   0x02
+#define SERVICE_FLAG_INDICATION 0x04
+
+/*****************************************************************************/
+
+static QmiMessage *
+message_new (guint8  flags,
+             guint16 transaction_id)
+{
+    guint8 raw[] = {
+        0x01,       /* marker */
+        /* QMUX */
+        0x0C, 0x00, /* length */
+        0x80,       /* flags: service */
+        0x02,       /* service: DMS */
+        0x01,       /* client */
+        /* QMI header */
+        0xFF,       /* UPDATE: flags */
+        0xFF, 0xFF, /* UPDATE: transaction */
+        0x01, 0x00, /* message: Event Report */
+        0x00, 0x00  /* tlv length */
+    };
+    GByteArray *buffer;
+    QmiMessage *message;
+    GError     *error = NULL;
+
+    raw[6] = flags;
+    raw[7] = transaction_id & 0xFF;
+    raw[8] = transaction_id >> 8;
+
+    buffer = g_byte_array_append (g_byte_array_new (), raw, sizeof (raw));
+    message = qmi_message_new_from_raw (buffer, &error);
+    g_assert_no_error (error);
+    g_assert (message);
+    g_assert_cmpuint (buffer->len, ==, 0);
+    g_byte_array_unref (buffer);
+    return message;
+}
+
+static void
+socket_pair_new (GSocket **writer,
+                 GSocket **reader)
+{
+    GError *error = NULL;
+    gint    fds[2];
+
+    g_assert_cmpint (socketpair (AF_UNIX, SOCK_STREAM, 0, fds), ==, 0);
+
+    *writer = g_socket_new_from_fd (fds[0], &error);
+    g_assert_no_error (error);
+    *reader = g_socket_new_from_fd (fds[1], &error);
+    g_assert_no_error (error);
+}
+
+/* Reads exactly @len bytes */
+static guint8 *
+socket_read (GSocket *reader,
+             gsize    len)
+{
+    guint8 *buffer;
+    gsize   received = 0;
+
+    buffer = g_malloc (len);
+    while (received < len) {
+        GError *error = NULL;
+        gssize  r;
+
+        r = g_socket_receive (reader, (gchar *)(buffer + received), len - received, NULL, &error);
+        g_assert_no_error (error);
+        g_assert_cmpint (r, >, 0);
+        received += r;
+    }
+
+    return buffer;
+}
+
+/* Checks that @messages were written to @reader, in order */
+static void
+check_written (GSocket     *reader,
+               QmiMessage **messages,
+               guint        n_messages)
+{
+    guint i;
+
+    for (i = 0; i < n_messages; i++) {
+        const guint8 *raw;
+        gsize         raw_len;
+        guint8       *received;
+
+        raw = qmi_message_get_raw (messages[i], &raw_len, NULL);
+        received = socket_read (reader, raw_len);
+        g_assert (memcmp (received, raw, raw_len) == 0);
+        g_free (received);
+    }
+}
+
+/*****************************************************************************/
+
+static void
+test_io_output_queue_write (void)
+{
+    QmiIoOutputQueue  queue;
+    QmiMessage       *messages[3];
+    GSocket          *writer;
+    GSocket          *reader;
+    GError           *error = NULL;
+    gsize             total = 0;
+    guint             i;
+
+    socket_pair_new (&writer, &reader);
+    __qmi_io_output_queue_init (&queue);
+
+    for (i = 0; i < G_N_ELEMENTS (messages); i++) {
+        messages[i] = message_new (SERVICE_FLAG_RESPONSE, i + 1);
+        total += qmi_message_get_length (messages[i]);
+        g_assert (__qmi_io_output_queue_push (&queue, messages[i], 0, FALSE, &error));
+        g_assert_no_error (error);
+    }
+    g_assert_cmpuint (queue.depth_max, ==, 3);
+
+    /* All of them in a single write */
+    g_assert_cmpint (__qmi_io_output_queue_write (&queue, writer, &error), ==, (gssize)total);
+    g_assert_no_error (error);
+    g_assert (g_queue_is_empty (&queue.messages));
+    g_assert_cmpuint (queue.head_written, ==, 0);
+
+    check_written (reader, messages, G_N_ELEMENTS (messages));
+
+    for (i = 0; i < G_N_ELEMENTS (messages); i++)
+        qmi_message_unref (messages[i]);
+    __qmi_io_output_queue_clear (&queue);
+    g_object_unref (writer);
+    g_object_unref (reader);
+}
+
+static void
+test_io_output_queue_would_block (void)
+{
+    QmiIoOutputQueue  queue;
+    QmiMessage       *messages[20];
+    GSocket          *writer;
+    GSocket          *reader;
+    GError           *error = NULL;
+    guint8            junk[1024];
+    gsize             n_junk = 0;
+    gssize            written;
+    guint             i;
+
+    socket_pair_new (&writer, &reader);
+    __qmi_io_output_queue_init (&queue);
+
+    /* Fill the socket */
+    memset (junk, 0xAA, sizeof (junk));
+    g_socket_set_blocking (writer, FALSE);
+    while ((written = g_socket_send (writer, (const gchar *)junk, sizeof (junk), NULL, &error)) > 0)
+        n_junk += written;
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK);
+    g_clear_error (&error);
+
+    /* Nothing (or just a part of the first one) is written, and the messages
+     * stay queued */
+    for (i = 0; i < G_N_ELEMENTS (messages); i++) {
+        messages[i] = message_new (SERVICE_FLAG_INDICATION, 0);
+        g_assert (__qmi_io_output_queue_push (&queue, messages[i], 0, FALSE, &error));
+    }
+    g_assert_cmpint (__qmi_io_output_queue_write (&queue, writer, &error), >=, 0);
+    g_assert_no_error (error);
+    g_assert (!g_queue_is_empty (&queue.messages));
+
+    /* Once there is room again, the remaining data is written without
+     * breaking the framing */
+    while (n_junk > 0) {
+        gsize   chunk;
+        guint8 *received;
+
+        chunk = MIN (n_junk, sizeof (junk));
+        received = socket_read (reader, chunk);
+        g_assert (memcmp (received, junk, chunk) == 0);
+        g_free (received);
+        n_junk -= chunk;
+    }
+    g_assert_cmpint (__qmi_io_output_queue_write (&queue, writer, &error), >=, 0);
+    g_assert_no_error (error);
+    g_assert (g_queue_is_empty (&queue.messages));
+
+    check_written (reader, messages, G_N_ELEMENTS (messages));
+
+    for (i = 0; i < G_N_ELEMENTS (messages); i++)
+        qmi_message_unref (messages[i]);
+    __qmi_io_output_queue_clear (&queue);
+    g_object_unref (writer);
+    g_object_unref (reader);
+}
+
+static void
+test_io_output_queue_drop (void)
+{
+    QmiIoOutputQueue  queue;
+    QmiMessage       *indications[3];
+    QmiMessage       *response;
+    QmiMessage       *expected[3];
+    GSocket          *writer;
+    GSocket          *reader;
+    GError           *error = NULL;
+    guint             i;
+
+    socket_pair_new (&writer, &reader);
+    __qmi_io_output_queue_init (&queue);
+
+    for (i = 0; i < G_N_ELEMENTS (indications); i++)
+        indications[i] = message_new (SERVICE_FLAG_INDICATION, 0);
+    response = message_new (SERVICE_FLAG_RESPONSE, 1);
+
+    /* Indications over the limit are dropped */
+    for (i = 0; i < G_N_ELEMENTS (indications); i++) {
+        g_assert (__qmi_io_output_queue_push (&queue, indications[i], 2, FALSE, &error));
+        g_assert_no_error (error);
+    }
+    g_assert_cmpuint (g_queue_get_length (&queue.messages), ==, 2);
+    g_assert_cmpuint (queue.dropped, ==, 1);
+
+    /* But responses are always queued */
+    g_assert (__qmi_io_output_queue_push (&queue, response, 2, FALSE, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (g_queue_get_length (&queue.messages), ==, 3);
+    g_assert_cmpuint (queue.dropped, ==, 1);
+    g_assert_cmpuint (queue.depth_max, ==, 3);
+
+    g_assert_cmpint (__qmi_io_output_queue_write (&queue, writer, &error), >, 0);
+    g_assert_no_error (error);
+    g_assert (g_queue_is_empty (&queue.messages));
+
+    expected[0] = indications[0];
+    expected[1] = indications[1];
+    expected[2] = response;
+    check_written (reader, expected, G_N_ELEMENTS (expected));
+
+    /* With room again, indications are queued */
+    g_assert (__qmi_io_output_queue_push (&queue, indications[2], 2, FALSE, &error));
+    g_assert_cmpuint (g_queue_get_length (&queue.messages), ==, 1);
+    g_assert_cmpuint (queue.dropped, ==, 1);
+
+    for (i = 0; i < G_N_ELEMENTS (indications); i++)
+        qmi_message_unref (indications[i]);
+    qmi_message_unref (response);
+    __qmi_io_output_queue_clear (&queue);
+    g_assert (g_queue_is_empty (&queue.messages));
+    g_object_unref (writer);
+    g_object_unref (reader);
+}
+
+static void
+test_io_output_queue_disconnect (void)
+{
+    QmiIoOutputQueue  queue;
+    QmiMessage       *indication;
+    QmiMessage       *response;
+    GError           *error = NULL;
+
+    __qmi_io_output_queue_init (&queue);
+
+    indication = message_new (SERVICE_FLAG_INDICATION, 0);
+    response = message_new (SERVICE_FLAG_RESPONSE, 1);
+
+    g_assert (__qmi_io_output_queue_push (&queue, indication, 2, TRUE, &error));
+    g_assert (__qmi_io_output_queue_push (&queue, indication, 2, TRUE, &error));
+    g_assert_no_error (error);
+
+    /* Once full, neither indications nor responses are queued: the peer must
+     * be disconnected */
+    g_assert (!__qmi_io_output_queue_push (&queue, indication, 2, TRUE, &error));
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE);
+    g_clear_error (&error);
+
+    g_assert (!__qmi_io_output_queue_push (&queue, response, 2, TRUE, &error));
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE);
+    g_clear_error (&error);
+
+    g_assert_cmpuint (g_queue_get_length (&queue.messages), ==, 2);
+    g_assert_cmpuint (queue.dropped, ==, 0);
+
+    qmi_message_unref (indication);
+    qmi_message_unref (response);
+    __qmi_io_output_queue_clear (&queue);
+}
+
+static void
+test_io_receive_buffer (void)
+{
+    QmiIoReceiveBuffer  buffer = { 0 };
+    guint8             *data;
+
+    data = __qmi_io_receive_buffer_reserve (&buffer, 4);
+    g_assert (data);
+    g_assert_cmpuint (buffer.size, >=, 4);
+    memcpy (data, "abcd", 4);
+    __qmi_io_receive_buffer_commit (&buffer, 4);
+
+    /* Consumed in place */
+    __qmi_io_receive_buffer_consume (&buffer, 2);
+    g_assert_cmpuint (buffer.start, ==, 2);
+    g_assert_cmpuint (buffer.end, ==, 4);
+
+    /* The pending data is moved back to the beginning when more room is
+     * needed, and the buffer grows if still not enough */
+    data = __qmi_io_receive_buffer_reserve (&buffer, 8);
+    g_assert_cmpuint (buffer.start, ==, 0);
+    g_assert_cmpuint (buffer.end, ==, 2);
+    g_assert_cmpuint (buffer.size, >=, 10);
+    g_assert (data == buffer.data + 2);
+    g_assert (memcmp (buffer.data, "cd", 2) == 0);
+
+    __qmi_io_receive_buffer_append (&buffer, (const guint8 *)"efgh", 4);
+    g_assert (memcmp (buffer.data, "cdefgh", 6) == 0);
+
+    /* Rewound once everything is consumed */
+    __qmi_io_receive_buffer_consume (&buffer, 6);
+    g_assert_cmpuint (buffer.start, ==, 0);
+    g_assert_cmpuint (buffer.end, ==, 0);
+
+    __qmi_io_receive_buffer_clear (&buffer);
+    g_assert (!buffer.data);
+    g_assert_cmpuint (buffer.size, ==, 0);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/libqmi-glib/io/output-queue/write",       test_io_output_queue_write);
+    g_test_add_func ("/libqmi-glib/io/output-queue/would-block", test_io_output_queue_would_block);
+    g_test_add_func ("/libqmi-glib/io/output-queue/drop",        test_io_output_queue_drop);
+    g_test_add_func ("/libqmi-glib/io/output-queue/disconnect",  test_io_output_queue_disconnect);
+    g_test_add_func ("/libqmi-glib/io/receive-buffer",           test_io_receive_buffer);
+
+    return g_test_run ();
+}
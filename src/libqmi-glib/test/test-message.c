@@ -272,6 +272,115 @@ test_message_new_request (void)
     qmi_message_unref (self);
 }
 
+/* Emulates a request with many TLVs, like WDS Start Network */
+#define N_SIZED_TLVS 15
+#define SIZED_TLVS_SIZE (N_SIZED_TLVS * (3 + 1 + 4))
+
+static guint
+write_sized_tlvs (QmiMessage *self)
+{
+    GError   *error = NULL;
+    gboolean  ret;
+    gsize     init_offset;
+    guint8   *data;
+    guint     n_moves = 0;
+    guint     i;
+
+    data = self->data;
+    for (i = 0; i < N_SIZED_TLVS; i++) {
+        init_offset = qmi_message_tlv_write_init (self, (guint8)(0x10 + i), &error);
+        g_assert_no_error (error);
+        g_assert (init_offset > 0);
+        ret = qmi_message_tlv_write_string (self, 1, "abcd", -1, &error);
+        g_assert_no_error (error);
+        g_assert (ret);
+        ret = qmi_message_tlv_write_complete (self, init_offset, &error);
+        g_assert_no_error (error);
+        g_assert (ret);
+
+        /* Count how many times the buffer had to be moved around */
+        if (self->data != data) {
+            data = self->data;
+            n_moves++;
+        }
+    }
+
+    return n_moves;
+}
+
+static void
+test_message_new_sized (void)
+{
+    QmiMessage *self;
+    QmiMessage *other;
+
+    /* The hint doesn't change the message contents */
+    self = qmi_message_new (QMI_SERVICE_WDS, 0x01, 0x02, 0x0020);
+    other = qmi_message_new_sized (QMI_SERVICE_WDS, 0x01, 0x02, 0x0020, SIZED_TLVS_SIZE);
+    g_assert (self);
+    g_assert (other);
+    _g_assert_cmpmem (self->data, self->len, other->data, other->len);
+
+    /* With an exact hint, the buffer is never reallocated */
+    write_sized_tlvs (self);
+    g_assert_cmpuint (write_sized_tlvs (other), ==, 0);
+    _g_assert_cmpmem (self->data, self->len, other->data, other->len);
+    qmi_message_unref (self);
+    qmi_message_unref (other);
+
+    /* A too small hint is not an error */
+    self = qmi_message_new_sized (QMI_SERVICE_WDS, 0x01, 0x02, 0x0020, 1);
+    write_sized_tlvs (self);
+    g_assert_cmpuint (qmi_message_get_length (self), ==, 13 + SIZED_TLVS_SIZE);
+    qmi_message_unref (self);
+}
+
+static void
+test_message_new_sized_perf (void)
+{
+    QmiMessage *self;
+    GTimer     *timer;
+    gdouble     unsized_time;
+    gdouble     sized_time;
+    guint       unsized_moves = 0;
+    guint       sized_moves = 0;
+    guint       n_iterations = 100000;
+    guint       i;
+
+    if (!g_test_perf ())
+        return;
+
+    timer = g_timer_new ();
+
+    g_timer_start (timer);
+    for (i = 0; i < n_iterations; i++) {
+        self = qmi_message_new (QMI_SERVICE_WDS, 0x01, 0x02, 0x0020);
+        unsized_moves += write_sized_tlvs (self);
+        qmi_message_unref (self);
+    }
+    unsized_time = g_timer_elapsed (timer, NULL);
+
+    g_timer_start (timer);
+    for (i = 0; i < n_iterations; i++) {
+        self = qmi_message_new_sized (QMI_SERVICE_WDS, 0x01, 0x02, 0x0020, SIZED_TLVS_SIZE);
+        sized_moves += write_sized_tlvs (self);
+        qmi_message_unref (self);
+    }
+    sized_time = g_timer_elapsed (timer, NULL);
+
+    /* Buffer moves are a lower bound of the reallocations done, as realloc()
+     * may grow the buffer in place */
+    g_test_message ("Requests with %u TLVs (%u iterations): "
+                    "unsized %.3fs (%.2f buffer moves per request), "
+                    "sized %.3fs (%.2f buffer moves per request)",
+                    N_SIZED_TLVS, n_iterations,
+                    unsized_time, (gdouble) unsized_moves / n_iterations,
+                    sized_time, (gdouble) sized_moves / n_iterations);
+    g_test_minimized_result (sized_time, "sized request build: %.3fs", sized_time);
+
+    g_timer_destroy (timer);
+}
+
 static void
 test_message_new_response_ok (void)
 {
@@ -1503,6 +1612,202 @@ test_message_set_transaction_id_services (void)
 
 /*****************************************************************************/
 
+#define N_INDEX_TLVS 48
+
+static QmiMessage *
+build_message_with_tlvs (guint n_tlvs)
+{
+    QmiMessage *self;
+    GError     *error = NULL;
+    gboolean    ret;
+    gsize       init_offset;
+    guint       i;
+
+    self = qmi_message_new (QMI_SERVICE_NAS, 0x01, 0x0001, 0x004F);
+    g_assert (self);
+
+    for (i = 0; i < n_tlvs; i++) {
+        init_offset = qmi_message_tlv_write_init (self, (guint8)(0x10 + i), &error);
+        g_assert_no_error (error);
+        g_assert (init_offset > 0);
+        ret = qmi_message_tlv_write_guint32 (self, QMI_ENDIAN_LITTLE, i, &error);
+        g_assert_no_error (error);
+        g_assert (ret);
+        ret = qmi_message_tlv_write_complete (self, init_offset, &error);
+        g_assert_no_error (error);
+        g_assert (ret);
+    }
+
+    return self;
+}
+
+/* Parses a copy of the message into the pool, which indexes its TLVs */
+static QmiMessage *
+parse_pooled (QmiMessagePool *pool,
+              QmiMessage     *message)
+{
+    QmiMessage   *self;
+    const guint8 *raw;
+    gsize         raw_len;
+    gsize         frame_len;
+    GError       *error = NULL;
+
+    raw = qmi_message_get_raw (message, &raw_len, NULL);
+    self = __qmi_message_new_from_data (pool, raw, raw_len, &frame_len, &error);
+    g_assert_no_error (error);
+    g_assert (self);
+    g_assert_cmpuint (frame_len, ==, raw_len);
+    return self;
+}
+
+static void
+test_message_tlv_index_lookup (void)
+{
+    QmiMessagePool *pool;
+    QmiMessage     *built;
+    QmiMessage     *self;
+    QmiMessage     *other;
+    GError         *error = NULL;
+    gboolean        ret;
+    gsize           init_offset;
+    gsize           offset;
+    guint32         uint32;
+    guint16         length;
+    const guint8   *raw;
+    guint8          duplicate[] = { 0xAA, 0xBB, 0xCC, 0xDD };
+    guint           i;
+
+    pool = __qmi_message_pool_new ();
+
+    built = build_message_with_tlvs (N_INDEX_TLVS);
+    self = parse_pooled (pool, built);
+    qmi_message_unref (built);
+
+    /* Lookup all TLVs, in reverse order */
+    for (i = N_INDEX_TLVS; i > 0; i--) {
+        init_offset = qmi_message_tlv_read_init (self, (guint8)(0x10 + i - 1), NULL, &error);
+        g_assert_no_error (error);
+        g_assert (init_offset > 0);
+        offset = 0;
+        ret = qmi_message_tlv_read_guint32 (self, init_offset, &offset, QMI_ENDIAN_LITTLE, &uint32, &error);
+        g_assert_no_error (error);
+        g_assert (ret);
+        g_assert_cmpuint (uint32, ==, i - 1);
+    }
+
+    /* Unknown TLV */
+    init_offset = qmi_message_tlv_read_init (self, 0x01, NULL, &error);
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TLV_NOT_FOUND);
+    g_assert_cmpuint (init_offset, ==, 0);
+    g_clear_error (&error);
+
+    /* Each pooled message has its own index */
+    built = build_message_with_tlvs (2);
+    other = parse_pooled (pool, built);
+    qmi_message_unref (built);
+    raw = qmi_message_get_raw_tlv (other, 0x10 + N_INDEX_TLVS - 1, &length);
+    g_assert (!raw);
+    raw = qmi_message_get_raw_tlv (other, 0x11, &length);
+    g_assert (raw);
+    g_assert_cmpuint (length, ==, 4);
+    raw = qmi_message_get_raw_tlv (self, 0x10 + N_INDEX_TLVS - 1, &length);
+    g_assert (raw);
+    g_assert_cmpuint (length, ==, 4);
+    qmi_message_unref (other);
+
+    /* A TLV added after the message was parsed must be found, and duplicated
+     * TLV types must still return the first one */
+    ret = qmi_message_add_raw_tlv (self, 0x10, duplicate, sizeof (duplicate), &error);
+    g_assert_no_error (error);
+    g_assert (ret);
+    ret = qmi_message_add_raw_tlv (self, 0x01, duplicate, sizeof (duplicate), &error);
+    g_assert_no_error (error);
+    g_assert (ret);
+
+    raw = qmi_message_get_raw_tlv (self, 0x01, &length);
+    g_assert (raw);
+    g_assert_cmpuint (length, ==, sizeof (duplicate));
+    g_assert (memcmp (raw, duplicate, sizeof (duplicate)) == 0);
+
+    init_offset = qmi_message_tlv_read_init (self, 0x10, NULL, &error);
+    g_assert_no_error (error);
+    offset = 0;
+    ret = qmi_message_tlv_read_guint32 (self, init_offset, &offset, QMI_ENDIAN_LITTLE, &uint32, &error);
+    g_assert_no_error (error);
+    g_assert (ret);
+    g_assert_cmpuint (uint32, ==, 0);
+
+    qmi_message_unref (self);
+
+    /* A recycled buffer (the one of the second message, same size class) must
+     * not keep the index of its previous message */
+    built = build_message_with_tlvs (1);
+    self = parse_pooled (pool, built);
+    qmi_message_unref (built);
+    raw = qmi_message_get_raw_tlv (self, 0x11, &length);
+    g_assert (!raw);
+    raw = qmi_message_get_raw_tlv (self, 0x10, &length);
+    g_assert (raw);
+    g_assert_cmpuint (length, ==, 4);
+    qmi_message_unref (self);
+
+    __qmi_message_pool_close (pool);
+}
+
+static gdouble
+time_tlv_lookups (QmiMessage *self,
+                  guint       n_iterations)
+{
+    GTimer  *timer;
+    gdouble  elapsed;
+    guint    i;
+    guint    j;
+
+    timer = g_timer_new ();
+    for (i = 0; i < n_iterations; i++) {
+        for (j = 0; j < N_INDEX_TLVS; j++)
+            g_assert (qmi_message_tlv_read_init (self, (guint8)(0x10 + j), NULL, NULL) > 0);
+    }
+    elapsed = g_timer_elapsed (timer, NULL);
+    g_timer_destroy (timer);
+
+    return elapsed;
+}
+
+static void
+test_message_tlv_index_perf (void)
+{
+    QmiMessagePool *pool;
+    QmiMessage     *built;
+    QmiMessage     *pooled;
+    gdouble         walk_time;
+    gdouble         indexed_time;
+    guint           n_iterations = 20000;
+
+    if (!g_test_perf ())
+        return;
+
+    pool = __qmi_message_pool_new ();
+    built = build_message_with_tlvs (N_INDEX_TLVS);
+    pooled = parse_pooled (pool, built);
+
+    /* Built messages have no index, each lookup walks the TLV chain */
+    walk_time = time_tlv_lookups (built, n_iterations);
+
+    /* Parsed into a pool, each lookup is a direct hit in the index */
+    indexed_time = time_tlv_lookups (pooled, n_iterations);
+
+    g_test_message ("TLV lookups (%u TLVs, %u iterations): walk %.3fs, indexed %.3fs",
+                    N_INDEX_TLVS, n_iterations, walk_time, indexed_time);
+    g_test_minimized_result (indexed_time, "indexed TLV lookup: %.3fs", indexed_time);
+
+    qmi_message_unref (pooled);
+    qmi_message_unref (built);
+    __qmi_message_pool_close (pool);
+}
+
+/*****************************************************************************/
+
 int main (int argc, char **argv)
 {
     g_test_init (&argc, &argv, NULL);
@@ -1517,6 +1822,8 @@ int main (int argc, char **argv)
     g_test_add_func ("/libqmi-glib/message/new/request",        test_message_new_request);
     g_test_add_func ("/libqmi-glib/message/new/response/ok",    test_message_new_response_ok);
     g_test_add_func ("/libqmi-glib/message/new/response/error", test_message_new_response_error);
+    g_test_add_func ("/libqmi-glib/message/new/sized",          test_message_new_sized);
+    g_test_add_func ("/libqmi-glib/message/new/sized/perf",     test_message_new_sized_perf);
 
     g_test_add_func ("/libqmi-glib/message/tlv-write/empty",           test_message_tlv_write_empty);
     g_test_add_func ("/libqmi-glib/message/tlv-write/reset",           test_message_tlv_write_reset);
@@ -1534,5 +1841,8 @@ int main (int argc, char **argv)
     g_test_add_func ("/libqmi-glib/message/set-transaction-id/ctl",      test_message_set_transaction_id_ctl);
     g_test_add_func ("/libqmi-glib/message/set-transaction-id/services", test_message_set_transaction_id_services);
 
+    g_test_add_func ("/libqmi-glib/message/tlv-index/lookup", test_message_tlv_index_lookup);
+    g_test_add_func ("/libqmi-glib/message/tlv-index/perf",   test_message_tlv_index_perf);
+
     return g_test_run ();
 }
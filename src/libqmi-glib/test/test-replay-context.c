@@ -0,0 +1,642 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+#include <string.h>
+
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <libqmi-glib.h>
+
+#include "test-replay-context.h"
+#include "qmi-capture.h"
+
+#define BUFFER_SIZE 4096
+
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN 0xFF00
+
+typedef struct {
+    gint64      timestamp;
+    gint64      delay;
+    QmiMessage *message;
+} Record;
+
+struct _TestReplayContext {
+    gchar *name;
+    gdouble speed;
+    GThread *thread;
+    gboolean ready;
+    GCond ready_cond;
+    GMutex ready_mutex;
+    GMainLoop *loop;
+    GSocketService *socket_service;
+    GList *clients;
+
+    /* Contents of the capture */
+    GPtrArray *requests;
+    GHashTable *responses;
+    GPtrArray *indications;
+    gint64 first_request_timestamp;
+
+    volatile gint n_responses;
+    volatile gint n_unmatched;
+    volatile gint n_indications;
+};
+
+/*****************************************************************************/
+/* Capture loading */
+
+/* Same key as the one QmiDevice uses to match transactions */
+static gpointer
+build_transaction_key (QmiMessage *message)
+{
+    guint8 service;
+    guint8 client_id;
+    guint16 transaction_id;
+
+    service = (guint8)qmi_message_get_service (message);
+    client_id = qmi_message_get_client_id (message);
+    transaction_id = qmi_message_get_transaction_id (message);
+
+    return GUINT_TO_POINTER ((((service << 8) | client_id) << 16) | transaction_id);
+}
+
+static gboolean
+message_is_proxy_open (QmiMessage *message)
+{
+    return (qmi_message_get_service (message) == QMI_SERVICE_CTL &&
+            qmi_message_get_message_id (message) == QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN);
+}
+
+static void
+record_free (Record *record)
+{
+    qmi_message_unref (record->message);
+    g_slice_free (Record, record);
+}
+
+static void
+record_queue_free (GQueue *queue)
+{
+    g_queue_free_full (queue, (GDestroyNotify)record_free);
+}
+
+static gboolean
+load_capture (TestReplayContext  *ctx,
+              const gchar        *capture_path,
+              GError            **error)
+{
+    QmiCaptureReader *reader;
+    QmiCaptureRecord  capture_record;
+    GHashTable       *request_timestamps;
+    GError           *inner_error = NULL;
+
+    reader = __qmi_capture_reader_new (capture_path, error);
+    if (!reader)
+        return FALSE;
+
+    /* Timestamp of the last request seen for each transaction key, so that
+     * the delay of each response can be computed */
+    request_timestamps = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+
+    ctx->first_request_timestamp = -1;
+    while (__qmi_capture_reader_next (reader, &capture_record, &inner_error)) {
+        GByteArray *raw;
+        QmiMessage *message;
+        Record     *record;
+        gpointer    key;
+
+        raw = g_byte_array_sized_new (capture_record.frame_len);
+        g_byte_array_append (raw, capture_record.frame, capture_record.frame_len);
+        message = qmi_message_new_from_raw (raw, NULL);
+        g_byte_array_unref (raw);
+        if (!message)
+            continue;
+
+        record = g_slice_new0 (Record);
+        record->timestamp = capture_record.timestamp;
+        record->message = message;
+        key = build_transaction_key (message);
+
+        if (capture_record.direction == QMI_CAPTURE_DIRECTION_OUT) {
+            if (message_is_proxy_open (message)) {
+                record_free (record);
+                continue;
+            }
+            if (ctx->first_request_timestamp < 0)
+                ctx->first_request_timestamp = record->timestamp;
+            g_hash_table_insert (request_timestamps, key, g_memdup (&record->timestamp, sizeof (gint64)));
+            g_ptr_array_add (ctx->requests, record);
+        } else if (qmi_message_is_indication (message)) {
+            g_ptr_array_add (ctx->indications, record);
+        } else if (qmi_message_is_response (message) && !message_is_proxy_open (message)) {
+            GQueue *queue;
+            gint64 *request_timestamp;
+
+            request_timestamp = g_hash_table_lookup (request_timestamps, key);
+            if (request_timestamp && record->timestamp > *request_timestamp)
+                record->delay = record->timestamp - *request_timestamp;
+
+            queue = g_hash_table_lookup (ctx->responses, key);
+            if (!queue) {
+                queue = g_queue_new ();
+                g_hash_table_insert (ctx->responses, key, queue);
+            }
+            g_queue_push_tail (queue, record);
+        } else
+            record_free (record);
+    }
+
+    g_hash_table_unref (request_timestamps);
+    __qmi_capture_reader_free (reader);
+
+    if (inner_error) {
+        g_propagate_error (error, inner_error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*****************************************************************************/
+
+typedef struct {
+    TestReplayContext *ctx;
+    GSocketConnection *connection;
+    GSource *connection_readable_source;
+    GByteArray *buffer;
+    GList *pending_sources;
+    gboolean indications_scheduled;
+} Client;
+
+typedef struct {
+    Client *client;
+    GSource *source;
+    QmiMessage *message;
+    volatile gint *counter;
+} PendingSend;
+
+static void
+client_send (Client     *client,
+             QmiMessage *message)
+{
+    GError *error = NULL;
+
+    if (!g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (client->connection)),
+                                    ((GByteArray *)message)->data,
+                                    ((GByteArray *)message)->len,
+                                    NULL, /* bytes_written */
+                                    NULL, /* cancellable */
+                                    &error)) {
+        g_warning ("Cannot send message to client: %s", error->message);
+        g_error_free (error);
+    }
+}
+
+static void
+pending_send_free (PendingSend *pending)
+{
+    g_source_unref (pending->source);
+    qmi_message_unref (pending->message);
+    g_slice_free (PendingSend, pending);
+}
+
+static gboolean
+pending_send_cb (PendingSend *pending)
+{
+    Client *client = pending->client;
+
+    client_send (client, pending->message);
+    g_atomic_int_inc (pending->counter);
+
+    client->pending_sources = g_list_remove (client->pending_sources, pending);
+    pending_send_free (pending);
+    return G_SOURCE_REMOVE;
+}
+
+/* Sends the message after the given delay in the capture, scaled by the
+ * replay speed */
+static void
+client_schedule_send (Client        *client,
+                      QmiMessage    *message,
+                      gint64         delay,
+                      volatile gint *counter)
+{
+    PendingSend *pending;
+    gdouble speed;
+
+    speed = client->ctx->speed;
+    if (speed <= 0.0 || delay <= 0) {
+        client_send (client, message);
+        g_atomic_int_inc (counter);
+        return;
+    }
+
+    pending = g_slice_new0 (PendingSend);
+    pending->client = client;
+    pending->message = qmi_message_ref (message);
+    pending->counter = counter;
+    pending->source = g_timeout_source_new ((guint) (delay / speed / 1000));
+    g_source_set_callback (pending->source, (GSourceFunc)pending_send_cb, pending, NULL);
+    g_source_attach (pending->source, g_main_context_get_thread_default ());
+    client->pending_sources = g_list_prepend (client->pending_sources, pending);
+}
+
+static void
+client_free (Client *client)
+{
+    GList *l;
+
+    for (l = client->pending_sources; l; l = g_list_next (l)) {
+        PendingSend *pending = l->data;
+
+        g_source_destroy (pending->source);
+        pending_send_free (pending);
+    }
+    g_list_free (client->pending_sources);
+
+    g_source_destroy (client->connection_readable_source);
+    g_source_unref (client->connection_readable_source);
+    g_output_stream_close (g_io_stream_get_output_stream (G_IO_STREAM (client->connection)), NULL, NULL);
+    if (client->buffer)
+        g_byte_array_unref (client->buffer);
+    g_object_unref (client->connection);
+    g_slice_free (Client, client);
+}
+
+static void
+connection_close (Client *client)
+{
+    client->ctx->clients = g_list_remove (client->ctx->clients, client);
+    client_free (client);
+}
+
+static void
+client_schedule_indications (Client *client)
+{
+    TestReplayContext *ctx = client->ctx;
+    guint i;
+
+    /* Indications keep their time offset relative to the first request */
+    for (i = 0; i < ctx->indications->len; i++) {
+        Record *record = g_ptr_array_index (ctx->indications, i);
+
+        client_schedule_send (client,
+                              record->message,
+                              record->timestamp - ctx->first_request_timestamp,
+                              &ctx->n_indications);
+    }
+}
+
+static void
+client_process_request (Client     *client,
+                        QmiMessage *request)
+{
+    TestReplayContext *ctx = client->ctx;
+    GQueue *queue;
+    Record *record;
+
+    /* Opening the device through the proxy is always accepted */
+    if (message_is_proxy_open (request)) {
+        QmiMessage *response;
+
+        response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+        client_send (client, response);
+        qmi_message_unref (response);
+        return;
+    }
+
+    if (!client->indications_scheduled) {
+        client->indications_scheduled = TRUE;
+        client_schedule_indications (client);
+    }
+
+    queue = g_hash_table_lookup (ctx->responses, build_transaction_key (request));
+    record = queue ? g_queue_pop_head (queue) : NULL;
+    if (!record) {
+        QmiMessage *response;
+
+        /* Don't leave the caller waiting for a response that won't come */
+        response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_INTERNAL);
+        client_send (client, response);
+        qmi_message_unref (response);
+        g_atomic_int_inc (&ctx->n_unmatched);
+        return;
+    }
+
+    client_schedule_send (client, record->message, record->delay, &ctx->n_responses);
+    record_free (record);
+}
+
+static gboolean
+connection_readable_cb (GSocket *socket,
+                        GIOCondition condition,
+                        Client *client)
+{
+    guint8 buffer[BUFFER_SIZE];
+    GError *error = NULL;
+    gssize r;
+
+    if (condition & G_IO_HUP || condition & G_IO_ERR) {
+        g_debug ("client connection closed");
+        connection_close (client);
+        return FALSE;
+    }
+
+    if (!(condition & G_IO_IN || condition & G_IO_PRI))
+        return TRUE;
+
+    r = g_input_stream_read (g_io_stream_get_input_stream (G_IO_STREAM (client->connection)),
+                             buffer,
+                             BUFFER_SIZE,
+                             NULL,
+                             &error);
+
+    if (r < 0) {
+        g_warning ("Error reading from istream: %s", error ? error->message : "unknown");
+        if (error)
+            g_error_free (error);
+        /* Close the device */
+        connection_close (client);
+        return FALSE;
+    }
+
+    if (r == 0)
+        return TRUE;
+
+    /* else, r > 0 */
+    if (!G_UNLIKELY (client->buffer))
+        client->buffer = g_byte_array_sized_new (r);
+    g_byte_array_append (client->buffer, buffer, r);
+
+    /* Process all complete requests */
+    while (client->buffer->len > 0) {
+        QmiMessage *request;
+
+        request = qmi_message_new_from_raw (client->buffer, &error);
+        if (!request) {
+            if (error) {
+                g_warning ("Invalid request received: %s", error->message);
+                g_clear_error (&error);
+                continue;
+            }
+            /* More data we need */
+            break;
+        }
+
+        client_process_request (client, request);
+        qmi_message_unref (request);
+    }
+
+    return TRUE;
+}
+
+static Client *
+client_new (TestReplayContext *ctx,
+            GSocketConnection *connection)
+{
+    Client *client;
+
+    client = g_slice_new0 (Client);
+    client->ctx = ctx;
+    client->connection = g_object_ref (connection);
+    client->connection_readable_source = g_socket_create_source (g_socket_connection_get_socket (client->connection),
+                                                                 G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP,
+                                                                 NULL);
+    g_source_set_callback (client->connection_readable_source,
+                           (GSourceFunc)connection_readable_cb,
+                           client,
+                           NULL);
+    g_source_attach (client->connection_readable_source, g_main_context_get_thread_default ());
+
+    return client;
+}
+
+/*****************************************************************************/
+
+static void
+incoming_cb (GSocketService *service,
+             GSocketConnection *connection,
+             GObject *unused,
+             TestReplayContext *ctx)
+{
+    Client *client;
+
+    client = client_new (ctx, connection);
+    ctx->clients = g_list_append (ctx->clients, client);
+}
+
+static void
+create_socket_service (TestReplayContext *ctx)
+{
+    GError *error = NULL;
+    GSocketService *service;
+    GSocketAddress *address;
+    GSocket *socket;
+
+    g_assert (ctx->socket_service == NULL);
+
+    /* Create socket */
+    socket = g_socket_new (G_SOCKET_FAMILY_UNIX,
+                           G_SOCKET_TYPE_STREAM,
+                           G_SOCKET_PROTOCOL_DEFAULT,
+                           &error);
+    if (!socket)
+        g_error ("Cannot create socket: %s", error->message);
+
+    /* Bind to address */
+    address = (g_unix_socket_address_new_with_type (
+                   ctx->name,
+                   -1,
+                   G_UNIX_SOCKET_ADDRESS_ABSTRACT));
+    if (!g_socket_bind (socket, address, TRUE, &error))
+        g_error ("Cannot bind socket '%s': %s", ctx->name, error->message);
+
+    /* Listen */
+    if (!g_socket_listen (socket, &error))
+        g_error ("Cannot listen in socket: %s", error->message);
+
+    /* Create socket service */
+    service = g_socket_service_new ();
+    g_signal_connect (service, "incoming", G_CALLBACK (incoming_cb), ctx);
+    if (!g_socket_listener_add_socket (G_SOCKET_LISTENER (service),
+                                       socket,
+                                       NULL, /* don't pass an object, will take a reference */
+                                       &error))
+        g_error ("Cannot add listener to socket: %s", error->message);
+
+    /* Start it */
+    g_socket_service_start (service);
+
+    /* And store it */
+    ctx->socket_service = service;
+
+    /* Signal that the thread is ready */
+    g_mutex_lock (&ctx->ready_mutex);
+    ctx->ready = TRUE;
+    g_cond_signal (&ctx->ready_cond);
+    g_mutex_unlock (&ctx->ready_mutex);
+
+    if (socket)
+        g_object_unref (socket);
+    if (address)
+        g_object_unref (address);
+}
+
+/*****************************************************************************/
+
+void
+test_replay_context_stop (TestReplayContext *ctx)
+{
+    g_assert (ctx->thread != NULL);
+    g_assert (ctx->loop != NULL);
+
+    g_main_loop_quit (ctx->loop);
+
+    g_thread_join (ctx->thread);
+    ctx->thread = NULL;
+}
+
+static gpointer
+replay_context_thread_func (TestReplayContext *ctx)
+{
+    GMainContext *thread_context;
+
+    thread_context = g_main_context_new ();
+    g_main_context_push_thread_default (thread_context);
+
+    create_socket_service (ctx);
+
+    g_assert (ctx->loop == NULL);
+    ctx->loop = g_main_loop_new (g_main_context_get_thread_default (), FALSE);
+    g_main_loop_run (ctx->loop);
+    g_main_loop_unref (ctx->loop);
+    ctx->loop = NULL;
+
+    /* Clients must be gone before the context they use */
+    g_list_free_full (ctx->clients, (GDestroyNotify)client_free);
+    ctx->clients = NULL;
+    if (ctx->socket_service) {
+        if (g_socket_service_is_active (ctx->socket_service))
+            g_socket_service_stop (ctx->socket_service);
+        g_clear_object (&ctx->socket_service);
+    }
+
+    g_main_context_pop_thread_default (thread_context);
+    g_main_context_unref (thread_context);
+    return NULL;
+}
+
+void
+test_replay_context_start (TestReplayContext *ctx)
+{
+    g_assert (ctx->thread == NULL);
+    ctx->thread = g_thread_new (ctx->name,
+                                (GThreadFunc)replay_context_thread_func,
+                                ctx);
+
+    /* Now wait until the thread has finished its initialization and is
+     * ready to serve connections */
+    g_mutex_lock (&ctx->ready_mutex);
+    while (!ctx->ready)
+        g_cond_wait (&ctx->ready_cond, &ctx->ready_mutex);
+    g_mutex_unlock (&ctx->ready_mutex);
+}
+
+/*****************************************************************************/
+
+void
+test_replay_context_set_speed (TestReplayContext *ctx,
+                               gdouble            speed)
+{
+    g_assert (ctx->thread == NULL);
+    ctx->speed = speed;
+}
+
+guint
+test_replay_context_get_n_requests (TestReplayContext *ctx)
+{
+    return ctx->requests->len;
+}
+
+QmiMessage *
+test_replay_context_peek_request (TestReplayContext *ctx,
+                                  guint              i,
+                                  gint64            *offset)
+{
+    Record *record;
+
+    g_assert (i < ctx->requests->len);
+    record = g_ptr_array_index (ctx->requests, i);
+    if (offset)
+        *offset = record->timestamp - ctx->first_request_timestamp;
+    return record->message;
+}
+
+void
+test_replay_context_get_stats (TestReplayContext *ctx,
+                               guint             *n_responses,
+                               guint             *n_unmatched,
+                               guint             *n_indications)
+{
+    if (n_responses)
+        *n_responses = g_atomic_int_get (&ctx->n_responses);
+    if (n_unmatched)
+        *n_unmatched = g_atomic_int_get (&ctx->n_unmatched);
+    if (n_indications)
+        *n_indications = g_atomic_int_get (&ctx->n_indications);
+}
+
+/*****************************************************************************/
+
+void
+test_replay_context_free (TestReplayContext *ctx)
+{
+    g_assert (ctx->thread == NULL);
+    g_assert (ctx->loop == NULL);
+
+    g_cond_clear (&ctx->ready_cond);
+    g_mutex_clear (&ctx->ready_mutex);
+
+    g_ptr_array_unref (ctx->requests);
+    g_hash_table_unref (ctx->responses);
+    g_ptr_array_unref (ctx->indications);
+    g_free (ctx->name);
+    g_slice_free (TestReplayContext, ctx);
+}
+
+TestReplayContext *
+test_replay_context_new (const gchar  *name,
+                         const gchar  *capture_path,
+                         GError      **error)
+{
+    TestReplayContext *ctx;
+
+    ctx = g_slice_new0 (TestReplayContext);
+    ctx->name = g_strdup (name);
+    ctx->speed = 1.0;
+    g_cond_init (&ctx->ready_cond);
+    g_mutex_init (&ctx->ready_mutex);
+    ctx->requests = g_ptr_array_new_with_free_func ((GDestroyNotify)record_free);
+    ctx->responses = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)record_queue_free);
+    ctx->indications = g_ptr_array_new_with_free_func ((GDestroyNotify)record_free);
+
+    if (!load_capture (ctx, capture_path, error)) {
+        test_replay_context_free (ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
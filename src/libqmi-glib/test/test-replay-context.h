@@ -0,0 +1,55 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Same setup as test-port-context, but serving the responses and
+ * indications recorded in a capture file.
+ */
+
+#ifndef TEST_REPLAY_CONTEXT_H
+#define TEST_REPLAY_CONTEXT_H
+
+#include <glib.h>
+#include <glib-object.h>
+#include <libqmi-glib.h>
+
+typedef struct _TestReplayContext TestReplayContext;
+
+/* Loads the capture; responses are matched to the requests received by
+ * service, CID and transaction ID, in capture order */
+TestReplayContext *test_replay_context_new             (const gchar        *name,
+                                                        const gchar        *capture_path,
+                                                        GError            **error);
+void               test_replay_context_start           (TestReplayContext  *ctx);
+void               test_replay_context_stop            (TestReplayContext  *ctx);
+void               test_replay_context_free            (TestReplayContext  *ctx);
+
+/* Speed factor applied to the captured timing: 1.0 replays with the original
+ * timing, 10.0 ten times faster, 0 without any delay */
+void               test_replay_context_set_speed       (TestReplayContext  *ctx,
+                                                        gdouble             speed);
+
+/* Requests found in the capture, with their time offset (in microseconds)
+ * since the first captured request; the internal proxy open request is
+ * skipped, as it's sent by the device itself when opening */
+guint              test_replay_context_get_n_requests  (TestReplayContext  *ctx);
+QmiMessage        *test_replay_context_peek_request    (TestReplayContext  *ctx,
+                                                        guint               i,
+                                                        gint64             *offset);
+
+void               test_replay_context_get_stats       (TestReplayContext  *ctx,
+                                                        guint              *n_responses,
+                                                        guint              *n_unmatched,
+                                                        guint              *n_indications);
+
+#endif /* TEST_REPLAY_CONTEXT_H */
@@ -0,0 +1,1189 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <libqmi-glib.h>
+
+#include "test-replay-context.h"
+#include "qmi-capture.h"
+
+#define QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN 0xFF00
+#define QMI_MESSAGE_DMS_GET_CAPABILITIES    0x0020
+#define QMI_MESSAGE_DMS_GET_IDS             0x0025
+
+/*****************************************************************************/
+/* Synthetic captures */
+
+static void
+capture_add_message (QmiCapture          *capture,
+                     gint64               timestamp,
+                     QmiCaptureDirection  direction,
+                     QmiMessage          *message)
+{
+    __qmi_capture_add (capture,
+                       timestamp,
+                       direction,
+                       QMI_MESSAGE_VENDOR_GENERIC,
+                       ((GByteArray *)message)->data,
+                       ((GByteArray *)message)->len);
+}
+
+/* Proxy open, then n_requests DMS requests each followed by its response
+ * (1ms later), then a WDS broadcast indication (2ms after the first request).
+ * Requests are DMS Get IDs unless other message ids are given. */
+static gchar *
+build_capture_full (const guint16 *message_ids,
+                    guint          n_requests)
+{
+    static const guint8 indication[] = {
+        0x01,       /* marker */
+        /* QMUX */
+        0x0C, 0x00, /* length */
+        0x80,       /* flags */
+        0x01,       /* service WDS */
+        0xFF,       /* client broadcast */
+        /* QMI header */
+        0x04,       /* flags: Indication */
+        0x00, 0x00, /* transaction */
+        0x01, 0x00, /* message: Event report */
+        0x00, 0x00, /* tlv length */
+    };
+    QmiCapture *capture;
+    QmiMessage *request;
+    QmiMessage *response;
+    GError     *error = NULL;
+    gchar      *path;
+    gint        fd;
+    gint64      timestamp = 1000000;
+    gboolean    st;
+    guint       i;
+
+    fd = g_file_open_tmp ("test-replay-capture-XXXXXX", &path, &error);
+    g_assert_no_error (error);
+    close (fd);
+
+    capture = __qmi_capture_new (path, "/dev/cdc-wdm0", &error);
+    g_assert_no_error (error);
+    g_assert (capture);
+
+    /* Sent by the device itself when opening, must be skipped */
+    request = qmi_message_new (QMI_SERVICE_CTL, 0, 0xFF, QMI_MESSAGE_CTL_INTERNAL_PROXY_OPEN);
+    capture_add_message (capture, timestamp, QMI_CAPTURE_DIRECTION_OUT, request);
+    response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+    capture_add_message (capture, timestamp + 100, QMI_CAPTURE_DIRECTION_IN, response);
+    qmi_message_unref (response);
+    qmi_message_unref (request);
+
+    for (i = 0; i < n_requests; i++) {
+        timestamp += 10000;
+
+        request = qmi_message_new (QMI_SERVICE_DMS, 1, i + 1,
+                                   message_ids ? message_ids[i] : QMI_MESSAGE_DMS_GET_IDS);
+        capture_add_message (capture, timestamp, QMI_CAPTURE_DIRECTION_OUT, request);
+        response = qmi_message_response_new (request, QMI_PROTOCOL_ERROR_NONE);
+        capture_add_message (capture, timestamp + 1000, QMI_CAPTURE_DIRECTION_IN, response);
+        qmi_message_unref (response);
+        qmi_message_unref (request);
+
+        if (i == 0)
+            __qmi_capture_add (capture,
+                               timestamp + 2000,
+                               QMI_CAPTURE_DIRECTION_IN,
+                               QMI_MESSAGE_VENDOR_GENERIC,
+                               indication,
+                               G_N_ELEMENTS (indication));
+    }
+
+    st = __qmi_capture_flush (capture, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    __qmi_capture_free (capture);
+
+    return path;
+}
+
+static gchar *
+build_capture (guint n_requests)
+{
+    return build_capture_full (NULL, n_requests);
+}
+
+/*****************************************************************************/
+/* Replay driver */
+
+typedef struct {
+    GMainLoop         *loop;
+    gchar             *path;
+    TestReplayContext *ctx;
+    QmiDevice         *device;
+    gdouble            speed;
+    guint              next;
+    guint              n_responses;
+    guint              n_errors;
+    guint              n_indications;
+    gint64             start_time;
+    GArray            *completed;
+    guint              n_expected;
+} Replay;
+
+static void send_next (Replay *replay);
+
+static void
+device_new_ready (GObject      *source,
+                  GAsyncResult *res,
+                  Replay       *replay)
+{
+    GError *error = NULL;
+
+    replay->device = qmi_device_new_finish (res, &error);
+    g_assert_no_error (error);
+    g_assert (QMI_IS_DEVICE (replay->device));
+    g_main_loop_quit (replay->loop);
+}
+
+static void
+device_open_ready (QmiDevice    *device,
+                   GAsyncResult *res,
+                   Replay       *replay)
+{
+    GError   *error = NULL;
+    gboolean  st;
+
+    st = qmi_device_open_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    g_main_loop_quit (replay->loop);
+}
+
+static void
+device_indication_cb (QmiDevice  *device,
+                      QmiMessage *message,
+                      Replay     *replay)
+{
+    replay->n_indications++;
+}
+
+static gchar *
+replay_build_path (void)
+{
+    static guint32 num = 0;
+
+    /* Add process ID so that multiple runs of this test in the same system
+     * don't clash with each other */
+    return g_strdup_printf ("/dev/qmi%08lu%04u", (gulong) getpid (), num++);
+}
+
+/* Takes ownership of the path */
+static Replay *
+replay_new_full (gchar              *path,
+                 const gchar        *capture_path,
+                 gdouble             speed,
+                 QmiDeviceOpenFlags  open_flags,
+                 const gchar        *version_info_cache,
+                 GMainContext       *io_context)
+{
+    Replay *replay;
+    GError *error = NULL;
+    GFile  *file;
+
+    replay = g_slice_new0 (Replay);
+    replay->loop = g_main_loop_new (NULL, FALSE);
+    replay->speed = speed;
+    replay->completed = g_array_new (FALSE, FALSE, sizeof (guint16));
+    replay->path = path;
+    replay->ctx = test_replay_context_new (replay->path, capture_path, &error);
+    g_assert_no_error (error);
+    g_assert (replay->ctx);
+    test_replay_context_set_speed (replay->ctx, speed);
+    test_replay_context_start (replay->ctx);
+
+    file = g_file_new_for_path (replay->path);
+    g_async_initable_new_async (QMI_TYPE_DEVICE,
+                                G_PRIORITY_DEFAULT,
+                                NULL,
+                                (GAsyncReadyCallback) device_new_ready,
+                                replay,
+                                QMI_DEVICE_FILE,          file,
+                                QMI_DEVICE_NO_FILE_CHECK, TRUE,
+                                QMI_DEVICE_PROXY_PATH,    replay->path,
+                                QMI_DEVICE_VERSION_INFO_CACHE, version_info_cache,
+                                QMI_DEVICE_IO_CONTEXT,    io_context,
+                                NULL);
+    g_object_unref (file);
+    g_main_loop_run (replay->loop);
+
+    g_signal_connect (replay->device,
+                      QMI_DEVICE_SIGNAL_INDICATION,
+                      G_CALLBACK (device_indication_cb),
+                      replay);
+
+    qmi_device_open (replay->device, QMI_DEVICE_OPEN_FLAGS_PROXY | open_flags, 1, NULL,
+                     (GAsyncReadyCallback) device_open_ready,
+                     replay);
+    g_main_loop_run (replay->loop);
+
+    return replay;
+}
+
+static Replay *
+replay_new (const gchar *capture_path,
+            gdouble      speed)
+{
+    return replay_new_full (replay_build_path (), capture_path, speed, QMI_DEVICE_OPEN_FLAGS_NONE, NULL, NULL);
+}
+
+static void
+replay_free (Replay *replay)
+{
+    g_object_unref (replay->device);
+    test_replay_context_stop (replay->ctx);
+    test_replay_context_free (replay->ctx);
+    g_main_loop_unref (replay->loop);
+    g_array_unref (replay->completed);
+    g_free (replay->path);
+    g_slice_free (Replay, replay);
+}
+
+static void
+command_ready (QmiDevice    *device,
+               GAsyncResult *res,
+               Replay       *replay)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
+    gsize       init_offset;
+    gsize       offset = 0;
+    guint16     error_status;
+    guint16     error_code;
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (response);
+    g_assert (qmi_message_is_response (response));
+
+    /* Result TLV */
+    init_offset = qmi_message_tlv_read_init (response, 0x02, NULL, &error);
+    g_assert_no_error (error);
+    qmi_message_tlv_read_guint16 (response, init_offset, &offset, QMI_ENDIAN_LITTLE, &error_status, &error);
+    g_assert_no_error (error);
+    qmi_message_tlv_read_guint16 (response, init_offset, &offset, QMI_ENDIAN_LITTLE, &error_code, &error);
+    g_assert_no_error (error);
+    qmi_message_unref (response);
+
+    if (error_status == 0x00)
+        replay->n_responses++;
+    else
+        replay->n_errors++;
+
+    send_next (replay);
+}
+
+static gboolean
+send_next_timeout_cb (Replay *replay)
+{
+    send_next (replay);
+    return G_SOURCE_REMOVE;
+}
+
+/* Requests are sent one after the other, each one not before its captured
+ * time offset (scaled by the replay speed) */
+static void
+send_next (Replay *replay)
+{
+    QmiMessage *request;
+    gint64      offset;
+    gint64      elapsed;
+
+    if (replay->next == test_replay_context_get_n_requests (replay->ctx)) {
+        g_main_loop_quit (replay->loop);
+        return;
+    }
+
+    request = test_replay_context_peek_request (replay->ctx, replay->next, &offset);
+
+    if (replay->next == 0)
+        replay->start_time = g_get_monotonic_time ();
+    else if (replay->speed > 0.0) {
+        elapsed = g_get_monotonic_time () - replay->start_time;
+        if (elapsed < (gint64) (offset / replay->speed)) {
+            g_timeout_add ((guint) ((offset / replay->speed - elapsed) / 1000),
+                           (GSourceFunc) send_next_timeout_cb,
+                           replay);
+            return;
+        }
+    }
+
+    replay->next++;
+    qmi_device_command_full (replay->device,
+                             request,
+                             NULL,
+                             10,
+                             NULL,
+                             (GAsyncReadyCallback) command_ready,
+                             replay);
+}
+
+static void
+replay_run (Replay *replay)
+{
+    replay->next = 0;
+    send_next (replay);
+    g_main_loop_run (replay->loop);
+}
+
+static gboolean
+loop_quit_timeout_cb (Replay *replay)
+{
+    g_main_loop_quit (replay->loop);
+    return G_SOURCE_REMOVE;
+}
+
+/* Indications are not tied to any request, so just give them time to arrive */
+static void
+replay_wait_indications (Replay *replay,
+                         guint   n_indications)
+{
+    guint retries = 100;
+
+    while (replay->n_indications < n_indications && retries--) {
+        g_timeout_add (10, (GSourceFunc) loop_quit_timeout_cb, replay);
+        g_main_loop_run (replay->loop);
+    }
+}
+
+/*****************************************************************************/
+
+static void
+test_replay_load (void)
+{
+    TestReplayContext *ctx;
+    QmiMessage        *request;
+    GError            *error = NULL;
+    gchar             *capture_path;
+    gint64             offset;
+
+    capture_path = build_capture (3);
+
+    ctx = test_replay_context_new ("test-replay-load", capture_path, &error);
+    g_assert_no_error (error);
+    g_assert (ctx);
+
+    /* Proxy open skipped */
+    g_assert_cmpuint (test_replay_context_get_n_requests (ctx), ==, 3);
+
+    request = test_replay_context_peek_request (ctx, 0, &offset);
+    g_assert_cmpuint (qmi_message_get_service (request), ==, QMI_SERVICE_DMS);
+    g_assert_cmpuint (qmi_message_get_transaction_id (request), ==, 1);
+    g_assert_cmpint (offset, ==, 0);
+
+    request = test_replay_context_peek_request (ctx, 2, &offset);
+    g_assert_cmpuint (qmi_message_get_transaction_id (request), ==, 3);
+    g_assert_cmpint (offset, ==, 20000);
+
+    test_replay_context_free (ctx);
+    g_unlink (capture_path);
+    g_free (capture_path);
+}
+
+static void
+test_replay_load_error (void)
+{
+    TestReplayContext *ctx;
+    GError            *error = NULL;
+
+    ctx = test_replay_context_new ("test-replay-load-error", "/nonexistent/capture.pcapng", &error);
+    g_assert (error);
+    g_assert (!ctx);
+    g_error_free (error);
+}
+
+static void
+test_replay_serve (gconstpointer data)
+{
+    Replay  *replay;
+    gchar   *capture_path;
+    gdouble  speed;
+    guint    n_responses;
+    guint    n_unmatched;
+    guint    n_indications;
+
+    speed = *((const gdouble *) data);
+    capture_path = build_capture (5);
+
+    replay = replay_new (capture_path, speed);
+    replay_run (replay);
+    g_assert_cmpuint (replay->n_responses, ==, 5);
+    g_assert_cmpuint (replay->n_errors, ==, 0);
+
+    replay_wait_indications (replay, 1);
+    g_assert_cmpuint (replay->n_indications, ==, 1);
+
+    test_replay_context_get_stats (replay->ctx, &n_responses, &n_unmatched, &n_indications);
+    g_assert_cmpuint (n_responses, ==, 5);
+    g_assert_cmpuint (n_unmatched, ==, 0);
+    g_assert_cmpuint (n_indications, ==, 1);
+
+    /* Second run: the captured responses are already consumed, so the
+     * replay reports the requests as unmatched */
+    replay_run (replay);
+    g_assert_cmpuint (replay->n_responses, ==, 5);
+    g_assert_cmpuint (replay->n_errors, ==, 5);
+
+    test_replay_context_get_stats (replay->ctx, NULL, &n_unmatched, NULL);
+    g_assert_cmpuint (n_unmatched, ==, 5);
+
+    replay_free (replay);
+    g_unlink (capture_path);
+    g_free (capture_path);
+}
+
+/* Replays the capture given in QMI_TEST_REPLAY_CAPTURE (or a synthetic one),
+ * at the speed given in QMI_TEST_REPLAY_SPEED (by default, without delays) */
+static void
+test_replay_perf (void)
+{
+    Replay      *replay;
+    const gchar *env;
+    gchar       *capture_path = NULL;
+    gdouble      speed = 0.0;
+    gdouble      elapsed;
+    guint        n_requests;
+    guint        n_indications;
+    GTimer      *timer;
+
+    if (!g_test_perf ())
+        return;
+
+    env = g_getenv ("QMI_TEST_REPLAY_SPEED");
+    if (env)
+        speed = g_ascii_strtod (env, NULL);
+
+    env = g_getenv ("QMI_TEST_REPLAY_CAPTURE");
+    if (!env)
+        capture_path = build_capture (10000);
+
+    replay = replay_new (env ? env : capture_path, speed);
+    n_requests = test_replay_context_get_n_requests (replay->ctx);
+
+    timer = g_timer_new ();
+    replay_run (replay);
+    elapsed = g_timer_elapsed (timer, NULL);
+    g_timer_destroy (timer);
+
+    test_replay_context_get_stats (replay->ctx, NULL, NULL, &n_indications);
+    g_test_message ("Replayed %u requests (%u unmatched) and %u indications at speed %.1lf in %.3fs",
+                    n_requests, replay->n_errors, n_indications, speed, elapsed);
+    g_test_maximized_result ((n_requests + n_indications) / elapsed,
+                             "replay throughput: %.0lf msgs/s",
+                             (n_requests + n_indications) / elapsed);
+
+    replay_free (replay);
+    if (capture_path) {
+        g_unlink (capture_path);
+        g_free (capture_path);
+    }
+}
+
+/*****************************************************************************/
+
+/* Records the transaction id of each response, until n_expected are received */
+static void
+recorded_command_ready (QmiDevice    *device,
+                        GAsyncResult *res,
+                        Replay       *replay)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
+    guint16     transaction_id;
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (response);
+
+    transaction_id = qmi_message_get_transaction_id (response);
+    g_array_append_val (replay->completed, transaction_id);
+    qmi_message_unref (response);
+
+    if (replay->completed->len == replay->n_expected)
+        g_main_loop_quit (replay->loop);
+}
+
+static void
+test_replay_in_flight_limit (void)
+{
+    static const guint16 message_ids[] = {
+        QMI_MESSAGE_DMS_GET_IDS,
+        QMI_MESSAGE_DMS_GET_IDS,
+        QMI_MESSAGE_DMS_GET_CAPABILITIES,
+    };
+    Replay *replay;
+    gchar  *capture_path;
+    guint   i;
+
+    capture_path = build_capture_full (message_ids, G_N_ELEMENTS (message_ids));
+    replay = replay_new (capture_path, 0.0);
+
+    g_assert_cmpuint (qmi_device_get_service_in_flight_limit (replay->device, QMI_SERVICE_DMS), ==, 0);
+    qmi_device_set_service_in_flight_limit (replay->device, QMI_SERVICE_DMS, 1);
+    g_assert_cmpuint (qmi_device_get_service_in_flight_limit (replay->device, QMI_SERVICE_DMS), ==, 1);
+    qmi_device_set_message_priority (replay->device, QMI_SERVICE_DMS, QMI_MESSAGE_DMS_GET_CAPABILITIES, G_PRIORITY_HIGH);
+
+    replay->n_expected = G_N_ELEMENTS (message_ids);
+    for (i = 0; i < G_N_ELEMENTS (message_ids); i++)
+        qmi_device_command_full (replay->device,
+                                 test_replay_context_peek_request (replay->ctx, i, NULL),
+                                 NULL,
+                                 10,
+                                 NULL,
+                                 (GAsyncReadyCallback) recorded_command_ready,
+                                 replay);
+
+    /* Only the first request is written, the others wait for its response */
+    g_assert_cmpuint (qmi_device_get_service_in_flight (replay->device, QMI_SERVICE_DMS), ==, 1);
+    g_assert_cmpuint (qmi_device_get_output_queue_depth (replay->device), ==, 2);
+
+    g_main_loop_run (replay->loop);
+
+    /* The high priority request goes before the one issued earlier */
+    g_assert_cmpuint (replay->completed->len, ==, 3);
+    g_assert_cmpuint (g_array_index (replay->completed, guint16, 0), ==, 1);
+    g_assert_cmpuint (g_array_index (replay->completed, guint16, 1), ==, 3);
+    g_assert_cmpuint (g_array_index (replay->completed, guint16, 2), ==, 2);
+
+    g_assert_cmpuint (qmi_device_get_service_in_flight (replay->device, QMI_SERVICE_DMS), ==, 0);
+    g_assert_cmpuint (qmi_device_get_output_queue_depth (replay->device), ==, 0);
+
+    replay_free (replay);
+    g_unlink (capture_path);
+    g_free (capture_path);
+}
+
+static void
+send_get_ids (Replay  *replay,
+              guint16  transaction_id)
+{
+    QmiMessage *request;
+
+    request = qmi_message_new (QMI_SERVICE_DMS, 1, transaction_id, QMI_MESSAGE_DMS_GET_IDS);
+    qmi_device_command_full (replay->device,
+                             request,
+                             NULL,
+                             10,
+                             NULL,
+                             (GAsyncReadyCallback) recorded_command_ready,
+                             replay);
+    qmi_message_unref (request);
+}
+
+static void
+test_replay_coalescing (void)
+{
+    Replay *replay;
+    gchar  *capture_path;
+    guint   n_responses;
+    guint   n_unmatched;
+
+    /* A single request and response in the capture */
+    capture_path = build_capture (1);
+    replay = replay_new (capture_path, 0.0);
+    qmi_device_set_message_coalescing (replay->device, QMI_SERVICE_DMS, QMI_MESSAGE_DMS_GET_IDS, TRUE, 60000);
+
+    /* Identical requests issued while the first one is in flight share its
+     * response */
+    replay->n_expected = 3;
+    send_get_ids (replay, 1);
+    send_get_ids (replay, 2);
+    send_get_ids (replay, 3);
+    g_main_loop_run (replay->loop);
+
+    g_assert_cmpuint (g_array_index (replay->completed, guint16, 0), ==, 1);
+    g_assert_cmpuint (g_array_index (replay->completed, guint16, 1), ==, 2);
+    g_assert_cmpuint (g_array_index (replay->completed, guint16, 2), ==, 3);
+
+    /* Served from the cache */
+    replay->n_expected = 4;
+    send_get_ids (replay, 4);
+    g_main_loop_run (replay->loop);
+    g_assert_cmpuint (g_array_index (replay->completed, guint16, 3), ==, 4);
+
+    test_replay_context_get_stats (replay->ctx, &n_responses, &n_unmatched, NULL);
+    g_assert_cmpuint (n_responses, ==, 1);
+    g_assert_cmpuint (n_unmatched, ==, 0);
+
+    /* Once disabled, the request reaches the modem again; there is no other
+     * response in the capture */
+    qmi_device_set_message_coalescing (replay->device, QMI_SERVICE_DMS, QMI_MESSAGE_DMS_GET_IDS, FALSE, 0);
+    replay->n_expected = 5;
+    send_get_ids (replay, 5);
+    g_main_loop_run (replay->loop);
+
+    test_replay_context_get_stats (replay->ctx, &n_responses, &n_unmatched, NULL);
+    g_assert_cmpuint (n_responses, ==, 1);
+    g_assert_cmpuint (n_unmatched, ==, 1);
+
+    replay_free (replay);
+    g_unlink (capture_path);
+    g_free (capture_path);
+}
+
+static void
+aborted_command_ready (QmiDevice    *device,
+                       GAsyncResult *res,
+                       Replay       *replay)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
+    guint16     transaction_id = 0;
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    g_assert_error (error, QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_ABORTED);
+    g_assert (!response);
+    g_error_free (error);
+
+    /* Aborted requests are recorded with transaction id 0 */
+    g_array_append_val (replay->completed, transaction_id);
+
+    if (replay->completed->len == replay->n_expected)
+        g_main_loop_quit (replay->loop);
+}
+
+static void
+test_replay_coalescing_cancelled (void)
+{
+    Replay                *replay;
+    gchar                 *capture_path;
+    GCancellable          *cancellable;
+    QmiMessage            *request;
+    GArray                *array;
+    QmiDeviceMessageStats *message_stats = NULL;
+    gboolean               aborted = FALSE;
+    gboolean               responded = FALSE;
+    guint                  i;
+
+    capture_path = build_capture (1);
+    replay = replay_new (capture_path, 0.0);
+    qmi_device_set_message_coalescing (replay->device, QMI_SERVICE_DMS, QMI_MESSAGE_DMS_GET_IDS, TRUE, 0);
+    qmi_device_reset_stats (replay->device);
+
+    replay->n_expected = 2;
+    send_get_ids (replay, 1);
+
+    /* Merged into the first one, and cancelled before its response */
+    cancellable = g_cancellable_new ();
+    request = qmi_message_new (QMI_SERVICE_DMS, 1, 2, QMI_MESSAGE_DMS_GET_IDS);
+    qmi_device_command_full (replay->device,
+                             request,
+                             NULL,
+                             10,
+                             cancellable,
+                             (GAsyncReadyCallback) aborted_command_ready,
+                             replay);
+    qmi_message_unref (request);
+    g_cancellable_cancel (cancellable);
+
+    g_main_loop_run (replay->loop);
+
+    /* The cancelled request is aborted on its own, the first one still gets
+     * its response */
+    for (i = 0; i < replay->completed->len; i++) {
+        guint16 transaction_id = g_array_index (replay->completed, guint16, i);
+
+        if (transaction_id == 0)
+            aborted = TRUE;
+        else if (transaction_id == 1)
+            responded = TRUE;
+    }
+    g_assert (aborted);
+    g_assert (responded);
+
+    array = qmi_device_get_stats (replay->device, NULL);
+    for (i = 0; i < array->len; i++) {
+        QmiDeviceMessageStats *item = &g_array_index (array, QmiDeviceMessageStats, i);
+
+        if (item->service == QMI_SERVICE_DMS && item->message_id == QMI_MESSAGE_DMS_GET_IDS)
+            message_stats = item;
+    }
+    g_assert (message_stats);
+    g_assert_cmpuint (message_stats->requests, ==, 2);
+    g_assert_cmpuint (message_stats->coalesced, ==, 1);
+    g_assert_cmpuint (message_stats->responses, ==, 1);
+    g_assert_cmpuint (message_stats->aborts, ==, 1);
+    g_array_unref (array);
+
+    g_object_unref (cancellable);
+    replay_free (replay);
+    g_unlink (capture_path);
+    g_free (capture_path);
+}
+
+static void
+test_replay_coalescing_leader_cancelled (void)
+{
+    Replay                *replay;
+    gchar                 *capture_path;
+    GCancellable          *cancellable;
+    QmiMessage            *request;
+    GArray                *array;
+    QmiDeviceMessageStats *message_stats = NULL;
+    gboolean               aborted = FALSE;
+    gboolean               responded = FALSE;
+    guint                  n_unmatched;
+    guint                  i;
+
+    /* Responses for both requests in the capture */
+    capture_path = build_capture (2);
+    replay = replay_new (capture_path, 0.0);
+    qmi_device_set_message_coalescing (replay->device, QMI_SERVICE_DMS, QMI_MESSAGE_DMS_GET_IDS, TRUE, 0);
+    qmi_device_reset_stats (replay->device);
+
+    replay->n_expected = 2;
+
+    cancellable = g_cancellable_new ();
+    request = qmi_message_new (QMI_SERVICE_DMS, 1, 1, QMI_MESSAGE_DMS_GET_IDS);
+    qmi_device_command_full (replay->device,
+                             request,
+                             NULL,
+                             10,
+                             cancellable,
+                             (GAsyncReadyCallback) aborted_command_ready,
+                             replay);
+    qmi_message_unref (request);
+
+    /* Merged into the first one, which is then cancelled */
+    send_get_ids (replay, 2);
+    g_cancellable_cancel (cancellable);
+
+    g_main_loop_run (replay->loop);
+
+    /* The merged request is sent on its own, and gets its own response */
+    for (i = 0; i < replay->completed->len; i++) {
+        guint16 transaction_id = g_array_index (replay->completed, guint16, i);
+
+        if (transaction_id == 0)
+            aborted = TRUE;
+        else if (transaction_id == 2)
+            responded = TRUE;
+    }
+    g_assert (aborted);
+    g_assert (responded);
+
+    test_replay_context_get_stats (replay->ctx, NULL, &n_unmatched, NULL);
+    g_assert_cmpuint (n_unmatched, ==, 0);
+
+    array = qmi_device_get_stats (replay->device, NULL);
+    for (i = 0; i < array->len; i++) {
+        QmiDeviceMessageStats *item = &g_array_index (array, QmiDeviceMessageStats, i);
+
+        if (item->service == QMI_SERVICE_DMS && item->message_id == QMI_MESSAGE_DMS_GET_IDS)
+            message_stats = item;
+    }
+    g_assert (message_stats);
+    g_assert_cmpuint (message_stats->requests, ==, 2);
+    g_assert_cmpuint (message_stats->responses, ==, 1);
+    g_assert_cmpuint (message_stats->aborts, ==, 1);
+    g_array_unref (array);
+
+    g_object_unref (cancellable);
+    replay_free (replay);
+    g_unlink (capture_path);
+    g_free (capture_path);
+}
+
+/*****************************************************************************/
+
+static void
+test_replay_stats (void)
+{
+    Replay                *replay;
+    gchar                 *capture_path;
+    GArray                *array;
+    QmiDeviceStats         stats;
+    QmiDeviceMessageStats *message_stats = NULL;
+    guint64                n_histogram = 0;
+    guint                  i;
+
+    capture_path = build_capture (1);
+    replay = replay_new (capture_path, 0.0);
+    qmi_device_set_message_coalescing (replay->device, QMI_SERVICE_DMS, QMI_MESSAGE_DMS_GET_IDS, TRUE, 60000);
+
+    /* Ignore whatever was exchanged while opening */
+    qmi_device_reset_stats (replay->device);
+
+    /* One request sent, one merged into it, and one served from the cache */
+    replay->n_expected = 2;
+    send_get_ids (replay, 1);
+    send_get_ids (replay, 2);
+    g_main_loop_run (replay->loop);
+    replay->n_expected = 3;
+    send_get_ids (replay, 3);
+    g_main_loop_run (replay->loop);
+
+    /* And one more sent, which gets an error response */
+    qmi_device_set_message_coalescing (replay->device, QMI_SERVICE_DMS, QMI_MESSAGE_DMS_GET_IDS, FALSE, 0);
+    replay->n_expected = 4;
+    send_get_ids (replay, 4);
+    g_main_loop_run (replay->loop);
+
+    array = qmi_device_get_stats (replay->device, &stats);
+    g_assert_cmpint (stats.elapsed, >, 0);
+    g_assert_cmpuint (stats.messages_out, ==, 2);
+    g_assert_cmpuint (stats.bytes_out, >, 0);
+    g_assert_cmpuint (stats.bytes_in, >, 0);
+    /* The indication in the capture may not have arrived yet */
+    g_assert_cmpuint (stats.indications, <=, 1);
+    g_assert_cmpuint (stats.messages_in, ==, 2 + stats.indications);
+    /* The merged request waits for the response as well */
+    g_assert_cmpuint (stats.max_in_flight, ==, 2);
+
+    for (i = 0; i < array->len; i++) {
+        QmiDeviceMessageStats *item = &g_array_index (array, QmiDeviceMessageStats, i);
+
+        if (item->service == QMI_SERVICE_DMS && item->message_id == QMI_MESSAGE_DMS_GET_IDS)
+            message_stats = item;
+    }
+    g_assert (message_stats);
+    g_assert_cmpuint (message_stats->requests, ==, 4);
+    g_assert_cmpuint (message_stats->responses, ==, 4);
+    g_assert_cmpuint (message_stats->coalesced, ==, 1);
+    g_assert_cmpuint (message_stats->cached, ==, 1);
+    g_assert_cmpuint (message_stats->timeouts, ==, 0);
+    g_assert_cmpuint (message_stats->aborts, ==, 0);
+    g_assert_cmpuint (message_stats->errors, ==, 0);
+    for (i = 0; i < QMI_DEVICE_STATS_LATENCY_BUCKETS; i++)
+        n_histogram += message_stats->latency_histogram[i];
+    g_assert_cmpuint (n_histogram, ==, 4);
+    g_assert_cmpuint (message_stats->latency_total, >=, message_stats->latency_max);
+    g_array_unref (array);
+
+    /* Everything is gone after a reset */
+    qmi_device_reset_stats (replay->device);
+    array = qmi_device_get_stats (replay->device, &stats);
+    g_assert_cmpuint (array->len, ==, 0);
+    g_assert_cmpuint (stats.messages_out, ==, 0);
+    g_array_unref (array);
+
+    replay_free (replay);
+    g_unlink (capture_path);
+    g_free (capture_path);
+}
+
+/*****************************************************************************/
+
+static void
+allocate_client_unsupported_ready (QmiDevice    *device,
+                                   GAsyncResult *res,
+                                   Replay       *replay)
+{
+    QmiClient *client;
+    GError    *error = NULL;
+
+    client = qmi_device_allocate_client_finish (device, res, &error);
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_UNSUPPORTED);
+    g_assert (!client);
+    g_error_free (error);
+    g_main_loop_quit (replay->loop);
+}
+
+static void
+assert_service_unsupported (Replay     *replay,
+                            QmiService  service)
+{
+    qmi_device_allocate_client (replay->device,
+                                service,
+                                QMI_CID_NONE,
+                                10,
+                                NULL,
+                                (GAsyncReadyCallback) allocate_client_unsupported_ready,
+                                replay);
+    g_main_loop_run (replay->loop);
+}
+
+static void
+test_replay_version_info_cache (void)
+{
+    static const gint services[] = {
+        QMI_SERVICE_CTL, 1, 5,
+        QMI_SERVICE_DMS, 1, 0,
+    };
+    Replay   *replay;
+    GKeyFile *key_file;
+    GError   *error = NULL;
+    gchar    *capture_path;
+    gchar    *cache_path;
+    gchar    *path;
+    gchar    *data;
+    gsize     data_len;
+    guint     n_unmatched = 0;
+    guint16   major = 0;
+    guint16   minor = 0;
+    gint      fd;
+    gboolean  st;
+
+    /* The capture has no version info response, so opening would fail if
+     * the device was queried */
+    capture_path = build_capture (1);
+
+    fd = g_file_open_tmp ("test-replay-version-info-XXXXXX", &cache_path, &error);
+    g_assert_no_error (error);
+    close (fd);
+
+    path = replay_build_path ();
+    key_file = g_key_file_new ();
+    g_key_file_set_string (key_file, path, "identity", "unknown");
+    g_key_file_set_integer_list (key_file, path, "services", (gint *)services, G_N_ELEMENTS (services));
+    data = g_key_file_to_data (key_file, &data_len, NULL);
+    st = g_file_set_contents (cache_path, data, data_len, &error);
+    g_assert_no_error (error);
+    g_assert (st);
+    g_free (data);
+    g_key_file_free (key_file);
+
+    replay = replay_new_full (path, capture_path, 0.0, QMI_DEVICE_OPEN_FLAGS_VERSION_INFO, cache_path, NULL);
+
+    /* Only the cached services are supported */
+    st = qmi_device_get_service_version (replay->device, QMI_SERVICE_DMS, &major, &minor);
+    g_assert (st);
+    g_assert_cmpuint (major, ==, 1);
+    g_assert_cmpuint (minor, ==, 0);
+    g_assert (!qmi_device_get_service_version (replay->device, QMI_SERVICE_NAS, NULL, NULL));
+    g_assert (!qmi_device_is_message_supported (replay->device, QMI_SERVICE_NAS, 0x0020));
+    assert_service_unsupported (replay, QMI_SERVICE_NAS);
+
+    /* The validation runs once the device is open; as it fails, the cached
+     * info is kept */
+    while (n_unmatched == 0) {
+        g_main_context_iteration (NULL, TRUE);
+        test_replay_context_get_stats (replay->ctx, NULL, &n_unmatched, NULL);
+    }
+    assert_service_unsupported (replay, QMI_SERVICE_NAS);
+
+    replay_free (replay);
+    g_unlink (cache_path);
+    g_free (cache_path);
+    g_unlink (capture_path);
+    g_free (capture_path);
+}
+
+/*****************************************************************************/
+
+static void
+command_unsupported_ready (QmiDevice    *device,
+                           GAsyncResult *res,
+                           Replay       *replay)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_UNSUPPORTED);
+    g_assert (!response);
+    g_error_free (error);
+    g_main_loop_quit (replay->loop);
+}
+
+static void
+test_replay_supported_messages (void)
+{
+    Replay     *replay;
+    GArray     *bitmap;
+    QmiMessage *request;
+    gchar      *capture_path;
+    guint8      byte;
+    guint       n_responses;
+    guint       n_unmatched;
+
+    capture_path = build_capture (1);
+    replay = replay_new (capture_path, 0.0);
+
+    /* Only DMS Get IDs (0x0025) */
+    bitmap = g_array_new (FALSE, TRUE, sizeof (guint8));
+    g_array_set_size (bitmap, QMI_MESSAGE_DMS_GET_IDS / 8 + 1);
+    byte = 1 << (QMI_MESSAGE_DMS_GET_IDS % 8);
+    g_array_index (bitmap, guint8, QMI_MESSAGE_DMS_GET_IDS / 8) = byte;
+    qmi_device_set_service_supported_messages (replay->device, QMI_SERVICE_DMS, bitmap);
+    g_array_unref (bitmap);
+
+    g_assert (qmi_device_is_message_supported (replay->device, QMI_SERVICE_DMS, QMI_MESSAGE_DMS_GET_IDS));
+    g_assert (!qmi_device_is_message_supported (replay->device, QMI_SERVICE_DMS, QMI_MESSAGE_DMS_GET_CAPABILITIES));
+    g_assert (!qmi_device_is_message_supported (replay->device, QMI_SERVICE_DMS, 0x5556));
+    g_assert (qmi_device_is_message_supported (replay->device, QMI_SERVICE_NAS, 0x0020));
+
+    /* Rejected without reaching the device */
+    request = qmi_message_new (QMI_SERVICE_DMS, 1, 1, QMI_MESSAGE_DMS_GET_CAPABILITIES);
+    qmi_device_command_full (replay->device,
+                             request,
+                             NULL,
+                             10,
+                             NULL,
+                             (GAsyncReadyCallback) command_unsupported_ready,
+                             replay);
+    qmi_message_unref (request);
+    g_main_loop_run (replay->loop);
+
+    /* The supported one goes through */
+    replay->n_expected = 1;
+    send_get_ids (replay, 1);
+    g_main_loop_run (replay->loop);
+
+    test_replay_context_get_stats (replay->ctx, &n_responses, &n_unmatched, NULL);
+    g_assert_cmpuint (n_responses, ==, 1);
+    g_assert_cmpuint (n_unmatched, ==, 0);
+
+    /* Without the bitmap, everything is assumed supported again */
+    qmi_device_set_service_supported_messages (replay->device, QMI_SERVICE_DMS, NULL);
+    g_assert (qmi_device_is_message_supported (replay->device, QMI_SERVICE_DMS, QMI_MESSAGE_DMS_GET_CAPABILITIES));
+
+    replay_free (replay);
+    g_unlink (capture_path);
+    g_free (capture_path);
+}
+
+/*****************************************************************************/
+
+#define N_WORKERS             4
+#define N_REQUESTS_PER_WORKER 5
+
+typedef struct {
+    Replay       *replay;
+    GMainContext *context;
+    GMainLoop    *loop;
+    GThread      *thread;
+    guint16       first_transaction_id;
+    guint         n_responses;
+} Worker;
+
+static volatile gint n_workers_done;
+
+static void
+worker_command_ready (QmiDevice    *device,
+                      GAsyncResult *res,
+                      Worker       *worker)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (response);
+    qmi_message_unref (response);
+
+    /* Completed in the context of the thread issuing the request */
+    g_assert (g_main_context_get_thread_default () == worker->context);
+    g_assert (g_main_context_is_owner (worker->context));
+
+    if (++worker->n_responses == N_REQUESTS_PER_WORKER)
+        g_main_loop_quit (worker->loop);
+}
+
+static gpointer
+worker_thread_func (Worker *worker)
+{
+    QmiMessage *request;
+    guint       i;
+
+    g_main_context_push_thread_default (worker->context);
+
+    for (i = 0; i < N_REQUESTS_PER_WORKER; i++) {
+        request = qmi_message_new (QMI_SERVICE_DMS, 1, worker->first_transaction_id + i, QMI_MESSAGE_DMS_GET_IDS);
+        qmi_device_command_full (worker->replay->device,
+                                 request,
+                                 NULL,
+                                 10,
+                                 NULL,
+                                 (GAsyncReadyCallback) worker_command_ready,
+                                 worker);
+        qmi_message_unref (request);
+    }
+    g_main_loop_run (worker->loop);
+
+    g_main_context_pop_thread_default (worker->context);
+
+    g_atomic_int_inc (&n_workers_done);
+    g_main_context_wakeup (NULL);
+    return NULL;
+}
+
+static void
+test_replay_io_context (void)
+{
+    Replay *replay;
+    Worker  workers[N_WORKERS];
+    gchar  *capture_path;
+    guint   n_responses;
+    guint   n_unmatched;
+    guint   i;
+
+    /* The test thread owns the device I/O */
+    capture_path = build_capture (N_WORKERS * N_REQUESTS_PER_WORKER);
+    replay = replay_new_full (replay_build_path (), capture_path, 0.0, QMI_DEVICE_OPEN_FLAGS_NONE, NULL,
+                              g_main_context_default ());
+
+    g_atomic_int_set (&n_workers_done, 0);
+    for (i = 0; i < N_WORKERS; i++) {
+        workers[i].replay = replay;
+        workers[i].context = g_main_context_new ();
+        workers[i].loop = g_main_loop_new (workers[i].context, FALSE);
+        workers[i].first_transaction_id = 1 + i * N_REQUESTS_PER_WORKER;
+        workers[i].n_responses = 0;
+        workers[i].thread = g_thread_new ("worker", (GThreadFunc) worker_thread_func, &workers[i]);
+    }
+
+    while (g_atomic_int_get (&n_workers_done) < N_WORKERS)
+        g_main_context_iteration (NULL, TRUE);
+
+    for (i = 0; i < N_WORKERS; i++) {
+        g_thread_join (workers[i].thread);
+        g_assert_cmpuint (workers[i].n_responses, ==, N_REQUESTS_PER_WORKER);
+        g_main_loop_unref (workers[i].loop);
+        g_main_context_unref (workers[i].context);
+    }
+
+    test_replay_context_get_stats (replay->ctx, &n_responses, &n_unmatched, NULL);
+    g_assert_cmpuint (n_responses, ==, N_WORKERS * N_REQUESTS_PER_WORKER);
+    g_assert_cmpuint (n_unmatched, ==, 0);
+
+    replay_free (replay);
+    g_unlink (capture_path);
+    g_free (capture_path);
+}
+
+int main (int argc, char **argv)
+{
+    static const gdouble no_delay = 0.0;
+    static const gdouble accelerated = 10.0;
+
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func      ("/libqmi-glib/replay/load",             test_replay_load);
+    g_test_add_func      ("/libqmi-glib/replay/load-error",       test_replay_load_error);
+    g_test_add_data_func ("/libqmi-glib/replay/serve/no-delay",    &no_delay,    test_replay_serve);
+    g_test_add_data_func ("/libqmi-glib/replay/serve/accelerated", &accelerated, test_replay_serve);
+    g_test_add_func      ("/libqmi-glib/replay/in-flight-limit",  test_replay_in_flight_limit);
+    g_test_add_func      ("/libqmi-glib/replay/coalescing",       test_replay_coalescing);
+    g_test_add_func      ("/libqmi-glib/replay/coalescing-cancelled", test_replay_coalescing_cancelled);
+    g_test_add_func      ("/libqmi-glib/replay/coalescing-leader-cancelled", test_replay_coalescing_leader_cancelled);
+    g_test_add_func      ("/libqmi-glib/replay/stats",            test_replay_stats);
+    g_test_add_func      ("/libqmi-glib/replay/version-info-cache", test_replay_version_info_cache);
+    g_test_add_func      ("/libqmi-glib/replay/supported-messages", test_replay_supported_messages);
+    g_test_add_func      ("/libqmi-glib/replay/io-context",       test_replay_io_context);
+    g_test_add_func      ("/libqmi-glib/replay/perf",             test_replay_perf);
+
+    return g_test_run ();
+}
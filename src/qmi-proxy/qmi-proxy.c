@@ -46,12 +46,22 @@ static guint timeout_id;
 static gboolean verbose_flag;
 static gboolean version_flag;
 static gboolean no_exit_flag;
+static gint client_queue_limit;
+static gboolean client_queue_disconnect_flag;
 
 static GOptionEntry main_entries[] = {
     { "no-exit", 0, 0, G_OPTION_ARG_NONE, &no_exit_flag,
       "Don't exit after being idle without clients",
       NULL
     },
+    { "client-queue-limit", 0, 0, G_OPTION_ARG_INT, &client_queue_limit,
+      "Maximum number of messages queued for a slow client (default: unlimited)",
+      "[N]"
+    },
+    { "client-queue-disconnect", 0, 0, G_OPTION_ARG_NONE, &client_queue_disconnect_flag,
+      "Disconnect clients reaching the queue limit, instead of dropping their indications",
+      NULL
+    },
     { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose_flag,
       "Run action with verbose logs, including the debug ones",
       NULL
@@ -187,6 +197,11 @@ int main (int argc, char **argv)
     if (version_flag)
         print_version_and_exit ();
 
+    if (client_queue_limit < 0) {
+        g_printerr ("error: invalid client queue limit: %d\n", client_queue_limit);
+        exit (EXIT_FAILURE);
+    }
+
     g_log_set_handler (NULL,  G_LOG_LEVEL_MASK, log_handler, NULL);
     g_log_set_handler ("Qmi", G_LOG_LEVEL_MASK, log_handler, NULL);
     if (verbose_flag)
@@ -204,6 +219,13 @@ int main (int argc, char **argv)
         exit (EXIT_FAILURE);
     }
 
+    g_object_set (proxy,
+                  QMI_PROXY_CLIENT_QUEUE_LIMIT,  (guint) client_queue_limit,
+                  QMI_PROXY_CLIENT_QUEUE_POLICY, (client_queue_disconnect_flag ?
+                                                  QMI_PROXY_CLIENT_QUEUE_POLICY_DISCONNECT :
+                                                  QMI_PROXY_CLIENT_QUEUE_POLICY_DROP),
+                  NULL);
+
     /* Don't exit the proxy when no clients are found */
     if (!no_exit_flag) {
         proxy_n_clients_changed (proxy);
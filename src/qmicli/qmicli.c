@@ -58,6 +58,7 @@ static gboolean get_expected_data_format_flag;
 static gchar *set_expected_data_format_str;
 static gchar *device_set_instance_id_str;
 static gboolean device_open_version_info_flag;
+static gchar *device_open_version_info_cache_str;
 static gboolean device_open_sync_flag;
 static gchar *device_open_net_str;
 static gboolean device_open_proxy_flag;
@@ -99,6 +100,10 @@ static GOptionEntry main_entries[] = {
       "Run version info check when opening device",
       NULL
     },
+    { "device-open-version-info-cache", 0, 0, G_OPTION_ARG_FILENAME, &device_open_version_info_cache_str,
+      "Cache the version info check results in the given file",
+      "[PATH]"
+    },
     { "device-open-sync", 0, 0, G_OPTION_ARG_NONE, &device_open_sync_flag,
       "Run sync operation when opening device",
       NULL
@@ -643,6 +648,15 @@ device_new_ready (GObject *unused,
     /* Setup device open flags */
     if (device_open_version_info_flag)
         open_flags |= QMI_DEVICE_OPEN_FLAGS_VERSION_INFO;
+    if (device_open_version_info_cache_str) {
+        if (!device_open_version_info_flag) {
+            g_printerr ("error: version info cache requires --device-open-version-info\n");
+            exit (EXIT_FAILURE);
+        }
+        g_object_set (device,
+                      QMI_DEVICE_VERSION_INFO_CACHE, device_open_version_info_cache_str,
+                      NULL);
+    }
     if (device_open_sync_flag)
         open_flags |= QMI_DEVICE_OPEN_FLAGS_SYNC;
     if (device_open_proxy_flag)
@@ -0,0 +1,212 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * qmi-capture-decode -- Command line tool to decode QMI traffic captures
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <locale.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include <libqmi-glib.h>
+
+#include "qmi-capture.h"
+
+#define PROGRAM_NAME    "qmi-capture-decode"
+#define PROGRAM_VERSION PACKAGE_VERSION
+
+/* Main options */
+static gboolean raw_flag;
+static gboolean version_flag;
+static gchar **files;
+
+static GOptionEntry main_entries[] = {
+    { "raw", 'r', 0, G_OPTION_ARG_NONE, &raw_flag,
+      "Print the raw frame of each message as well",
+      NULL
+    },
+    { "version", 'V', 0, G_OPTION_ARG_NONE, &version_flag,
+      "Print version",
+      NULL
+    },
+    { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &files,
+      NULL,
+      "[FILE...]"
+    },
+    { NULL }
+};
+
+static void
+print_version_and_exit (void)
+{
+    g_print ("\n"
+             PROGRAM_NAME " " PROGRAM_VERSION "\n"
+             "Copyright (2026) agent\n"
+             "License GPLv2+: GNU GPL version 2 or later <http://gnu.org/licenses/gpl-2.0.html>\n"
+             "This is free software: you are free to change and redistribute it.\n"
+             "There is NO WARRANTY, to the extent permitted by law.\n"
+             "\n");
+    exit (EXIT_SUCCESS);
+}
+
+/*****************************************************************************/
+
+static void
+print_record (const gchar            *device,
+              guint                   index,
+              gint64                  first_timestamp,
+              const QmiCaptureRecord *record)
+{
+    GByteArray        *raw;
+    QmiMessage        *message;
+    QmiMessageContext *context = NULL;
+    GError            *error = NULL;
+    GDateTime         *datetime;
+    gchar             *datetime_str;
+    const gchar       *direction_str;
+
+    switch (record->direction) {
+    case QMI_CAPTURE_DIRECTION_IN:
+        direction_str = "received";
+        break;
+    case QMI_CAPTURE_DIRECTION_OUT:
+        direction_str = "sent";
+        break;
+    case QMI_CAPTURE_DIRECTION_UNKNOWN:
+    default:
+        direction_str = "captured";
+        break;
+    }
+
+    datetime = g_date_time_new_from_unix_local (record->timestamp / G_USEC_PER_SEC);
+    datetime_str = g_date_time_format (datetime, "%F %T");
+    g_print ("#%u [%s.%06u, +%.6lfs] [%s] %s",
+             index,
+             datetime_str,
+             (guint) (record->timestamp % G_USEC_PER_SEC),
+             (gdouble) (record->timestamp - first_timestamp) / G_USEC_PER_SEC,
+             device ? device : "unknown",
+             direction_str);
+    g_free (datetime_str);
+    g_date_time_unref (datetime);
+
+    if (record->vendor_id != QMI_MESSAGE_VENDOR_GENERIC) {
+        g_print (" vendor-specific (0x%04x)", record->vendor_id);
+        context = qmi_message_context_new ();
+        qmi_message_context_set_vendor_id (context, record->vendor_id);
+    }
+    g_print ("\n");
+
+    if (raw_flag) {
+        gsize i;
+
+        g_print ("  raw (%" G_GSIZE_FORMAT " bytes) = ", record->frame_len);
+        for (i = 0; i < record->frame_len; i++)
+            g_print ("%02x%s", record->frame[i], (i + 1 < record->frame_len) ? ":" : "\n");
+    }
+
+    raw = g_byte_array_sized_new (record->frame_len);
+    g_byte_array_append (raw, record->frame, record->frame_len);
+    message = qmi_message_new_from_raw (raw, &error);
+    if (!message) {
+        g_print ("  invalid message: %s\n\n", error ? error->message : "incomplete frame");
+        g_clear_error (&error);
+    } else {
+        gchar *printable;
+
+        printable = qmi_message_get_printable_full (message, context, "  ");
+        g_print ("%s\n", printable);
+        g_free (printable);
+        qmi_message_unref (message);
+    }
+
+    g_byte_array_unref (raw);
+    if (context)
+        qmi_message_context_unref (context);
+}
+
+static gboolean
+decode_file (const gchar *path)
+{
+    QmiCaptureReader *reader;
+    QmiCaptureRecord  record;
+    GError           *error = NULL;
+    gint64            first_timestamp = -1;
+    guint             n_records = 0;
+
+    reader = __qmi_capture_reader_new (path, &error);
+    if (!reader) {
+        g_printerr ("error: couldn't open capture: %s\n", error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    while (__qmi_capture_reader_next (reader, &record, &error)) {
+        if (first_timestamp < 0)
+            first_timestamp = record.timestamp;
+        print_record (__qmi_capture_reader_get_device (reader), n_records++, first_timestamp, &record);
+    }
+
+    __qmi_capture_reader_free (reader);
+
+    if (error) {
+        g_printerr ("error: couldn't read capture: %s\n", error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+int main (int argc, char **argv)
+{
+    GError *error = NULL;
+    GOptionContext *context;
+    gboolean success = TRUE;
+    guint i;
+
+    setlocale (LC_ALL, "");
+
+    /* Setup option context, process it and destroy it */
+    context = g_option_context_new ("- Decode QMI traffic captures");
+    g_option_context_add_main_entries (context, main_entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("error: %s\n",
+                    error->message);
+        exit (EXIT_FAILURE);
+    }
+    g_option_context_free (context);
+
+    if (version_flag)
+        print_version_and_exit ();
+
+    if (!files || !files[0]) {
+        g_printerr ("error: no capture files given\n");
+        exit (EXIT_FAILURE);
+    }
+
+    for (i = 0; files[i]; i++)
+        success &= decode_file (files[i]);
+
+    g_strfreev (files);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}